@@ -0,0 +1,127 @@
+#include "Arena.h"
+
+#include "FatalErrors.h"
+#include "Mem.h"
+#include <algorithm>
+
+// All memory blocks are aligned to this much, so allocations for SIMD data and such will not waste space aligning the block
+static constexpr uint32_t BLOCK_ALIGNMENT = 64;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Allocates a block of memory with the given size, with the start aligned to the given amount.
+// Returns the actual block allocated, which must be freed later, and the aligned start of the block.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::byte* allocAlignedBlock(const uint32_t numBytes, const uint32_t alignment, std::byte*& pAlignedMem) noexcept {
+    ASSERT((alignment > 0) && ((alignment & (alignment - 1)) == 0));
+
+    if (numBytes > UINT32_MAX - alignment) {
+        FatalErrors::outOfMemory();
+    }
+
+    std::byte* const pMemBlock = MemAlloc(numBytes + alignment);
+
+    if (!pMemBlock) {
+        FatalErrors::outOfMemory();
+    }
+
+    const uintptr_t alignedAddr = ((uintptr_t) pMemBlock + alignment - 1) & ~((uintptr_t) alignment - 1);
+    pAlignedMem = reinterpret_cast<std::byte*>(alignedAddr);
+    return pMemBlock;
+}
+
+Arena::Arena() noexcept
+    : mpMemBlock(nullptr)
+    , mpMem(nullptr)
+    , mCapacity(0)
+    , mOffset(0)
+    , mUsedBytes(0)
+    , mHighWaterMark(0)
+    , mOverflowBlocks()
+{
+}
+
+Arena::Arena(Arena&& other) noexcept
+    : mpMemBlock(other.mpMemBlock)
+    , mpMem(other.mpMem)
+    , mCapacity(other.mCapacity)
+    , mOffset(other.mOffset)
+    , mUsedBytes(other.mUsedBytes)
+    , mHighWaterMark(other.mHighWaterMark)
+    , mOverflowBlocks(std::move(other.mOverflowBlocks))
+{
+    other.mpMemBlock = nullptr;
+    other.mpMem = nullptr;
+    other.mCapacity = 0;
+    other.mOffset = 0;
+    other.mUsedBytes = 0;
+    other.mHighWaterMark = 0;
+    other.mOverflowBlocks.clear();
+}
+
+Arena::~Arena() noexcept {
+    destroy();
+}
+
+void Arena::init(const uint32_t capacity) noexcept {
+    destroy();
+
+    if (capacity > 0) {
+        mpMemBlock = allocAlignedBlock(capacity, BLOCK_ALIGNMENT, mpMem);
+        mCapacity = capacity;
+    }
+}
+
+void Arena::destroy() noexcept {
+    for (std::byte* const pBlock : mOverflowBlocks) {
+        MemFree(pBlock);
+    }
+
+    mOverflowBlocks.clear();
+    MEM_FREE_AND_NULL(mpMemBlock);
+    mpMem = nullptr;
+    mCapacity = 0;
+    mOffset = 0;
+    mUsedBytes = 0;
+    mHighWaterMark = 0;
+}
+
+void* Arena::alloc(const uint32_t numBytes, const uint32_t alignment) noexcept {
+    ASSERT((alignment > 0) && ((alignment & (alignment - 1)) == 0));
+
+    // Note: count the worst case alignment padding towards the memory used, so a main block sized to fit the high water mark always fits
+    const uint32_t numBytesWithPadding = numBytes + alignment - 1;
+    mUsedBytes += numBytesWithPadding;
+    mHighWaterMark = std::max(mHighWaterMark, mUsedBytes);
+
+    // Try the main block first
+    const uint32_t alignedOffset = (mOffset + alignment - 1) & ~(alignment - 1);
+
+    if ((alignedOffset >= mOffset) && (alignedOffset <= mCapacity) && (numBytes <= mCapacity - alignedOffset)) {
+        mOffset = alignedOffset + numBytes;
+        return mpMem + alignedOffset;
+    }
+
+    // Otherwise use an overflow block: the main block will be grown to avoid this on the next reset
+    std::byte* pAlignedMem;
+    mOverflowBlocks.push_back(allocAlignedBlock(numBytes, std::max(alignment, BLOCK_ALIGNMENT), pAlignedMem));
+    return pAlignedMem;
+}
+
+void Arena::reset() noexcept {
+    // If anything overflowed then grow the main block to fit the high water mark, plus some room to grow
+    if (!mOverflowBlocks.empty()) {
+        for (std::byte* const pBlock : mOverflowBlocks) {
+            MemFree(pBlock);
+        }
+
+        mOverflowBlocks.clear();
+        MEM_FREE_AND_NULL(mpMemBlock);
+
+        const uint32_t newCapacity = std::max(mHighWaterMark + mHighWaterMark / 4, mCapacity);
+        mpMemBlock = allocAlignedBlock(newCapacity, BLOCK_ALIGNMENT, mpMem);
+        mCapacity = newCapacity;
+    }
+
+    mOffset = 0;
+    mUsedBytes = 0;
+}
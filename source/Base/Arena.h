@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Base/Macros.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A linear (bump) allocator for short lived data, such as the data used to draw a single frame.
+//
+// Allocations are made by simply bumping an offset into one big block of memory and can't be freed individually. Instead everything
+// allocated is freed all at once by resetting the arena. The arena keeps track of the most memory that was ever in use at once (the
+// high water mark) and if an allocation does not fit in the main block of memory, then it is made from a separate overflow block instead.
+// On the next reset the main block is regrown to fit the high water mark, so after the first few uses the arena settles at a steady size
+// and no more system allocations are made.
+//
+// Notes:
+//  (1) Memory handed out is never moved, so pointers remain valid until the next reset.
+//  (2) Arenas are not thread safe: each thread should use its own arena.
+//------------------------------------------------------------------------------------------------------------------------------------------
+class Arena {
+public:
+    Arena() noexcept;
+    Arena(Arena&& other) noexcept;
+    ~Arena() noexcept;
+
+    Arena(const Arena& other) = delete;
+    Arena& operator = (const Arena& other) = delete;
+    Arena& operator = (Arena&& other) = delete;
+
+    // Allocate the main block of memory for the arena with the given size, freeing any existing memory.
+    // The arena can also be used without doing this, in which case the first reset will size the arena.
+    void init(const uint32_t capacity) noexcept;
+
+    // Free all memory used by the arena, including the main block
+    void destroy() noexcept;
+
+    // Allocate memory with the given size and alignment (must be a power of two).
+    // Never fails, aside from a fatal out of memory error.
+    void* alloc(const uint32_t numBytes, const uint32_t alignment) noexcept;
+
+    // Free everything allocated from the arena at once, and grow the main block if it overflowed since the last reset
+    void reset() noexcept;
+
+    inline uint32_t getCapacity() const noexcept { return mCapacity; }
+    inline uint32_t getUsedBytes() const noexcept { return mUsedBytes; }
+    inline uint32_t getHighWaterMark() const noexcept { return mHighWaterMark; }
+
+private:
+    std::byte*                  mpMemBlock;         // The main block of memory allocated (not aligned)
+    std::byte*                  mpMem;              // Start of the main block of memory, aligned
+    uint32_t                    mCapacity;          // Size of the main block of memory (from the aligned start)
+    uint32_t                    mOffset;            // How much of the main block of memory has been used
+    uint32_t                    mUsedBytes;         // How much memory has been allocated since the last reset, including overflow blocks
+    uint32_t                    mHighWaterMark;     // The greatest amount of memory that was ever allocated between resets
+    std::vector<std::byte*>     mOverflowBlocks;    // Blocks allocated for allocations which didn't fit in the main block
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Allocator which allows standard containers to allocate from an arena.
+// Freeing memory does nothing since the arena frees everything at once, hence after the arena is reset containers MUST give up their old
+// memory (see 'releaseArenaVector') before they are used again.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    // Note: the allocator goes along with the memory it allocated whenever a container is moved, assigned or swapped
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    inline ArenaAllocator() noexcept : mpArena(nullptr) {}
+    inline explicit ArenaAllocator(Arena& arena) noexcept : mpArena(&arena) {}
+
+    template <class U>
+    inline ArenaAllocator(const ArenaAllocator<U>& other) noexcept : mpArena(other.getArena()) {}
+
+    inline T* allocate(const size_t count) noexcept {
+        ASSERT(mpArena);
+        ASSERT(count * sizeof(T) <= UINT32_MAX);
+        return static_cast<T*>(mpArena->alloc((uint32_t)(count * sizeof(T)), (uint32_t) alignof(T)));
+    }
+
+    inline void deallocate([[maybe_unused]] T* const pMem, [[maybe_unused]] const size_t count) noexcept {}
+
+    inline Arena* getArena() const noexcept { return mpArena; }
+
+    template <class U>
+    inline bool operator == (const ArenaAllocator<U>& other) const noexcept { return (mpArena == other.getArena()); }
+
+    template <class U>
+    inline bool operator != (const ArenaAllocator<U>& other) const noexcept { return (mpArena != other.getArena()); }
+
+private:
+    Arena* mpArena;
+};
+
+// A vector which allocates from an arena
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Empties the given arena vector and makes it give up its memory without touching it, so the vector can be used again after its arena
+// has been reset. Afterwards the vector will allocate from the given arena.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class T>
+inline void releaseArenaVector(ArenaVector<T>& vec, Arena& arena) noexcept {
+    vec = ArenaVector<T>(ArenaAllocator<T>(arena));
+}
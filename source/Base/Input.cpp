@@ -157,9 +157,18 @@ static void handleSdlEvents() noexcept {
                         SDL_ShowCursor(SDL_ENABLE);
                         SDL_SetWindowGrab(Video::getWindow(), SDL_FALSE);
                         break;
+
+                    case SDL_WINDOWEVENT_EXPOSED:
+                        Video::requestFullPresent();    // Window contents may have been lost
+                        break;
                 }
             }   break;
 
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                Video::requestFullPresent();    // Texture contents may have been lost
+                break;
+
             case SDL_KEYDOWN: {
                 const uint16_t scancode = (uint16_t) sdlEvent.key.keysym.scancode;
 
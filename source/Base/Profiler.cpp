@@ -0,0 +1,283 @@
+#include "Profiler.h"
+
+#include "FileUtils.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+BEGIN_NAMESPACE(Profiler)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Ring buffer of zones recorded by a single thread
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct ThreadZones {
+    uint32_t                    threadIdx;              // Index of the thread, in order of when it first recorded a zone
+    std::atomic<uint64_t>       numZonesRecorded;       // Total number of zones ever recorded by the thread (only written by the thread)
+    uint64_t                    numZonesGathered;       // How many of the recorded zones have been gathered up for the frame stats
+    std::unique_ptr<Zone[]>     pZones;                 // The ring buffer of zones
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Running total for the time spent in a zone, over a number of frames
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct ZoneTotal {
+    const char*     name;
+    uint32_t        depth;
+    uint64_t        totalNSec;
+    uint64_t        firstFrameOffsetNSec;   // Earliest time the zone was entered, relative to the start of its frame: used for ordering
+};
+
+std::atomic<bool>       gbIsRecording;
+thread_local uint32_t   gtZoneDepth;
+
+static std::mutex                                   gThreadZonesMutex;
+static std::vector<std::unique_ptr<ThreadZones>>    gThreadZones;
+static thread_local ThreadZones*                    gtpThreadZones;
+
+static std::atomic<uint32_t>    gFrameNum;
+static uint64_t                 gFrameStartNSec;
+static uint32_t                 gNumFramesTotaled;
+static std::vector<ZoneTotal>   gZoneTotals;
+static std::vector<ZoneStats>   gAveragedZoneStats;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the zones ring buffer for the current thread, creating it if required
+//------------------------------------------------------------------------------------------------------------------------------------------
+static ThreadZones& getThreadZones() noexcept {
+    if (!gtpThreadZones) {
+        std::lock_guard<std::mutex> lock(gThreadZonesMutex);
+
+        std::unique_ptr<ThreadZones> pThreadZones = std::make_unique<ThreadZones>();
+        pThreadZones->threadIdx = (uint32_t) gThreadZones.size();
+        pThreadZones->numZonesRecorded = 0;
+        pThreadZones->numZonesGathered = 0;
+        pThreadZones->pZones = std::make_unique<Zone[]>(MAX_ZONES_PER_THREAD);
+
+        gtpThreadZones = pThreadZones.get();
+        gThreadZones.push_back(std::move(pThreadZones));
+    }
+
+    return *gtpThreadZones;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the index of the oldest zone in the given thread's ring buffer that is still available
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint64_t getOldestZoneIdx(const uint64_t numZonesRecorded) noexcept {
+    return (numZonesRecorded > MAX_ZONES_PER_THREAD) ? numZonesRecorded - MAX_ZONES_PER_THREAD : 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Adds the time for the given zone to the running totals for the zone stats
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void addToZoneTotals(const Zone& zone) noexcept {
+    const uint64_t durationNSec = zone.endNSec - zone.startNSec;
+    const uint64_t frameOffsetNSec = (zone.startNSec > gFrameStartNSec) ? zone.startNSec - gFrameStartNSec : 0;
+
+    // Note: zones with the same name are merged even if recorded at different nesting levels or on different threads.
+    // The shallowest nesting level is used for display.
+    for (ZoneTotal& total : gZoneTotals) {
+        if (total.name == zone.name) {
+            total.depth = std::min(total.depth, zone.depth);
+            total.totalNSec += durationNSec;
+            total.firstFrameOffsetNSec = std::min(total.firstFrameOffsetNSec, frameOffsetNSec);
+            return;
+        }
+    }
+
+    ZoneTotal& total = gZoneTotals.emplace_back();
+    total.name = zone.name;
+    total.depth = zone.depth;
+    total.totalNSec = durationNSec;
+    total.firstFrameOffsetNSec = frameOffsetNSec;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Turns the zone running totals into averages and clears the totals
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void averageZoneTotals() noexcept {
+    std::sort(
+        gZoneTotals.begin(),
+        gZoneTotals.end(),
+        [](const ZoneTotal& total1, const ZoneTotal& total2) noexcept {
+            return (total1.firstFrameOffsetNSec < total2.firstFrameOffsetNSec);
+        }
+    );
+
+    gAveragedZoneStats.clear();
+
+    for (const ZoneTotal& total : gZoneTotals) {
+        ZoneStats& stats = gAveragedZoneStats.emplace_back();
+        stats.name = total.name;
+        stats.depth = total.depth;
+        stats.avgUSec = total.totalNSec / ((uint64_t) gNumFramesTotaled * 1000);
+    }
+
+    gZoneTotals.clear();
+    gNumFramesTotaled = 0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Calls the given function for every zone still available in the history of all threads, along with the thread index.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class FuncT>
+static void forEachZoneInHistory(const FuncT& func) noexcept {
+    for (const std::unique_ptr<ThreadZones>& pThreadZones : gThreadZones) {
+        const uint64_t numZonesRecorded = pThreadZones->numZonesRecorded.load(std::memory_order_acquire);
+
+        for (uint64_t i = getOldestZoneIdx(numZonesRecorded); i < numZonesRecorded; ++i) {
+            func(pThreadZones->threadIdx, pThreadZones->pZones[i % MAX_ZONES_PER_THREAD]);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the earliest start time of all zones still available in the history of all threads
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint64_t getEarliestZoneStartInHistory() noexcept {
+    uint64_t earliestStartNSec = UINT64_MAX;
+
+    forEachZoneInHistory([&](const uint32_t threadIdx, const Zone& zone) noexcept {
+        MARK_UNUSED(threadIdx);
+        earliestStartNSec = std::min(earliestStartNSec, zone.startNSec);
+    });
+
+    return (earliestStartNSec != UINT64_MAX) ? earliestStartNSec : 0;
+}
+
+void init() noexcept {
+    gbIsRecording.store(false, std::memory_order_relaxed);
+    gFrameNum = 0;
+    gFrameStartNSec = getTimestampNSec();
+    gNumFramesTotaled = 0;
+}
+
+void shutdown() noexcept {
+    gbIsRecording.store(false, std::memory_order_relaxed);
+    gZoneTotals.clear();
+    gAveragedZoneStats.clear();
+    gNumFramesTotaled = 0;
+
+    // Note: the ring buffers for each thread are kept around since they are still referenced by the threads.
+    // Just discard all of the zones recorded so far.
+    std::lock_guard<std::mutex> lock(gThreadZonesMutex);
+
+    for (const std::unique_ptr<ThreadZones>& pThreadZones : gThreadZones) {
+        pThreadZones->numZonesGathered = pThreadZones->numZonesRecorded.load(std::memory_order_acquire);
+    }
+}
+
+void setRecording(const bool bRecord) noexcept {
+    gbIsRecording.store(bRecord, std::memory_order_relaxed);
+}
+
+void endFrame(const uint32_t numFramesToAverage) noexcept {
+    // Gather up all the zones recorded since the last frame (if recording)
+    {
+        std::lock_guard<std::mutex> lock(gThreadZonesMutex);
+
+        for (const std::unique_ptr<ThreadZones>& pThreadZones : gThreadZones) {
+            ThreadZones& threadZones = *pThreadZones;
+            const uint64_t numZonesRecorded = threadZones.numZonesRecorded.load(std::memory_order_acquire);
+            const uint64_t startZoneIdx = std::max(threadZones.numZonesGathered, getOldestZoneIdx(numZonesRecorded));
+
+            if (gbIsRecording.load(std::memory_order_relaxed)) {
+                for (uint64_t i = startZoneIdx; i < numZonesRecorded; ++i) {
+                    addToZoneTotals(threadZones.pZones[i % MAX_ZONES_PER_THREAD]);
+                }
+            }
+
+            threadZones.numZonesGathered = numZonesRecorded;
+        }
+    }
+
+    // Update the averaged stats if it's time and move onto the next frame
+    if (gbIsRecording.load(std::memory_order_relaxed)) {
+        ++gNumFramesTotaled;
+
+        if (gNumFramesTotaled >= std::max(numFramesToAverage, 1u)) {
+            averageZoneTotals();
+        }
+    }
+
+    gFrameNum.fetch_add(1, std::memory_order_relaxed);
+    gFrameStartNSec = getTimestampNSec();
+}
+
+const std::vector<ZoneStats>& getAveragedZoneStats() noexcept {
+    return gAveragedZoneStats;
+}
+
+bool writeCsv(const char* const filePath) noexcept {
+    std::lock_guard<std::mutex> lock(gThreadZonesMutex);
+    const uint64_t earliestStartNSec = getEarliestZoneStartInHistory();
+
+    std::string csv = "thread,frame,depth,zone,start_usec,duration_usec\n";
+    char line[256];
+
+    forEachZoneInHistory([&](const uint32_t threadIdx, const Zone& zone) noexcept {
+        std::snprintf(
+            line,
+            sizeof(line),
+            "%u,%u,%u,%s,%.3f,%.3f\n",
+            threadIdx,
+            zone.frameNum,
+            zone.depth,
+            zone.name,
+            (double)(zone.startNSec - earliestStartNSec) / 1000.0,
+            (double)(zone.endNSec - zone.startNSec) / 1000.0
+        );
+
+        csv += line;
+    });
+
+    return FileUtils::writeDataToFile(filePath, (const std::byte*) csv.data(), csv.size());
+}
+
+bool writeChromeTrace(const char* const filePath) noexcept {
+    std::lock_guard<std::mutex> lock(gThreadZonesMutex);
+    const uint64_t earliestStartNSec = getEarliestZoneStartInHistory();
+
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char line[256];
+    bool bIsFirstZone = true;
+
+    forEachZoneInHistory([&](const uint32_t threadIdx, const Zone& zone) noexcept {
+        std::snprintf(
+            line,
+            sizeof(line),
+            "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+            (bIsFirstZone) ? "" : ",\n",
+            zone.name,
+            threadIdx,
+            (double)(zone.startNSec - earliestStartNSec) / 1000.0,
+            (double)(zone.endNSec - zone.startNSec) / 1000.0,
+            zone.frameNum
+        );
+
+        json += line;
+        bIsFirstZone = false;
+    });
+
+    json += "\n]}\n";
+    return FileUtils::writeDataToFile(filePath, (const std::byte*) json.data(), json.size());
+}
+
+void recordZone(const char* const name, const uint64_t startNSec, const uint64_t endNSec, const uint32_t depth) noexcept {
+    ThreadZones& threadZones = getThreadZones();
+    const uint64_t zoneIdx = threadZones.numZonesRecorded.load(std::memory_order_relaxed);
+
+    Zone& zone = threadZones.pZones[zoneIdx % MAX_ZONES_PER_THREAD];
+    zone.name = name;
+    zone.startNSec = startNSec;
+    zone.endNSec = endNSec;
+    zone.frameNum = gFrameNum.load(std::memory_order_relaxed);
+    zone.depth = depth;
+
+    threadZones.numZonesRecorded.store(zoneIdx + 1, std::memory_order_release);
+}
+
+END_NAMESPACE(Profiler)
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Macros.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Set to '0' to compile out all profiler zones entirely
+#define PROFILER_ENABLED 1
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A lightweight frame level profiler.
+//
+// Code is instrumented with named and nested zones using the 'PROFILE_ZONE' macro. While the profiler is recording, the start and end
+// time of every zone entered is logged to a ring buffer for the thread that entered it. At the end of each frame the zone times are
+// gathered up and averaged for an on-screen breakdown. The recent history of zones can also be saved in CSV or Chrome trace format
+// (viewable with 'chrome://tracing' or similar tools). When the profiler is not recording a zone costs just a single flag check.
+//
+// Notes:
+//  (1) Zone names MUST be string literals (or otherwise live forever), since only the pointer is saved.
+//  (2) Zones are only made visible once they have been exited, so zones can be gathered for a frame while other threads are still
+//      recording zones (e.g when the 3D view is drawn in the background). Those zones will just be counted towards the next frame.
+//      A thread must not record more than 'MAX_ZONES_PER_THREAD' zones in a frame however, otherwise zones are overwritten.
+//------------------------------------------------------------------------------------------------------------------------------------------
+BEGIN_NAMESPACE(Profiler)
+
+// How many zones are kept in the history for each thread
+static constexpr uint32_t MAX_ZONES_PER_THREAD = 32768;
+
+// Details for one zone that was entered and exited
+struct Zone {
+    const char*     name;           // Name of the zone
+    uint64_t        startNSec;      // When the zone was entered and exited (nanoseconds, relative to an unspecified point in time)
+    uint64_t        endNSec;
+    uint32_t        frameNum;       // Which frame the zone was recorded in
+    uint32_t        depth;          // How many other zones the zone was nested inside of on the thread that recorded it
+};
+
+// Average time spent in a particular zone per frame, used for the on-screen breakdown
+struct ZoneStats {
+    const char*     name;           // Name of the zone
+    uint32_t        depth;          // Nesting level of the zone
+    uint64_t        avgUSec;        // Average time spent in the zone per frame (microseconds), for all threads combined
+};
+
+extern std::atomic<bool> gbIsRecording;     // Whether zones are currently being recorded: read by all threads
+
+void init() noexcept;
+void shutdown() noexcept;
+
+// Start or stop recording zones
+void setRecording(const bool bRecord) noexcept;
+
+// Must be called at the end of each frame. Gathers up the zones recorded for the frame and updates the averaged zone stats
+// (for the given number of frames) if it is time to do so.
+void endFrame(const uint32_t numFramesToAverage) noexcept;
+
+// Get the averaged time spent in each zone per frame, in the order the zones were first entered
+const std::vector<ZoneStats>& getAveragedZoneStats() noexcept;
+
+// Save the recent history of recorded zones for all threads to the given file in CSV or Chrome trace (JSON) format.
+// Returns 'false' on failure.
+bool writeCsv(const char* const filePath) noexcept;
+bool writeChromeTrace(const char* const filePath) noexcept;
+
+// Get a timestamp in nanoseconds for profiling
+inline uint64_t getTimestampNSec() noexcept {
+    const auto timeSinceEpoch = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceEpoch).count();
+}
+
+// Saves a zone which was entered and exited on the current thread
+void recordZone(const char* const name, const uint64_t startNSec, const uint64_t endNSec, const uint32_t depth) noexcept;
+
+// The current zone nesting level for the current thread
+extern thread_local uint32_t gtZoneDepth;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Records the zone it is created in, if the profiler is recording.
+// Normally this is used via the 'PROFILE_ZONE' macro.
+//------------------------------------------------------------------------------------------------------------------------------------------
+class Scope {
+public:
+    inline Scope(const char* const name) noexcept
+        : mName(name)
+        , mStartNSec(0)
+        , mDepth(0)
+        , mbIsRecording(gbIsRecording.load(std::memory_order_relaxed))
+    {
+        if (mbIsRecording) {
+            mDepth = gtZoneDepth++;
+            mStartNSec = getTimestampNSec();
+        }
+    }
+
+    inline ~Scope() noexcept {
+        if (mbIsRecording) {
+            --gtZoneDepth;
+            recordZone(mName, mStartNSec, getTimestampNSec(), mDepth);
+        }
+    }
+
+    Scope(const Scope& other) = delete;
+    Scope& operator = (const Scope& other) = delete;
+
+private:
+    const char* const   mName;
+    uint64_t            mStartNSec;
+    uint32_t            mDepth;
+    const bool          mbIsRecording;
+};
+
+END_NAMESPACE(Profiler)
+
+// Macros for declaring a profiler zone that lasts until the end of the current scope
+#define PROFILER_CONCAT_IMPL(A, B) A##B
+#define PROFILER_CONCAT(A, B) PROFILER_CONCAT_IMPL(A, B)
+
+#if PROFILER_ENABLED == 1
+    #define PROFILE_ZONE(Name) const Profiler::Scope PROFILER_CONCAT(profilerZone_, __LINE__)(Name)
+#else
+    #define PROFILE_ZONE(Name)
+#endif
@@ -2,45 +2,42 @@
 
 #include <random>
 
-static std::mt19937 gRandom;
+Random::State Random::gState;
+
+static bool         gbUseFixedSeed;
+static uint32_t     gFixedSeed;
 
 void Random::init() noexcept {
-    std::random_device randomDevice;
-    gRandom.seed(randomDevice());
+    if (gbUseFixedSeed) {
+        init(gFixedSeed);
+    } else {
+        std::random_device randomDevice;
+        init(randomDevice());
+    }
 }
 
 void Random::init(const uint32_t seed) noexcept {
-    gRandom.seed(seed);
-}
-
-bool Random::nextBool() noexcept {
-    return (std::uniform_int_distribution<uint16_t>()(gRandom) & 1) != 0;
-}
-
-uint32_t Random::nextU32() noexcept {
-    return std::uniform_int_distribution<uint32_t>()(gRandom);
-}
+    // Expand the seed into the full generator state using 'SplitMix64', as recommended by the authors of 'xoshiro'.
+    // This also guarantees the state is never all zeros, which would cause the generator to output only zeros.
+    uint64_t splitMixState = seed;
 
-uint32_t Random::nextU32(const uint32_t max) noexcept {
-    return std::uniform_int_distribution<uint32_t>(0, max)(gRandom);
-}
-
-uint16_t Random::nextU16() noexcept {
-    return std::uniform_int_distribution<uint16_t>()(gRandom);
-}
-
-uint16_t Random::nextU16(const uint16_t max) noexcept {
-    return std::uniform_int_distribution<uint16_t>(0, max)(gRandom);
-}
+    for (uint32_t i = 0; i < 2; ++i) {
+        splitMixState += 0x9E3779B97F4A7C15ull;
+        uint64_t z = splitMixState;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z = z ^ (z >> 31);
 
-uint8_t Random::nextU8() noexcept {
-    return (uint8_t) std::uniform_int_distribution<uint16_t>()(gRandom);
+        gState.s[i * 2 + 0] = (uint32_t) z;
+        gState.s[i * 2 + 1] = (uint32_t)(z >> 32);
+    }
 }
 
-uint8_t Random::nextU8(const uint8_t max) noexcept {
-    return (uint8_t) std::uniform_int_distribution<uint16_t>(0, max)(gRandom);
+void Random::setFixedSeed(const uint32_t seed) noexcept {
+    gbUseFixedSeed = true;
+    gFixedSeed = seed;
 }
 
-float Random::nextFloat() noexcept {
-    return std::uniform_real_distribution<float>()(gRandom);
+void Random::clearFixedSeed() noexcept {
+    gbUseFixedSeed = false;
 }
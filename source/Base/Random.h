@@ -1,23 +1,75 @@
+#pragma once
+
 #include <cstdint>
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Random number generation utilities
+// Random number generation utilities.
+//
+// Uses the 'xoshiro128**' generator: it has a small state, is very fast and (unlike the standard library generators and
+// distributions) produces exactly the same sequence of numbers on every compiler and platform for a given seed.
+// Bounded numbers are produced by scaling a 32-bit random number with a 64-bit multiply, which is also fully reproducible.
 //------------------------------------------------------------------------------------------------------------------------------------------
 namespace Random {
+    // The full state of the random number generator: can be saved and restored to repeat a sequence of numbers
+    struct State {
+        uint32_t s[4];
+    };
+
+    extern State gState;
+
     void init() noexcept;
     void init(const uint32_t seed) noexcept;
 
-    bool nextBool() noexcept;
+    // If a fixed seed is set then 'init()' uses that seed rather than a random one, making the game deterministic
+    void setFixedSeed(const uint32_t seed) noexcept;
+    void clearFixedSeed() noexcept;
+
+    inline State getState() noexcept { return gState; }
+    inline void setState(const State& state) noexcept { gState = state; }
+
+    inline uint32_t nextU32() noexcept {
+        const uint32_t rotIn = gState.s[1] * 5;
+        const uint32_t result = ((rotIn << 7) | (rotIn >> 25)) * 9;
+        const uint32_t t = gState.s[1] << 9;
+
+        gState.s[2] ^= gState.s[0];
+        gState.s[3] ^= gState.s[1];
+        gState.s[1] ^= gState.s[2];
+        gState.s[0] ^= gState.s[3];
+        gState.s[2] ^= t;
+        gState.s[3] = (gState.s[3] << 11) | (gState.s[3] >> 21);
+
+        return result;
+    }
+
+    // Gives a number between 0 and 'max' inclusive
+    inline uint32_t nextU32(const uint32_t max) noexcept {
+        const uint64_t range = (uint64_t) max + 1;
+        return (uint32_t)(((uint64_t) nextU32() * range) >> 32);
+    }
+
+    inline bool nextBool() noexcept {
+        return ((nextU32() >> 31) != 0);
+    }
+
+    inline uint16_t nextU16() noexcept {
+        return (uint16_t)(nextU32() >> 16);
+    }
 
-    uint32_t nextU32() noexcept;
-    uint32_t nextU32(const uint32_t max) noexcept;
+    inline uint16_t nextU16(const uint16_t max) noexcept {
+        return (uint16_t) nextU32(max);
+    }
 
-    uint16_t nextU16() noexcept;
-    uint16_t nextU16(const uint16_t max) noexcept;
+    inline uint8_t nextU8() noexcept {
+        return (uint8_t)(nextU32() >> 24);
+    }
 
-    uint8_t nextU8() noexcept;
-    uint8_t nextU8(const uint8_t max) noexcept;
+    inline uint8_t nextU8(const uint8_t max) noexcept {
+        return (uint8_t) nextU32(max);
+    }
 
-    // Gives a float between 0 and 1
-    float nextFloat() noexcept;
+    // Gives a float between 0 and 1 (exclusive)
+    inline float nextFloat() noexcept {
+        return (float)(nextU32() >> 8) * (1.0f / 16777216.0f);
+    }
 }
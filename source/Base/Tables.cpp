@@ -2078,3 +2078,5 @@ float       gGunYScale;
 float       gLightMins[256];
 float       gLightSubs[256];
 float       gLightCoefs[256];
+float       gLightDistToTableIdx[256];
+float       gLightMulTables[256][LIGHT_TABLE_SIZE + 2];
@@ -10,6 +10,8 @@ static constexpr uint32_t ANGLETOFINESHIFT  = 19;               // Convert angle
 static constexpr uint32_t SLOPERANGE        = 2048;             // Number of entries in tantoangle table
 static constexpr uint32_t SLOPEBITS         = 11;               // Power of 2 for SLOPERANGE (2<<11)
 
+static constexpr uint32_t LIGHT_TABLE_SIZE = 256;             // Number of distance steps in the light falloff table for each light level
+
 // The table data and other stuff
 extern Fixed        gFineTangent[4096];
 extern Fixed*       gFineCosine;
@@ -29,3 +31,5 @@ extern float        gGunYScale;                         // Scale factor for play
 extern float        gLightMins[256];                    // Minimum light factors
 extern float        gLightSubs[256];                    // Light subtraction
 extern float        gLightCoefs[256];                   // Light coeffecient
+extern float        gLightDistToTableIdx[256];          // Converts a distance to an index in the light falloff table, for each light level
+extern float        gLightMulTables[256][LIGHT_TABLE_SIZE + 2]; // Light multipliers at evenly spaced distances for each light level (+2 for interpolation at the end)
@@ -0,0 +1,602 @@
+#include "Bench.h"
+
+#include "Audio/Audio.h"
+#include "Base/Profiler.h"
+#include "Base/Random.h"
+#include "Game/Config.h"
+#include "Game/Controls.h"
+#include "Game/Data.h"
+#include "Game/Demo.h"
+#include "Game/DoomDefines.h"
+#include "Game/DoomRez.h"
+#include "Game/Game.h"
+#include "Game/GameDataFS.h"
+#include "Game/Resources.h"
+#include "Game/Tick.h"
+#include "GFX/CelImages.h"
+#include "GFX/Renderer.h"
+#include "GFX/Video.h"
+#include "Map/Setup.h"
+#include "Things/Player.h"
+#include "UI/OptionsMenu.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <SDL.h>
+
+BEGIN_NAMESPACE(Bench)
+
+using namespace Controls;
+
+static constexpr uint32_t NUM_MAPS = 24;    // Number of maps in the game
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// One step in the scripted input path played back by the benchmark: hold down the given game actions for a number of ticks
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct InputStep {
+    uint32_t        numTicks;
+    GameActionBits  actions;
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// The scripted input path: loops once the end is reached.
+// Walks and turns around the level start area, looking in all directions and firing now and again so that a good mix of walls,
+// flats, sprites and weapon effects get drawn. Durations are in game ticks (60 per second).
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr InputStep INPUT_PATH[] = {
+    { 60,   GameActions::NONE                                                   },
+    { 90,   GameActions::MOVE_FORWARD                                           },
+    { 60,   GameActions::TURN_LEFT                                              },
+    { 90,   GameActions::MOVE_FORWARD | GameActions::RUN                        },
+    { 30,   GameActions::ATTACK                                                 },
+    { 30,   GameActions::NONE                                                   },
+    { 120,  GameActions::TURN_RIGHT                                             },
+    { 60,   GameActions::STRAFE_LEFT                                            },
+    { 60,   GameActions::MOVE_BACKWARD | GameActions::TURN_LEFT                 },
+    { 60,   GameActions::STRAFE_RIGHT | GameActions::RUN                        },
+    { 30,   GameActions::USE                                                    },
+    { 30,   GameActions::NONE                                                   },
+    { 90,   GameActions::MOVE_FORWARD | GameActions::TURN_RIGHT                 },
+    { 30,   GameActions::ATTACK                                                 },
+    { 90,   GameActions::MOVE_BACKWARD                                          },
+};
+
+static constexpr uint32_t getInputPathNumTicks() noexcept {
+    uint32_t numTicks = 0;
+
+    for (const InputStep& step : INPUT_PATH) {
+        numTicks += step.numTicks;
+    }
+
+    return numTicks;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Benchmark settings, as specified by the command line
+//------------------------------------------------------------------------------------------------------------------------------------------
+enum class OutputFormat {
+    JSON,
+    CSV
+};
+
+struct Options {
+    uint32_t        mapNum;
+    skill_e         skill;
+    uint32_t        numFrames;
+    uint32_t        numWarmupFrames;
+    uint32_t        renderScale;            // 0 = use the game config
+    uint32_t        numRenderThreads;       // UINT32_MAX = use the game config
+    bool            bPipelinedRendering;    // If set then force pipelined rendering on, otherwise use the game config
+    uint32_t        randomSeed;
+    const char*     demo;                   // Demo slot number or file path to play back instead of the scripted input path, or null
+    OutputFormat    outputFormat;
+    const char*     outputFilePath;         // Null = output to stdout
+    const char*     traceFilePath;          // If not null then save a profiler trace of the timed frames to this file
+    const char*     frameDumpDirPath;       // If not null then save timed frames as images to this folder
+    uint32_t        frameDumpInterval;      // Save every Nth timed frame
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Timing statistics for one phase of the frame
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct PhaseStats {
+    double  total;
+    double  min;
+    double  max;
+
+    void add(const double time) noexcept {
+        total += time;
+        min = std::min(min, time);
+        max = std::max(max, time);
+    }
+};
+
+// Phases of the frame that are timed
+enum Phase : uint32_t {
+    PHASE_TICK,
+    PHASE_BSP_TRAVERSAL,
+    PHASE_WALL_PREP,
+    PHASE_SKY_DRAW,
+    PHASE_FLOOR_DRAW,
+    PHASE_CEILING_DRAW,
+    PHASE_WALL_DRAW,
+    PHASE_SPRITE_DRAW,
+    PHASE_BANDS_DRAW,
+    PHASE_WEAPON_DRAW,
+    PHASE_POST_FX,
+    PHASE_VIEW_DRAW,
+    PHASE_FRAME_DRAW,
+    PHASE_FRAME,
+    NUM_PHASES
+};
+
+static constexpr const char* const PHASE_NAMES[NUM_PHASES] = {
+    "tick",
+    "bspTraversal",
+    "wallPrep",
+    "skyDraw",
+    "floorDraw",
+    "ceilingDraw",
+    "wallDraw",
+    "spriteDraw",
+    "bandsDraw",
+    "weaponDraw",
+    "postFx",
+    "viewDraw",
+    "frameDraw",
+    "frame",
+};
+
+struct Results {
+    PhaseStats  phases[NUM_PHASES];
+    uint32_t    numFrames;
+    uint32_t    numLevelRestarts;
+    double      elapsedTime;
+    uint32_t    screenWidth;            // Render resolution and draw thread count used: saved before shutting down the renderer and video
+    uint32_t    screenHeight;
+    uint32_t    numRenderThreads;
+};
+
+static void printUsage() noexcept {
+    std::printf(
+        "Usage: PhoenixDoomBench [options]\n"
+        "Plays a scripted input path on a map with no window or frame rate limiting and reports timings (in microseconds).\n"
+        "Game data location and other settings not given below come from the normal game config.\n"
+        "\n"
+        "Options:\n"
+        "  --map <num>          Map number to load, from 1 to 24 (default 1)\n"
+        "  --skill <0-4>        Skill level (default 2)\n"
+        "  --frames <num>       Number of frames to time (default 1800)\n"
+        "  --warmup <num>       Number of untimed frames to run first (default 60). Not used with '--demo'.\n"
+        "  --scale <num>        Render scale, overrides the game config\n"
+        "  --threads <num>      Render thread count, overrides the game config (0 = auto)\n"
+        "  --pipelined          Draw each frame while simulating the next tick, overrides the game config\n"
+        "  --seed <num>         Random number generator seed (default 0)\n"
+        "  --demo <slot|path>   Play back the demo in the given slot (1 or 2) or file instead of the scripted input path.\n"
+        "                       The map, skill and seed come from the demo and all of it is played, ignoring '--frames'.\n"
+        "  --csv                Output results as CSV rather than JSON\n"
+        "  --out <path>         Output results to the given file rather than stdout\n"
+        "  --trace <path>       Save a profiler trace (Chrome trace format) of the last timed frames to the given file\n"
+        "  --dump-frames <dir>  Save timed frames as PPM images to the given folder. Timings include the cost of this!\n"
+        "  --dump-every <num>   Only save every Nth frame when '--dump-frames' is used (default 1)\n"
+    );
+}
+
+static bool parseUint(const char* const str, uint32_t& output) noexcept {
+    char* pEnd = nullptr;
+    const unsigned long value = std::strtoul(str, &pEnd, 10);
+
+    if ((pEnd == str) || (*pEnd != 0) || (value > UINT32_MAX))
+        return false;
+
+    output = (uint32_t) value;
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Parse the command line arguments into the given options struct.
+// Returns 'false' and prints a message if the arguments are not valid.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool parseOptions(const int argc, const char* const* const argv, Options& options) noexcept {
+    options = {};
+    options.mapNum = 1;
+    options.skill = sk_medium;
+    options.numFrames = 1800;
+    options.numWarmupFrames = 60;
+    options.renderScale = 0;
+    options.numRenderThreads = UINT32_MAX;
+    options.bPipelinedRendering = false;
+    options.randomSeed = 0;
+    options.demo = nullptr;
+    options.outputFormat = OutputFormat::JSON;
+    options.outputFilePath = nullptr;
+    options.traceFilePath = nullptr;
+    options.frameDumpDirPath = nullptr;
+    options.frameDumpInterval = 1;
+
+    for (int argIdx = 1; argIdx < argc; ++argIdx) {
+        const char* const arg = argv[argIdx];
+        const char* const nextArg = (argIdx + 1 < argc) ? argv[argIdx + 1] : nullptr;
+        bool bUsedNextArg = true;
+        bool bValid = true;
+
+        if (std::strcmp(arg, "--csv") == 0) {
+            options.outputFormat = OutputFormat::CSV;
+            bUsedNextArg = false;
+        }
+        else if (std::strcmp(arg, "--pipelined") == 0) {
+            options.bPipelinedRendering = true;
+            bUsedNextArg = false;
+        }
+        else if ((std::strcmp(arg, "--help") == 0) || (std::strcmp(arg, "-h") == 0)) {
+            printUsage();
+            return false;
+        }
+        else if (!nextArg) {
+            bValid = false;
+        }
+        else if (std::strcmp(arg, "--map") == 0) {
+            bValid = (parseUint(nextArg, options.mapNum) && (options.mapNum >= 1) && (options.mapNum <= NUM_MAPS));
+        }
+        else if (std::strcmp(arg, "--skill") == 0) {
+            uint32_t skill = 0;
+            bValid = (parseUint(nextArg, skill) && (skill <= sk_nightmare));
+            options.skill = (skill_e) skill;
+        }
+        else if (std::strcmp(arg, "--frames") == 0) {
+            bValid = (parseUint(nextArg, options.numFrames) && (options.numFrames >= 1));
+        }
+        else if (std::strcmp(arg, "--warmup") == 0) {
+            bValid = parseUint(nextArg, options.numWarmupFrames);
+        }
+        else if (std::strcmp(arg, "--scale") == 0) {
+            bValid = (parseUint(nextArg, options.renderScale) && (options.renderScale >= 1));
+        }
+        else if (std::strcmp(arg, "--threads") == 0) {
+            bValid = parseUint(nextArg, options.numRenderThreads);
+        }
+        else if (std::strcmp(arg, "--seed") == 0) {
+            bValid = parseUint(nextArg, options.randomSeed);
+        }
+        else if (std::strcmp(arg, "--demo") == 0) {
+            options.demo = nextArg;
+        }
+        else if (std::strcmp(arg, "--out") == 0) {
+            options.outputFilePath = nextArg;
+        }
+        else if (std::strcmp(arg, "--trace") == 0) {
+            options.traceFilePath = nextArg;
+        }
+        else if (std::strcmp(arg, "--dump-frames") == 0) {
+            options.frameDumpDirPath = nextArg;
+        }
+        else if (std::strcmp(arg, "--dump-every") == 0) {
+            bValid = (parseUint(nextArg, options.frameDumpInterval) && (options.frameDumpInterval >= 1));
+        }
+        else {
+            bValid = false;
+        }
+
+        if (!bValid) {
+            std::fprintf(stderr, "Invalid or incomplete argument '%s'! Run with '--help' for a list of options.\n", arg);
+            return false;
+        }
+
+        if (bUsedNextArg) {
+            ++argIdx;
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Initialize just the parts of the game needed to play a map, with no window and no user input
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void init(const Options& options) noexcept {
+    Config::init();
+    Profiler::init();
+
+    if (options.renderScale != 0) {
+        Config::gRenderScale = options.renderScale;
+    }
+
+    if (options.numRenderThreads != UINT32_MAX) {
+        Config::gRenderThreadCount = options.numRenderThreads;
+    }
+
+    if (options.bPipelinedRendering) {
+        Config::gbPipelinedRendering = true;
+    }
+
+    // Sound is still mixed (so that cost is included) but never output anywhere
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+
+    GameDataFS::init();
+    Resources::init();
+    CelImages::init();
+    Video::initHeadless();
+    Audio::init();
+    Audio::loadAllSounds();
+    Controls::init();
+    Renderer::init();
+
+    gpBigNumFont = &CelImages::loadImages(rBIGNUMB, CelLoadFlagBits::MASKED);
+    P_Init();
+    O_Init();
+
+    // Always use the same random number sequence and collect render timings
+    Random::setFixedSeed(options.randomSeed);
+    Renderer::gbCollectFrameTimings = true;
+}
+
+static void shutdown() noexcept {
+    Profiler::shutdown();
+    Renderer::gbCollectFrameTimings = false;
+    Random::clearFixedSeed();
+
+    Renderer::shutdown();
+    Controls::shutdown();
+    Audio::shutdown();
+    Video::shutdown();
+    CelImages::shutdown();
+    Resources::shutdown();
+    GameDataFS::shutdown();
+    Config::shutdown();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Loads the map to be benchmarked, or reloads it if the player died or exited
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void startLevel() noexcept {
+    P_Start();
+
+    // So the scripted path is never cut short by the player dying. Demos must play exactly as recorded however.
+    if (!Demo::isPlaying()) {
+        gPlayer.AutomapFlags |= AF_GODMODE;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Starts playing back the demo specified in the options, if any, and sets the map and skill level to play from the demo.
+// Returns 'false' on failure.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool startDemoPlayback(Options& options) noexcept {
+    if (!options.demo)
+        return true;
+
+    uint32_t slot = 0;
+    const bool bIsSlot = (parseUint(options.demo, slot) && (slot >= 1) && (slot <= Demo::NUM_SLOTS));
+    const bool bStarted = (bIsSlot) ? Demo::startPlayback(slot) : Demo::startPlayback(options.demo);
+
+    if (!bStarted) {
+        std::fprintf(stderr, "Unable to load the demo '%s'!\n", options.demo);
+        return false;
+    }
+
+    const Demo::DemoInfo& demoInfo = Demo::getInfo();
+    options.mapNum = demoInfo.mapNum;
+    options.skill = demoInfo.skill;
+    options.randomSeed = demoInfo.randomSeed;
+    options.numFrames = UINT32_MAX;
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Runs the given number of frames of the scripted input path or demo, with one game tick per frame.
+// If results are given then timings for each frame are added to them.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void runFrames(const uint32_t numFrames, const bool bPlayDemo, uint32_t& inputTickIdx, Results* const pResults) noexcept {
+    for (uint32_t frameNum = 0; frameNum < numFrames; ++frameNum) {
+        // If playing back a demo then it supplies the input: stop when it ends.
+        // Otherwise figure out what input from the scripted path is active for this tick.
+        if (bPlayDemo) {
+            if ((!Demo::isPlaying()) || Demo::isPlaybackFinished())
+                break;
+        } else {
+            uint32_t stepTickIdx = inputTickIdx % getInputPathNumTicks();
+            uint32_t stepIdx = 0;
+
+            while (stepTickIdx >= INPUT_PATH[stepIdx].numTicks) {
+                stepTickIdx -= INPUT_PATH[stepIdx].numTicks;
+                ++stepIdx;
+            }
+
+            Controls::overrideGameActions(INPUT_PATH[stepIdx].actions);
+            ++inputTickIdx;
+        }
+
+        // Simulate and draw
+        const double tickStartTime = Renderer::getTimestampUSec();
+        ++gTotalGameTicks;
+        const gameaction_e gameAction = P_Ticker();
+
+        const double drawStartTime = Renderer::getTimestampUSec();
+        P_Drawer(true, false);
+        const double frameEndTime = Renderer::getTimestampUSec();
+        Profiler::endFrame(1);
+
+        // Restart the level if it ended for whatever reason, so we can keep going.
+        // Demos only cover one level however, so that is the end of playback.
+        if (bPlayDemo && (gameAction != ga_nothing)) {
+            Demo::stopPlayback();
+        }
+
+        const bool bRestartLevel = ((!bPlayDemo) && (gameAction != ga_nothing));
+
+        if (bRestartLevel) {
+            P_Stop();
+            G_PlayerFinishLevel();
+            startLevel();
+        }
+
+        if (!pResults)
+            continue;
+
+        const Renderer::FrameTimings& frameTimings = Renderer::gFrameTimings;
+        PhaseStats* const pPhases = pResults->phases;
+        pPhases[PHASE_TICK].add(drawStartTime - tickStartTime);
+        pPhases[PHASE_BSP_TRAVERSAL].add(frameTimings.bspTraversal);
+        pPhases[PHASE_WALL_PREP].add(frameTimings.wallPrep);
+        pPhases[PHASE_SKY_DRAW].add(frameTimings.skyDraw);
+        pPhases[PHASE_FLOOR_DRAW].add(frameTimings.floorDraw);
+        pPhases[PHASE_CEILING_DRAW].add(frameTimings.ceilingDraw);
+        pPhases[PHASE_WALL_DRAW].add(frameTimings.wallDraw);
+        pPhases[PHASE_SPRITE_DRAW].add(frameTimings.spriteDraw);
+        pPhases[PHASE_BANDS_DRAW].add(frameTimings.bandsDraw);
+        pPhases[PHASE_WEAPON_DRAW].add(frameTimings.weaponDraw);
+        pPhases[PHASE_POST_FX].add(frameTimings.postFx);
+        pPhases[PHASE_VIEW_DRAW].add(frameTimings.total);
+        pPhases[PHASE_FRAME_DRAW].add(frameEndTime - drawStartTime);
+        pPhases[PHASE_FRAME].add(frameEndTime - tickStartTime);
+
+        pResults->numFrames++;
+        pResults->elapsedTime += frameEndTime - tickStartTime;
+
+        if (bRestartLevel) {
+            pResults->numLevelRestarts++;
+        }
+    }
+}
+
+static void writeJsonResults(std::FILE* const pFile, const Options& options, const Results& results) noexcept {
+    const double numFrames = (double) std::max(results.numFrames, 1u);
+    const double fps = (results.elapsedTime > 0.0) ? (numFrames * 1000000.0) / results.elapsedTime : 0.0;
+
+    std::fprintf(pFile, "{\n");
+    std::fprintf(pFile, "  \"map\": %u,\n", options.mapNum);
+    std::fprintf(pFile, "  \"skill\": %u,\n", (uint32_t) options.skill);
+    std::fprintf(pFile, "  \"screenWidth\": %u,\n", results.screenWidth);
+    std::fprintf(pFile, "  \"screenHeight\": %u,\n", results.screenHeight);
+    std::fprintf(pFile, "  \"renderThreads\": %u,\n", results.numRenderThreads);
+    std::fprintf(pFile, "  \"seed\": %u,\n", options.randomSeed);
+    std::fprintf(pFile, "  \"frames\": %u,\n", results.numFrames);
+    std::fprintf(pFile, "  \"levelRestarts\": %u,\n", results.numLevelRestarts);
+    std::fprintf(pFile, "  \"elapsedUSec\": %.3f,\n", results.elapsedTime);
+    std::fprintf(pFile, "  \"fps\": %.3f,\n", fps);
+    std::fprintf(pFile, "  \"phases\": {\n");
+
+    for (uint32_t phaseIdx = 0; phaseIdx < NUM_PHASES; ++phaseIdx) {
+        const PhaseStats& stats = results.phases[phaseIdx];
+        std::fprintf(
+            pFile,
+            "    \"%s\": { \"avgUSec\": %.3f, \"minUSec\": %.3f, \"maxUSec\": %.3f, \"totalUSec\": %.3f }%s\n",
+            PHASE_NAMES[phaseIdx],
+            stats.total / numFrames,
+            stats.min,
+            stats.max,
+            stats.total,
+            (phaseIdx + 1 < NUM_PHASES) ? "," : ""
+        );
+    }
+
+    std::fprintf(pFile, "  }\n");
+    std::fprintf(pFile, "}\n");
+}
+
+static void writeCsvResults(std::FILE* const pFile, const Results& results) noexcept {
+    const double numFrames = (double) std::max(results.numFrames, 1u);
+    const double fps = (results.elapsedTime > 0.0) ? (numFrames * 1000000.0) / results.elapsedTime : 0.0;
+
+    std::fprintf(pFile, "phase,avgUSec,minUSec,maxUSec,totalUSec\n");
+
+    for (uint32_t phaseIdx = 0; phaseIdx < NUM_PHASES; ++phaseIdx) {
+        const PhaseStats& stats = results.phases[phaseIdx];
+        std::fprintf(
+            pFile,
+            "%s,%.3f,%.3f,%.3f,%.3f\n",
+            PHASE_NAMES[phaseIdx],
+            stats.total / numFrames,
+            stats.min,
+            stats.max,
+            stats.total
+        );
+    }
+
+    std::fprintf(pFile, "fps,%.3f,%.3f,%.3f,%.3f\n", fps, fps, fps, fps);
+}
+
+static bool writeResults(const Options& options, const Results& results) noexcept {
+    std::FILE* pFile = stdout;
+
+    if (options.outputFilePath) {
+        pFile = std::fopen(options.outputFilePath, "w");
+
+        if (!pFile) {
+            std::fprintf(stderr, "Unable to open the output file '%s'!\n", options.outputFilePath);
+            return false;
+        }
+    }
+
+    if (options.outputFormat == OutputFormat::CSV) {
+        writeCsvResults(pFile, results);
+    } else {
+        writeJsonResults(pFile, options, results);
+    }
+
+    if (pFile != stdout) {
+        std::fclose(pFile);
+    }
+
+    return true;
+}
+
+int run(const int argc, const char* const* const argv) noexcept {
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    init(options);
+
+    if (!startDemoPlayback(options)) {
+        shutdown();
+        return 1;
+    }
+
+    // Load the level and play it, with a few warmup frames first to let caches etc. settle (except for demos)
+    G_InitNew(options.skill, options.mapNum);
+    gTotalGameTicks = 0;
+    startLevel();
+
+    Results results = {};
+
+    for (PhaseStats& stats : results.phases) {
+        stats.min = std::numeric_limits<double>::max();
+    }
+
+    // Note: no warmup when playing a demo, so that all of the demo is timed
+    uint32_t inputTickIdx = 0;
+    const bool bPlayDemo = (options.demo != nullptr);
+
+    if (!bPlayDemo) {
+        runFrames(options.numWarmupFrames, bPlayDemo, inputTickIdx, nullptr);
+    }
+
+    Profiler::setRecording(options.traceFilePath != nullptr);
+    Video::setFrameDumping(options.frameDumpDirPath, options.frameDumpInterval);
+    runFrames(options.numFrames, bPlayDemo, inputTickIdx, &results);
+    Video::setFrameDumping(nullptr, 1);
+    Profiler::setRecording(false);
+
+    bool bSuccess = true;
+
+    if (options.traceFilePath && (!Profiler::writeChromeTrace(options.traceFilePath))) {
+        std::fprintf(stderr, "Unable to write the trace file '%s'!\n", options.traceFilePath);
+        bSuccess = false;
+    }
+
+    // Save the render settings used before shutting everything down, since that resets them
+    results.screenWidth = Video::gScreenWidth;
+    results.screenHeight = Video::gScreenHeight;
+    results.numRenderThreads = Renderer::getNumDrawThreads();
+
+    P_Stop();
+    shutdown();
+
+    return (writeResults(options, results) && bSuccess) ? 0 : 1;
+}
+
+END_NAMESPACE(Bench)
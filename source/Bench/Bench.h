@@ -0,0 +1,12 @@
+#pragma once
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Headless benchmark for the game.
+//
+// Loads a map, plays back a scripted input path with no window and no frame rate throttling and reports how long the various
+// phases of simulation and rendering took. Results are output in a machine readable format (JSON or CSV), so that render and
+// sim performance regressions can be caught in automated builds. Run with '--help' for a list of options.
+//------------------------------------------------------------------------------------------------------------------------------------------
+namespace Bench {
+    int run(const int argc, const char* const* const argv) noexcept;
+}
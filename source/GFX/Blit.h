@@ -2,6 +2,7 @@
 
 #include "Base/Fixed.h"
 #include "Base/Macros.h"
+#include "SIMD.h"
 #include <algorithm>
 #include <cmath>
 
@@ -16,6 +17,20 @@
     #define BLIT_ASSERT()
 #endif
 
+// Whether SIMD versions of some blitting operations are used, and which instruction set is used: follows what 'SIMD.h' detects.
+// Set 'BLIT_SIMD_ENABLED' to '0' beforehand to force the plain scalar code to always be used for blitting.
+#ifndef BLIT_SIMD_ENABLED
+    #if SIMD_SSE2
+        #define BLIT_SIMD_ENABLED 1
+        #define BLIT_SIMD_SSE2 1
+    #elif SIMD_NEON
+        #define BLIT_SIMD_ENABLED 1
+        #define BLIT_SIMD_NEON 1
+    #else
+        #define BLIT_SIMD_ENABLED 0
+    #endif
+#endif
+
 namespace Blit {
     //------------------------------------------------------------------------------------------------------------------
     // Flags for when blitting a column.
@@ -112,6 +127,83 @@ namespace Blit {
         }
     }
 
+    //------------------------------------------------------------------------------------------------------------------
+    // Decodes 4 source image pixels in either ARGB1555 or ARGB8888 format to XRGB8888 and optionally applies a color
+    // multiply. The results are exactly the same as the per pixel conversion done in 'blitColumn'.
+    // Only available when SIMD blitting is enabled; new instruction sets just need to add an implementation here.
+    //------------------------------------------------------------------------------------------------------------------
+    #if BLIT_SIMD_ENABLED == 1
+        template <bool DO_COLOR_MULT_RGB, class SrcPixelT>
+        inline void decodePixels4(
+            const uint32_t srcPixels[4],                    // Source pixels in ARGB1555 or ARGB8888 format, zero extended to 32-bits
+            uint32_t dstPixels[4],                          // Output pixels in XRGB8888 format
+            [[maybe_unused]] const float rMul,
+            [[maybe_unused]] const float gMul,
+            [[maybe_unused]] const float bMul
+        ) noexcept {
+            #if BLIT_SIMD_SSE2
+                const __m128i srcPixelsV = _mm_loadu_si128((const __m128i*) srcPixels);
+                __m128i texR;
+                __m128i texG;
+                __m128i texB;
+
+                if constexpr (std::is_same_v<SrcPixelT, uint16_t>) {
+                    texR = _mm_srli_epi32(_mm_and_si128(srcPixelsV, _mm_set1_epi32(0b0111110000000000)), 7);
+                    texG = _mm_srli_epi32(_mm_and_si128(srcPixelsV, _mm_set1_epi32(0b0000001111100000)), 2);
+                    texB = _mm_slli_epi32(_mm_and_si128(srcPixelsV, _mm_set1_epi32(0b0000000000011111)), 3);
+                } else {
+                    texR = _mm_and_si128(_mm_srli_epi32(srcPixelsV, 16), _mm_set1_epi32(0xFF));
+                    texG = _mm_and_si128(_mm_srli_epi32(srcPixelsV, 8), _mm_set1_epi32(0xFF));
+                    texB = _mm_and_si128(srcPixelsV, _mm_set1_epi32(0xFF));
+                }
+
+                if constexpr (DO_COLOR_MULT_RGB) {
+                    // Note: all values are within 0-255 after this so signed int conversions are fine
+                    const __m128 maxColor = _mm_set1_ps(255.0f);
+                    texR = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(texR), _mm_set1_ps(rMul)), maxColor));
+                    texG = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(texG), _mm_set1_ps(gMul)), maxColor));
+                    texB = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(texB), _mm_set1_ps(bMul)), maxColor));
+                }
+
+                const __m128i dstPixelsV = _mm_or_si128(
+                    _mm_or_si128(_mm_slli_epi32(texR, 16), _mm_slli_epi32(texG, 8)),
+                    texB
+                );
+
+                _mm_storeu_si128((__m128i*) dstPixels, dstPixelsV);
+            #elif BLIT_SIMD_NEON
+                const uint32x4_t srcPixelsV = vld1q_u32(srcPixels);
+                uint32x4_t texR;
+                uint32x4_t texG;
+                uint32x4_t texB;
+
+                if constexpr (std::is_same_v<SrcPixelT, uint16_t>) {
+                    texR = vshrq_n_u32(vandq_u32(srcPixelsV, vdupq_n_u32(0b0111110000000000)), 7);
+                    texG = vshrq_n_u32(vandq_u32(srcPixelsV, vdupq_n_u32(0b0000001111100000)), 2);
+                    texB = vshlq_n_u32(vandq_u32(srcPixelsV, vdupq_n_u32(0b0000000000011111)), 3);
+                } else {
+                    texR = vandq_u32(vshrq_n_u32(srcPixelsV, 16), vdupq_n_u32(0xFF));
+                    texG = vandq_u32(vshrq_n_u32(srcPixelsV, 8), vdupq_n_u32(0xFF));
+                    texB = vandq_u32(srcPixelsV, vdupq_n_u32(0xFF));
+                }
+
+                if constexpr (DO_COLOR_MULT_RGB) {
+                    const float32x4_t maxColor = vdupq_n_f32(255.0f);
+                    texR = vcvtq_u32_f32(vminq_f32(vmulq_n_f32(vcvtq_f32_u32(texR), rMul), maxColor));
+                    texG = vcvtq_u32_f32(vminq_f32(vmulq_n_f32(vcvtq_f32_u32(texG), gMul), maxColor));
+                    texB = vcvtq_u32_f32(vminq_f32(vmulq_n_f32(vcvtq_f32_u32(texB), bMul), maxColor));
+                }
+
+                const uint32x4_t dstPixelsV = vorrq_u32(
+                    vorrq_u32(vshlq_n_u32(texR, 16), vshlq_n_u32(texG, 8)),
+                    texB
+                );
+
+                vst1q_u32(dstPixels, dstPixelsV);
+            #endif
+        }
+    #endif
+
     //------------------------------------------------------------------------------------------------------------------
     // Blits a column of pixels from the given source image in either ARGB1555 or ARGB8888 format to the destination
     // pixel buffer which is in XRGB8888 format and ROW MAJOR. Optionally, alpha testing and blending can be applied.
@@ -332,6 +424,40 @@ namespace Blit {
         [[maybe_unused]] bool bDidHWrapDiscardClamp = false;
         [[maybe_unused]] bool bDidVWrapDiscardClamp = false;
 
+        // Fast path for the most common case (walls and skies): a vertical column stepping down a column major image, with
+        // no alpha and no discarding of pixels. Pixels are fetched 4 at a time and then decoded and colored using SIMD.
+        // Any leftover pixels are handled by the regular loop below.
+        constexpr bool USE_SIMD_COLUMN = (
+            (BLIT_SIMD_ENABLED == 1) &&
+            IS_VERT_COLUMN &&
+            USE_SRC_COL_INDEXING &&
+            (!NEED_ALPHA_CHANNEL) &&
+            (!DO_V_WRAP_DISCARD)
+        );
+
+        #if BLIT_SIMD_ENABLED == 1
+            if constexpr (USE_SIMD_COLUMN) {
+                for (uint32_t numPixelsLeft = dstCount; numPixelsLeft >= 4; numPixelsLeft -= 4) {
+                    uint32_t srcPixels[4];
+                    uint32_t dstPixels[4];
+
+                    for (uint32_t i = 0; i < 4; ++i) {
+                        curSrcYInt = wrapYCoord<BC_FLAGS>((int32_t) curSrcYInt, srcH);
+                        srcPixels[i] = pSrcRowOrCol[curSrcYInt];
+                        nextSrcY += srcYStep;
+                        curSrcYInt = (uint32_t) nextSrcY;
+                    }
+
+                    decodePixels4<DO_COLOR_MULT_RGB, SrcPixelT>(srcPixels, dstPixels, rMul, gMul, bMul);
+
+                    for (uint32_t i = 0; i < 4; ++i) {
+                        *pDstPixel = dstPixels[i];
+                        pDstPixel += dstPixelsPitch;
+                    }
+                }
+            }
+        #endif
+
         while (pDstPixel < pEndDstPixel) {
             do {
                 // Do discard wrapping.
@@ -12,6 +12,7 @@ struct ImageData {
     uint32_t    width;
     uint32_t    height;
     uint16_t*   pPixels;
+    uint32_t*   pPixels32;      // Optional copy of 'pPixels' expanded to ARGB8888 format for faster rendering, or 'nullptr' if not available
 };
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -44,4 +45,25 @@ namespace ImageDataUtils {
         b = T((pixel >> 1) & uint16_t(0x1F));
         a = T(pixel & uint16_t(0x01));
     }
+
+    // Expand an ARGB1555 pixel to ARGB8888 format. RGB components are expanded in exactly the same way as blitting code expands
+    // them, so the expanded pixel can be used in place of the original when rendering. Alpha is expanded to either 0 or 255.
+    inline constexpr uint32_t expandARGB1555PixelToARGB8888(const uint16_t pixel) noexcept {
+        const uint32_t a = ((pixel & uint16_t(0b1000000000000000)) != 0) ? 0xFF000000u : 0u;
+        const uint32_t r = (uint32_t)(pixel & uint16_t(0b0111110000000000)) << 9;
+        const uint32_t g = (uint32_t)(pixel & uint16_t(0b0000001111100000)) << 6;
+        const uint32_t b = (uint32_t)(pixel & uint16_t(0b0000000000011111)) << 3;
+        return (a | r | g | b);
+    }
+
+    // Expands all the given ARGB1555 pixels to a newly allocated buffer of ARGB8888 pixels, which should be freed with 'MemFree'
+    inline uint32_t* allocExpandedARGB8888Pixels(const uint16_t* const pPixels, const uint32_t numPixels) noexcept {
+        uint32_t* const pExpandedPixels = reinterpret_cast<uint32_t*>(MemAlloc(numPixels * sizeof(uint32_t)));
+
+        for (uint32_t i = 0; i < numPixels; ++i) {
+            pExpandedPixels[i] = expandARGB1555PixelToARGB8888(pPixels[i]);
+        }
+
+        return pExpandedPixels;
+    }
 }
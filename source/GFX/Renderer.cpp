@@ -1,5 +1,6 @@
 #include "Renderer_Internal.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
 #include "Blit.h"
 #include "Game/Config.h"
@@ -8,6 +9,8 @@
 #include "Textures.h"
 #include "Things/MapObj.h"
 #include "Video.h"
+#include <chrono>
+#include <cstring>
 
 BEGIN_NAMESPACE(Renderer)
 
@@ -30,6 +33,8 @@ static constexpr ScreenSize REFERENCE_SCREEN_SIZES[6] = {
 // Internal renderer cross module globals
 //------------------------------------------------------------------------------------------------------------------------------------------
 float                           gDebugCameraZOffset;
+bool                            gbCollectFrameTimings;
+FrameTimings                    gFrameTimings;
 Fixed                           gViewXFrac;
 Fixed                           gViewYFrac;
 Fixed                           gViewZFrac;
@@ -61,16 +66,48 @@ float                           gNearPlaneYStepPerViewCol;
 float                           gNearPlaneZStepPerViewColPixel;
 ProjectionMatrix                gProjMatrix;
 uint32_t                        gExtraLight;
+uint32_t*                       gpViewPixels;
+uint32_t                        gViewPixelsPitch;
 std::vector<angle_t>            gScreenXToAngleBAM;
-std::vector<DrawSeg>            gDrawSegs;
+Arena                           gFrameArena;
 std::vector<SegClip>            gSegClip;
 std::vector<OccludingColumns>   gOccludingCols;
+ArenaVector<OccluderBlock>      gOccluderBlocks{ ArenaAllocator<OccluderBlock>(gFrameArena) };
 uint32_t                        gNumFullSegCols;
-std::vector<WallFragment>       gWallFragments;
-std::vector<FlatFragment>       gFloorFragments;
-std::vector<FlatFragment>       gCeilFragments;
-std::vector<SkyFragment>        gSkyFragments;
-std::vector<DrawSprite>         gDrawSprites;
+std::vector<CoverageTile>       gCoverageTiles;
+ArenaVector<WallFragment>       gWallFragments{ ArenaAllocator<WallFragment>(gFrameArena) };
+ArenaVector<FlatFragment>       gFloorFragments{ ArenaAllocator<FlatFragment>(gFrameArena) };
+ArenaVector<FlatFragment>       gCeilFragments{ ArenaAllocator<FlatFragment>(gFrameArena) };
+ArenaVector<SkyFragment>        gSkyFragments{ ArenaAllocator<SkyFragment>(gFrameArena) };
+ArenaVector<DrawSprite>         gDrawSprites{ ArenaAllocator<DrawSprite>(gFrameArena) };
+
+// State for drawing the 3D view asynchronously
+static bool     gbIsDrawingPlayerViewAsync;     // True if 'beginDrawPlayerView' has been called without a matching 'endDrawPlayerView'
+static double           gAsyncDrawStartTime;            // When drawing the view began (only if collecting frame timings)
+static double           gAsyncBandsDrawStartTime;       // When drawing all of the bands began (only if collecting frame timings)
+static FrameTimings     gAsyncFrameTimings;             // Timings so far for the view being drawn (only if collecting frame timings)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Dynamic resolution state.
+// When enabled the scene in the 3D view (everything except the weapon) may be drawn at a fraction of the full view size to an internal
+// buffer and then scaled up to fill the view in the framebuffer. The fraction is adjusted according to how long the scene takes to draw.
+// The view size is one of a small number of fixed steps, so that the tables which depend on the view size can be cached for each step.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t DYNAMIC_RES_NUM_STEPS = 16;           // The view is scaled by 'step / DYNAMIC_RES_NUM_STEPS' in each direction
+static constexpr uint32_t DYNAMIC_RES_CHANGE_COOLDOWN = 8;      // How many frames to wait after changing the view scale before changing it again
+static constexpr double   DYNAMIC_RES_INCREASE_THRESHOLD = 0.7; // Only increase the view scale if the draw time is under this fraction of the target
+static constexpr double   DYNAMIC_RES_TIME_SMOOTHING = 0.25;    // How much weight the latest draw time gets in the smoothed draw time
+
+static uint32_t                 gFullViewWidth;                                     // Size of the 3D view at full resolution
+static uint32_t                 gFullViewHeight;
+static uint32_t                 gViewScaleStep = DYNAMIC_RES_NUM_STEPS;             // Scale step of the view size currently set up
+static uint32_t                 gTargetViewScaleStep = DYNAMIC_RES_NUM_STEPS;       // Scale step to draw the next frame at
+static uint32_t                 gViewScaleCooldown;                                 // Frames left until the view scale can be changed again
+static double                   gSmoothedSceneDrawTime;                             // Smoothed time taken to draw the scene (microseconds)
+static double                   gSceneDrawStartTime;                                // When drawing the scene started for the current frame
+static std::vector<angle_t>     gScreenXToAngleBAMCache[DYNAMIC_RES_NUM_STEPS + 1]; // Cached 'gScreenXToAngleBAM' tables for the other scale steps
+static std::vector<uint32_t>    gScaledViewPixels;                                  // Buffer the scene is drawn to when drawing at less than full size
+static std::vector<uint32_t>    gUpscaleSrcX;                                       // For each column of the full size view, which column of the scaled view to copy
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Load in the "TextureInfo" array so that the game knows all about the wall and sky textures (Width,Height).
@@ -151,17 +188,310 @@ static void setupOccludingColumnsArrayForDraw() noexcept {
         pOccludingCols[5].count = 0;
         pOccludingCols[6].count = 0;
         pOccludingCols[7].count = 0;
+        pOccludingCols[0].lastBlockIdx = OccluderBlock::INVALID_IDX;
+        pOccludingCols[1].lastBlockIdx = OccluderBlock::INVALID_IDX;
+        pOccludingCols[2].lastBlockIdx = OccluderBlock::INVALID_IDX;
+        pOccludingCols[3].lastBlockIdx = OccluderBlock::INVALID_IDX;
+        pOccludingCols[4].lastBlockIdx = OccluderBlock::INVALID_IDX;
+        pOccludingCols[5].lastBlockIdx = OccluderBlock::INVALID_IDX;
+        pOccludingCols[6].lastBlockIdx = OccluderBlock::INVALID_IDX;
+        pOccludingCols[7].lastBlockIdx = OccluderBlock::INVALID_IDX;
         pOccludingCols += 8;
     }
 
     // Clear any remaining entries
     while (pOccludingCols < pEndOccludingCols) {
         pOccludingCols[0].count = 0;
+        pOccludingCols[0].lastBlockIdx = OccluderBlock::INVALID_IDX;
         ++pOccludingCols;
     }
+
+    // Note: the occluder blocks from the previous frame are freed when the frame arena is reset
+}
+
+static void setupCoverageTilesForDraw() noexcept {
+    // Nothing is covered at the start of the frame
+    const uint32_t numTiles = (g3dViewWidth + CoverageTile::NUM_COLS - 1) / CoverageTile::NUM_COLS;
+    gCoverageTiles.assign(numTiles, CoverageTile{ 0, 0, 0.0f });
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if the given column of the occluding columns leaves nothing visible, i.e the last occluding column covers all of it
+//------------------------------------------------------------------------------------------------------------------------------------------
+static inline bool isOccludingColumnFull(const OccludingColumns& cols) noexcept {
+    if (cols.count <= 0)
+        return false;
+
+    const OccluderBlock& lastBlock = gOccluderBlocks[cols.lastBlockIdx];
+    const OccluderBlock::Bounds lastBounds = lastBlock.bounds[lastBlock.count - 1];
+    return (lastBounds.top + 1 >= lastBounds.bottom);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if all the screen columns in the given inclusive range will accept no more wall or floor pixels.
+// Whole coverage tiles within the range are checked at once, only columns in partially overlapped tiles are checked individually.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool isScreenRangeFullOfSegs(const uint32_t lx, const uint32_t rx) noexcept {
+    ASSERT((lx <= rx) && (rx < g3dViewWidth));
+    uint32_t x = lx;
+
+    while (x <= rx) {
+        if ((x % CoverageTile::NUM_COLS == 0) && (x + CoverageTile::NUM_COLS - 1 <= rx)) {
+            if (gCoverageTiles[x / CoverageTile::NUM_COLS].numFullSegCols < CoverageTile::NUM_COLS)
+                return false;
+
+            x += CoverageTile::NUM_COLS;
+        } else {
+            const SegClip clipBounds = gSegClip[x];
+
+            if (clipBounds.top < clipBounds.bottom)
+                return false;
+
+            ++x;
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if a sprite at the given depth would be completely clipped away by the occluding columns in the given inclusive range of screen
+// columns. This is the case if the last occluding column in each screen column leaves nothing visible and its line is definitely in
+// front of the sprite by depth, which is exactly the test done first when clipping sprite columns for drawing.
+//------------------------------------------------------------------------------------------------------------------------------------------
+bool isScreenRangeOccluded(const uint32_t lx, const uint32_t rx, const float depth) noexcept {
+    ASSERT((lx <= rx) && (rx < g3dViewWidth));
+    uint32_t x = lx;
+
+    while (x <= rx) {
+        if ((x % CoverageTile::NUM_COLS == 0) && (x + CoverageTile::NUM_COLS - 1 <= rx)) {
+            const CoverageTile& tile = gCoverageTiles[x / CoverageTile::NUM_COLS];
+
+            if ((tile.numOccludedCols < CoverageTile::NUM_COLS) || (depth <= tile.maxOccluderDepth))
+                return false;
+
+            x += CoverageTile::NUM_COLS;
+        } else {
+            const OccludingColumns& cols = gOccludingCols[x];
+
+            if (!isOccludingColumnFull(cols))
+                return false;
+
+            const OccluderBlock& lastBlock = gOccluderBlocks[cols.lastBlockIdx];
+
+            if (depth <= lastBlock.lineMaxDepths[lastBlock.count - 1])
+                return false;
+
+            ++x;
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Builds the table which converts from a screen X coordinate in the 3D view to a view relative angle, for the given view width
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void buildScreenXToAngleTable(std::vector<angle_t>& table, const uint32_t viewW) noexcept {
+    table.resize(viewW);
+    const float screenXToT = 1.0f / ((float) viewW - 1.0f);
+
+    for (uint32_t x = 0; x < viewW; ++x) {
+        const float t = ((float) x + 0.5f) * screenXToT;
+        const float nearPlaneX = t * gNearPlaneW - gNearPlaneHalfW;
+        const float angleRad = std::atan2(Z_NEAR, nearPlaneX);
+        const angle_t angleBAM = radiansToBamAngle(angleRad);
+        table[x] = angleBAM;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Switches the 3D view size to the given dynamic resolution scale step, along with everything that depends on the view size.
+// The screen X to angle tables for each step are kept around, so switching is cheap once every step in use has been visited.
+// Other per column arrays (seg clip bounds, occluding columns etc.) are resized each frame as required.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void setViewScaleStep(const uint32_t step) noexcept {
+    ASSERT((step > 0) && (step <= DYNAMIC_RES_NUM_STEPS));
+
+    if (step == gViewScaleStep)
+        return;
+
+    std::swap(gScreenXToAngleBAM, gScreenXToAngleBAMCache[gViewScaleStep]);
+
+    g3dViewWidth = std::max((gFullViewWidth * step) / DYNAMIC_RES_NUM_STEPS, 1u);
+    g3dViewHeight = std::max((gFullViewHeight * step) / DYNAMIC_RES_NUM_STEPS, 1u);
+    gCenterX = g3dViewWidth / 2;
+    gCenterY = g3dViewHeight / 2;
+
+    std::vector<angle_t>& screenXToAngleBAM = gScreenXToAngleBAMCache[step];
+
+    if (screenXToAngleBAM.size() != g3dViewWidth) {
+        buildScreenXToAngleTable(screenXToAngleBAM, g3dViewWidth);
+    }
+
+    std::swap(gScreenXToAngleBAM, screenXToAngleBAM);
+    gViewScaleStep = step;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Sets up the 3D view size for drawing the scene, and where the scene is drawn to
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void setupViewSizeForDraw() noexcept {
+    const uint32_t step = (Config::gbDynamicResolution) ? gTargetViewScaleStep : DYNAMIC_RES_NUM_STEPS;
+    setViewScaleStep(step);
+
+    if (step < DYNAMIC_RES_NUM_STEPS) {
+        const size_t numViewPixels = (size_t) g3dViewWidth * g3dViewHeight;
+
+        if (gScaledViewPixels.size() < numViewPixels) {
+            gScaledViewPixels.resize(numViewPixels);
+        }
+
+        gpViewPixels = gScaledViewPixels.data();
+        gViewPixelsPitch = g3dViewWidth;
+    } else {
+        gpViewPixels = Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * Video::gScreenWidth + g3dViewXOffset;
+        gViewPixelsPitch = Video::gScreenWidth;
+    }
+
+    gSceneDrawStartTime = getTimestampUSec();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Scales up the scene drawn at less than full size to fill the 3D view in the framebuffer, using nearest neighbor sampling.
+// Rows of the framebuffer which sample the same scene row as the row above are just copied from the row above.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void upscaleSceneToFrameBuffer() noexcept {
+    PROFILE_ZONE("Upscale Scene");
+
+    const uint32_t srcW = g3dViewWidth;
+    const uint32_t srcH = g3dViewHeight;
+    const uint32_t dstW = gFullViewWidth;
+    const uint32_t dstH = gFullViewHeight;
+    const uint32_t dstPitch = Video::gScreenWidth;
+
+    gUpscaleSrcX.resize(dstW);
+
+    for (uint32_t x = 0; x < dstW; ++x) {
+        gUpscaleSrcX[x] = (x * srcW) / dstW;
+    }
+
+    const uint32_t* const pSrcX = gUpscaleSrcX.data();
+    uint32_t* const pDstPixels = Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * dstPitch + g3dViewXOffset;
+    uint32_t lastSrcY = UINT32_MAX;
+
+    for (uint32_t y = 0; y < dstH; ++y) {
+        const uint32_t srcY = (y * srcH) / dstH;
+        uint32_t* const pDstRow = pDstPixels + (uintptr_t) y * dstPitch;
+
+        if (srcY == lastSrcY) {
+            std::memcpy(pDstRow, pDstRow - dstPitch, dstW * sizeof(uint32_t));
+            continue;
+        }
+
+        const uint32_t* const pSrcRow = gScaledViewPixels.data() + (uintptr_t) srcY * srcW;
+
+        for (uint32_t x = 0; x < dstW; ++x) {
+            pDstRow[x] = pSrcRow[pSrcX[x]];
+        }
+
+        lastSrcY = srcY;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Decides what view scale to draw the next frame at, from how long the scene took to draw this frame
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void updateDynamicResolution(const double sceneDrawTime) noexcept {
+    if (!Config::gbDynamicResolution) {
+        gTargetViewScaleStep = DYNAMIC_RES_NUM_STEPS;
+        gSmoothedSceneDrawTime = 0.0;
+        gViewScaleCooldown = 0;
+        return;
+    }
+
+    gSmoothedSceneDrawTime += (sceneDrawTime - gSmoothedSceneDrawTime) * DYNAMIC_RES_TIME_SMOOTHING;
+
+    if (gViewScaleCooldown > 0) {
+        --gViewScaleCooldown;
+        return;
+    }
+
+    const uint32_t minStep = std::max((Config::gDynamicResolutionMinScale * DYNAMIC_RES_NUM_STEPS + 99) / 100, 1u);
+    const double targetTime = (double) Config::gDynamicResolutionTargetMs * 1000.0;
+    uint32_t step = std::max(gTargetViewScaleStep, minStep);
+
+    if ((gSmoothedSceneDrawTime > targetTime) && (step > minStep)) {
+        --step;
+    } else if ((gSmoothedSceneDrawTime < targetTime * DYNAMIC_RES_INCREASE_THRESHOLD) && (step < DYNAMIC_RES_NUM_STEPS)) {
+        ++step;
+    }
+
+    if (step != gTargetViewScaleStep) {
+        gTargetViewScaleStep = step;
+        gViewScaleCooldown = DYNAMIC_RES_CHANGE_COOLDOWN;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Called once the scene has been drawn: scales it up to the framebuffer if it was drawn at less than full size and switches back to the
+// full view size for drawing the weapon and post fx. Also updates the dynamic resolution with how long the scene took to draw.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void finishDrawingScene() noexcept {
+    const double sceneDrawTime = getTimestampUSec() - gSceneDrawStartTime;
+
+    if (gViewScaleStep < DYNAMIC_RES_NUM_STEPS) {
+        upscaleSceneToFrameBuffer();
+        setViewScaleStep(DYNAMIC_RES_NUM_STEPS);
+    }
+
+    gpViewPixels = Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * Video::gScreenWidth + g3dViewXOffset;
+    gViewPixelsPitch = Video::gScreenWidth;
+    updateDynamicResolution(sceneDrawTime);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Makes room up front in an emptied list for the number of elements it had in the previous frame (plus some) so it is unlikely to grow
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class T>
+static void reserveFrameList(ArenaVector<T>& list, const size_t lastFrameSize, const size_t minCapacity) noexcept {
+    list.reserve(std::max(lastFrameSize + lastFrameSize / 4, minCapacity));
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Frees everything allocated for the previous frame from the frame arena and sets up the lists of things to draw for the new frame.
+// Since the lists are sized up front based on the previous frame, and the arena grows to fit the most memory ever used in a frame,
+// normally no memory is allocated from the system during a frame.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void setupFrameArenaForDraw() noexcept {
+    // Make all the lists give up their memory before freeing it all at once, remembering how big each list was
+    const size_t numOccluderBlocks = gOccluderBlocks.size();
+    const size_t numWallFragments = gWallFragments.size();
+    const size_t numFloorFragments = gFloorFragments.size();
+    const size_t numCeilFragments = gCeilFragments.size();
+    const size_t numSkyFragments = gSkyFragments.size();
+    const size_t numDrawSprites = gDrawSprites.size();
+
+    releaseArenaVector(gOccluderBlocks, gFrameArena);
+    releaseArenaVector(gWallFragments, gFrameArena);
+    releaseArenaVector(gFloorFragments, gFrameArena);
+    releaseArenaVector(gCeilFragments, gFrameArena);
+    releaseArenaVector(gSkyFragments, gFrameArena);
+    releaseArenaVector(gDrawSprites, gFrameArena);
+    gFrameArena.reset();
+
+    reserveFrameList(gOccluderBlocks, numOccluderBlocks, 1024 * 4);
+    reserveFrameList(gWallFragments, numWallFragments, 1024 * 8);
+    reserveFrameList(gFloorFragments, numFloorFragments, 1024 * 8);
+    reserveFrameList(gCeilFragments, numCeilFragments, 1024 * 8);
+    reserveFrameList(gSkyFragments, numSkyFragments, 1024);
+    reserveFrameList(gDrawSprites, numDrawSprites, 128);
 }
 
 static void preDrawSetup() noexcept {
+    // Decide what resolution to draw the scene at and where to draw it to
+    setupViewSizeForDraw();
+
     // Set the position and angle of the view from the player
     const player_t& player = gPlayer;
     const mobj_t& mapObj = *player.mo;
@@ -209,32 +539,44 @@ static void preDrawSetup() noexcept {
     gNearPlaneZStepPerViewColPixel = (gNearPlaneBz - gNearPlaneTz) / ((float) g3dViewHeight);
 
     // Clear render arrays & buffers
+    setupFrameArenaForDraw();
     setupSegYClipArrayForDraw();
     setupOccludingColumnsArrayForDraw();
-
-    gWallFragments.clear();
-    gFloorFragments.clear();
-    gCeilFragments.clear();
-    gSkyFragments.clear();
-    gDrawSprites.clear();
+    setupCoverageTilesForDraw();
 
     // Other misc setup
     gExtraLight = player.extralight << 6;       // Init the extra lighting value
+    updateSkyColumnCache();                     // Rebuild the cached sky columns if the sky or view size changed
+
+    // Save the player state needed to draw the weapons and post fx, in case the game is simulated before these are drawn
+    captureWeaponDrawState();
+    capturePostFxState();
 }
 
 void init() noexcept {
     initData();     // Init resource managers and all of the lookup tables
 
-    // Fragment reserve
-    gWallFragments.reserve(1024 * 8);
-    gFloorFragments.reserve(1024 * 8);
-    gCeilFragments.reserve(1024 * 8);
-    gSkyFragments.reserve(1024);
-    gDrawSprites.reserve(128);
+    // Memory for the lists of things to draw each frame: this will grow if needed
+    gFrameArena.init(2 * 1024 * 1024);
+
+    // Spawn the threads used to rasterize the 3D view
+    initDrawBands();
 }
 
 void shutdown() noexcept {
-    // Nothing to do here yet...
+    if (gbIsDrawingPlayerViewAsync) {
+        endDrawPlayerView();
+    }
+
+    shutdownDrawBands();
+
+    releaseArenaVector(gOccluderBlocks, gFrameArena);
+    releaseArenaVector(gWallFragments, gFrameArena);
+    releaseArenaVector(gFloorFragments, gFrameArena);
+    releaseArenaVector(gCeilFragments, gFrameArena);
+    releaseArenaVector(gSkyFragments, gFrameArena);
+    releaseArenaVector(gDrawSprites, gFrameArena);
+    gFrameArena.destroy();
 }
 
 void initMathTables() noexcept {
@@ -281,19 +623,15 @@ void initMathTables() noexcept {
         gProjMatrix.r2c3 = -(Z_NEAR * Z_FAR) / (Z_FAR - Z_NEAR);
     }
 
-    // Compute the screen pixel to view angle table
-    gScreenXToAngleBAM.resize(g3dViewWidth);
+    // Compute the screen pixel to view angle table.
+    // The view size is now full size, and any tables cached for dynamic resolution are for the old view size so discard them.
+    buildScreenXToAngleTable(gScreenXToAngleBAM, g3dViewWidth);
+    gFullViewWidth = g3dViewWidth;
+    gFullViewHeight = g3dViewHeight;
+    gViewScaleStep = DYNAMIC_RES_NUM_STEPS;
 
-    {
-        float screenXToT = 1.0f / ((float) g3dViewWidth - 1.0f);
-
-        for (uint32_t x = 0; x < g3dViewWidth; ++x) {
-            const float t = ((float) x + 0.5f) * screenXToT;
-            const float nearPlaneX = t * gNearPlaneW - gNearPlaneHalfW;
-            const float angleRad = std::atan2(Z_NEAR, nearPlaneX);
-            const angle_t angleBAM = radiansToBamAngle(angleRad);
-            gScreenXToAngleBAM[x] = angleBAM;
-        }
+    for (std::vector<angle_t>& screenXToAngleBAM : gScreenXToAngleBAMCache) {
+        screenXToAngleBAM.clear();
     }
 
     // Create the lighting tables
@@ -309,22 +647,148 @@ void initMathTables() noexcept {
         gLightMins[i] = (float) i * LIGHT_MIN_PERCENT;
         gLightSubs[i] = maxBrightRange;
         gLightCoefs[i] = LIGHT_COEF_BASE - lightLevel * LIGHT_COEF_ADJUST_FACTOR;
+
+        // Figure out the distance at which light diminishing reaches the minimum light value and stops changing.
+        // The light multiplier table for this light level covers the distance range up to that point:
+        const float maxDiminish = MAX_LIGHT_VALUE - gLightMins[i];
+        const float maxDiminishDistFactor = maxDiminish / gLightCoefs[i];
+        const float maxDiminishDist = gLightSubs[i] + maxDiminishDistFactor * maxDiminishDistFactor;
+        gLightDistToTableIdx[i] = (float) LIGHT_TABLE_SIZE / maxDiminishDist;
+
+        // Precompute the light multipliers
+        LightParams lightParams = getLightParams(i);
+        float* const pLightMulTable = gLightMulTables[i];
+
+        for (uint32_t j = 0; j <= LIGHT_TABLE_SIZE; ++j) {
+            const float dist = (float) j * (maxDiminishDist / (float) LIGHT_TABLE_SIZE);
+            pLightMulTable[j] = lightParams.getLightMulForDistExact(dist);
+        }
+
+        pLightMulTable[LIGHT_TABLE_SIZE + 1] = pLightMulTable[LIGHT_TABLE_SIZE];
     }
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Same as 'drawPlayerView' but records how long each phase of drawing takes in 'gFrameTimings'
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void drawPlayerViewTimed() noexcept {
+    FrameTimings& timings = gFrameTimings;
+    timings = {};
+
+    const double startTime = getTimestampUSec();
+    preDrawSetup();
+
+    const double bspStartTime = getTimestampUSec();
+    doBspTraversal();
+
+    const double bandsStartTime = getTimestampUSec();
+    drawAllBands();
+    finishDrawingScene();
+
+    const double weaponsStartTime = getTimestampUSec();
+    drawWeapons();
+
+    const double postFxStartTime = getTimestampUSec();
+    doPostFx();
+
+    const double endTime = getTimestampUSec();
+    timings.bspTraversal = bandsStartTime - bspStartTime;
+    timings.bandsDraw = weaponsStartTime - bandsStartTime;
+    timings.weaponDraw = postFxStartTime - weaponsStartTime;
+    timings.postFx = endTime - postFxStartTime;
+    timings.total = endTime - startTime;
+}
+
 void drawPlayerView() noexcept {
+    PROFILE_ZONE("Player View");
+
+    if (gbCollectFrameTimings) {
+        drawPlayerViewTimed();
+        return;
+    }
+
     preDrawSetup();                 // Init variables based on camera angle
     doBspTraversal();               // Traverse the BSP tree and build lists of walls, floors (visplanes) and sprites to render
-    drawAllSkyFragments();
-    drawAllFloorFragments();
-    drawAllCeilingFragments();
-    drawAllWallFragments();
-    drawAllSprites();
+    drawAllBands();                 // Draw sky, floors, ceilings, walls and sprites: split across multiple threads in bands of screen columns
+    finishDrawingScene();           // Upscale the scene if drawn at a lower resolution
     drawWeapons();                  // Draw the weapons on top of the screen
     doPostFx();                     // Draw color overlay if needed
 }
 
-float LightParams::getLightMulForDist(const float dist) const noexcept {
+void beginDrawPlayerView() noexcept {
+    PROFILE_ZONE("Begin Player View");
+    ASSERT(!gbIsDrawingPlayerViewAsync);
+
+    if (!gbCollectFrameTimings) {
+        preDrawSetup();
+        doBspTraversal();
+        beginDrawingAllBands();
+        gbIsDrawingPlayerViewAsync = true;
+        return;
+    }
+
+    // Same as above, but also record timings.
+    // Note: the timings for the last complete frame are kept in 'gFrameTimings' until this frame ends.
+    const FrameTimings lastFrameTimings = gFrameTimings;
+    gFrameTimings = {};
+    gAsyncDrawStartTime = getTimestampUSec();
+
+    preDrawSetup();
+    doBspTraversal();
+
+    gAsyncBandsDrawStartTime = getTimestampUSec();
+    gFrameTimings.bspTraversal = gAsyncBandsDrawStartTime - gAsyncDrawStartTime;
+    gAsyncFrameTimings = gFrameTimings;
+    gFrameTimings = lastFrameTimings;
+
+    beginDrawingAllBands();
+    gbIsDrawingPlayerViewAsync = true;
+}
+
+void endDrawPlayerView() noexcept {
+    PROFILE_ZONE("End Player View");
+    ASSERT(gbIsDrawingPlayerViewAsync);
+
+    if (!gbCollectFrameTimings) {
+        endDrawingAllBands();
+        gbIsDrawingPlayerViewAsync = false;
+        finishDrawingScene();
+        drawWeapons();
+        doPostFx();
+        return;
+    }
+
+    // Same as above, but also record timings
+    FrameTimings& timings = gFrameTimings;
+    timings = gAsyncFrameTimings;
+
+    endDrawingAllBands();
+    gbIsDrawingPlayerViewAsync = false;
+    finishDrawingScene();
+
+    const double weaponsStartTime = getTimestampUSec();
+    drawWeapons();
+
+    const double postFxStartTime = getTimestampUSec();
+    doPostFx();
+
+    const double endTime = getTimestampUSec();
+    timings.bandsDraw = weaponsStartTime - gAsyncBandsDrawStartTime;
+    timings.weaponDraw = postFxStartTime - weaponsStartTime;
+    timings.postFx = endTime - postFxStartTime;
+    timings.total = endTime - gAsyncDrawStartTime;
+}
+
+bool isDrawingPlayerView() noexcept {
+    return gbIsDrawingPlayerViewAsync;
+}
+
+double getTimestampUSec() noexcept {
+    const auto timeSinceEpoch = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double, std::micro>(timeSinceEpoch).count();
+}
+
+float LightParams::getLightMulForDistExact(const float dist) const noexcept {
     const float distFactorLinear = std::max(dist - lightSub, 0.0f);
     const float distFactorQuad = std::sqrt(distFactorLinear);
     const float lightDiminish = distFactorQuad * lightCoef;
@@ -345,6 +809,8 @@ LightParams getLightParams(const uint32_t sectorLightLevel) noexcept {
     out.lightMax = (float) lightMax;
     out.lightSub = gLightSubs[lightMax];
     out.lightCoef = gLightCoefs[lightMax];
+    out.distToTableIdx = gLightDistToTableIdx[lightMax];
+    out.pLightMulTable = gLightMulTables[lightMax];
 
     return out;
 }
@@ -12,10 +12,51 @@ extern float gDebugCameraZOffset;
 static constexpr uint32_t REFERENCE_3D_VIEW_WIDTH = 280;
 static constexpr uint32_t REFERENCE_3D_VIEW_HEIGHT = 160;
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Timings (in microseconds) for the various phases of drawing the 3D view, for the last frame drawn.
+// These are only collected if 'gbCollectFrameTimings' is set, which is intended for benchmarking purposes.
+//
+// Note: the individual draw pass timings are summed across all draw threads, so they represent CPU time used rather than
+// elapsed time. The 'bandsDraw' timing is the elapsed time to draw all of the passes, across all threads.
+// If the view is drawn asynchronously then 'bandsDraw' and 'total' also include whatever the caller did in the meantime.
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct FrameTimings {
+    double  bspTraversal;   // BSP traversal, including wall prep
+    double  wallPrep;       // Transforming, clipping and emitting segs: a subset of BSP traversal time
+    double  skyDraw;
+    double  floorDraw;
+    double  ceilingDraw;
+    double  wallDraw;
+    double  spriteDraw;
+    double  bandsDraw;      // Elapsed time for drawing sky, floors, ceilings, walls and sprites for all bands
+    double  weaponDraw;
+    double  postFx;
+    double  total;          // Elapsed time for drawing the entire 3D view
+};
+
+extern bool             gbCollectFrameTimings;
+extern FrameTimings     gFrameTimings;
+
+double getTimestampUSec() noexcept;     // Get a timestamp in microseconds: used to collect frame timings
+
 void init() noexcept;               // Initialize the renderer (done once)
 void shutdown() noexcept;
 
 void initMathTables() noexcept;     // Re-initialize the renderer math tables; must be done if screen size changes!
 void drawPlayerView() noexcept;     // Render the 3d view for the player
+void clearBspVisCache() noexcept;   // Forget all BSP node visibility remembered for the current map; must be done when the map is unloaded!
+uint32_t getNumDrawThreads() noexcept;  // How many threads the 3D view is drawn with, after resolving the 'auto' thread count setting
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Asynchronous drawing of the 3D view for the player.
+//
+// 'beginDrawPlayerView' does all the work which reads the game state (BSP traversal, wall prep etc.) on the calling thread and then
+// starts rasterizing the view on the draw worker threads. Until 'endDrawPlayerView' is called the game can be simulated but nothing
+// else may draw to the framebuffer or to the 3D view. 'endDrawPlayerView' waits for rasterization to finish and then draws the
+// weapons and post fx, using the player state from when drawing began.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void beginDrawPlayerView() noexcept;
+void endDrawPlayerView() noexcept;
+bool isDrawingPlayerView() noexcept;    // True if drawing the view asynchronously and 'endDrawPlayerView' has not been called yet
 
 END_NAMESPACE(Renderer)
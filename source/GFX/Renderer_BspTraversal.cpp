@@ -1,16 +1,23 @@
 #include "Renderer_Internal.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
+#include "Game/Config.h"
 #include "Game/Data.h"
 #include "Map/MapData.h"
+#include "Map/MapPvs.h"
 #include "Map/MapUtil.h"
+#include "Sprites.h"
 #include "Things/MapObj.h"
+#include <limits>
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Module that handles traversing the BSP tree, so we can produce lists of things to draw.
 //------------------------------------------------------------------------------------------------------------------------------------------
 BEGIN_NAMESPACE(Renderer)
 
+static uint32_t gViewSectorIdx;     // Index of the sector the view is in, for checking the map PVS
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Given a sector pointer, and if I hadn't already rendered the sprites, make valid sprites for the sprite list.
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -35,12 +42,12 @@ static void addSubsectorToFrame(subsector_t& sub) noexcept {
     addSectorSpritesToFrame(sector);    // Prepare sprites for rendering
 
     // Pass all line segments in the subsector to the renderer
-    seg_t* pLineSeg = sub.firstline;
-    seg_t* const pEndLineSeg = pLineSeg + sub.numsublines;
+    const double wallPrepStartTime = (gbCollectFrameTimings) ? getTimestampUSec() : 0.0;
+
+    addSegsToFrame(sub.firstline, sub.numsublines);
 
-    while (pLineSeg < pEndLineSeg) {
-        addSegToFrame(*pLineSeg);
-        ++pLineSeg;
+    if (gbCollectFrameTimings) {
+        gFrameTimings.wallPrep += getTimestampUSec() - wallPrepStartTime;
     }
 }
 
@@ -74,6 +81,70 @@ static inline void transformXYPointToClipSpace(vertexf_t& point) noexcept {
     point.x *= gProjMatrix.r0c0;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if a bounding box, given by its 4 corner points in clip space, is entirely hidden behind screen columns which accept no more
+// wall or floor pixels. Since the BSP tree is traversed from front to back, nothing in the box could be seen in those columns.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool isClipSpaceBBoxHidden(
+    const vertexf_t& p1,
+    const vertexf_t& p2,
+    const vertexf_t& p3,
+    const vertexf_t& p4
+) noexcept {
+    // Quick early out if no screen columns are full yet
+    if (gNumFullSegCols <= 0)
+        return false;
+
+    // Can't easily tell how much of the screen the box covers if any of it is behind the near plane.
+    // Note: 'y' is the 'w' coordinate value in clip space.
+    if ((p1.y < Z_NEAR) || (p2.y < Z_NEAR) || (p3.y < Z_NEAR) || (p4.y < Z_NEAR))
+        return false;
+
+    // Get the range of screen columns covered by the box, expanding by 1 column on either side to allow for rounding differences
+    // with how seg columns are emitted.
+    const float ndcLx = std::max(std::min(std::min(p1.x / p1.y, p2.x / p2.y), std::min(p3.x / p3.y, p4.x / p4.y)), -1.0f);
+    const float ndcRx = std::min(std::max(std::max(p1.x / p1.y, p2.x / p2.y), std::max(p3.x / p3.y, p4.x / p4.y)), 1.0f);
+    const float viewW = (float) g3dViewWidth;
+    const int32_t lx = std::max((int32_t)((ndcLx * 0.5f + 0.5f) * viewW) - 1, 0);
+    const int32_t rx = std::min((int32_t)((ndcRx * 0.5f + 0.5f) * viewW) + 1, (int32_t) g3dViewWidth - 1);
+
+    if (lx > rx)
+        return false;
+
+    return isScreenRangeFullOfSegs((uint32_t) lx, (uint32_t) rx);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if a BSP node bounding box is entirely hidden behind screen columns which accept no more wall or floor pixels.
+// The bounding box only covers the positions of things in the node, and thing sprites can overhang their position into columns which
+// are still visible. Because of this the box is expanded on all sides by the furthest any sprite can overhang before it is tested.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool isBBoxHidden(const Fixed bspcoord[BOXCOUNT]) noexcept {
+    if (gNumFullSegCols <= 0)
+        return false;
+
+    const float spritePad = (float) Sprites::getMaxHorizontalExtent();
+    const float boxLx = fixed16ToFloat(bspcoord[BOXLEFT]) - spritePad;
+    const float boxRx = fixed16ToFloat(bspcoord[BOXRIGHT]) + spritePad;
+    const float boxTy = fixed16ToFloat(bspcoord[BOXTOP]) + spritePad;
+    const float boxBy = fixed16ToFloat(bspcoord[BOXBOTTOM]) - spritePad;
+
+    vertexf_t p1 = { boxLx, boxTy };
+    vertexf_t p2 = { boxRx, boxTy };
+    vertexf_t p3 = { boxRx, boxBy };
+    vertexf_t p4 = { boxLx, boxBy };
+    transformXYPointToViewSpace(p1);
+    transformXYPointToViewSpace(p2);
+    transformXYPointToViewSpace(p3);
+    transformXYPointToViewSpace(p4);
+    transformXYPointToClipSpace(p1);
+    transformXYPointToClipSpace(p2);
+    transformXYPointToClipSpace(p3);
+    transformXYPointToClipSpace(p4);
+
+    return isClipSpaceBBoxHidden(p1, p2, p3, p4);
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Some basic rejection checks to see if we should process a BSP node.
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -133,10 +204,217 @@ static bool checkBBox(const Fixed bspcoord[BOXCOUNT]) noexcept {
     if (bAllPtsToRight)
         return false;
 
+    // Reject the box if it is hidden behind walls and floors which have already filled the screen columns it covers
+    if (Config::gbOcclusionCulling && isBBoxHidden(bspcoord))
+        return false;
+
     // If we get to here then the BSP node is in bounds, process it!
     return true;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// BSP node visibility cache.
+//
+// While the view stays inside the same subsector and within the same coarse range of view angles, the bounding boxes for some BSP nodes
+// will always be off screen and some will always pass 'checkBBox'. The cache remembers this for the most recently used combinations of
+// subsector and view angle range, so that these bounding boxes don't need to be transformed and tested every frame.
+//
+// Notes:
+//  (1) Only frustum culling results are cached, and only when they are certain for every view position and angle covered by the cache
+//      entry. The BSP is traversed in exactly the same way with or without the cache, so nothing drawn changes. Since occlusion is
+//      never cached, changes to sector heights (doors, lifts etc.) don't invalidate anything.
+//  (2) The visibility of each node bounding box is only worked out once the traversal reaches it, so starting a new entry is cheap.
+//  (3) The view positions covered by an entry are the bounding box of the subsector's segs. Subsectors are not always fully enclosed
+//      by their segs however, so the cache is not used if the view is outside of that.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t   BSP_VIS_CACHE_SIZE          = 16;       // Number of subsector and view angle range combinations remembered
+static constexpr uint32_t   BSP_VIS_ANGLE_RANGE_SHIFT   = 26;       // 64 view angle ranges of 5.625 degrees each
+static constexpr float      BSP_VIS_TEST_MARGIN         = 1.0f;     // Safety margin for the visibility tests, to allow for float error
+
+// Visibility of a BSP node bounding box for all view positions and angles covered by a cache entry
+enum class BBoxVis : uint8_t {
+    UNKNOWN,        // Not tested yet
+    CULLED,         // Always off screen
+    VISIBLE,        // Always passes 'checkBBox'
+    VARIES          // Must be tested every frame
+};
+
+struct BspVisCacheEntry {
+    const subsector_t*      pSubsector;         // Which subsector the view is in, or null if the entry is unused
+    uint32_t                angleRange;         // Which range of view angles the entry is for
+    uint32_t                lastUsedFrame;      // Frame the entry was last used in, for deciding which entry to replace
+    float                   viewMinX;           // Range of view positions covered by the entry
+    float                   viewMaxX;
+    float                   viewMinY;
+    float                   viewMaxY;
+    std::vector<BBoxVis>    nodeBBoxVis;        // Visibility for the bounding box of each child of each node (2 per node)
+};
+
+static BspVisCacheEntry     gBspVisCache[BSP_VIS_CACHE_SIZE];
+static uint32_t             gBspVisCacheFrameNum;
+static float                gBspVisCacheProjR0C0;   // The projection matrix scaling that the cache was built with
+static BspVisCacheEntry*    gpCurBspVisCacheEntry;  // The cache entry used for the current frame, or null if not using the cache
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Figure out the visibility of a BSP node bounding box for all view positions and angles covered by the given cache entry.
+//
+// For a particular view angle the tests done by 'checkBBox' against each plane are all half planes, so if a box point passes or fails
+// a test for all 4 corners of the view position range then it does so for every view position in between. Similarly for a particular
+// view position, a box point passes or fails each test over an arc of view angles that is at least 180 degrees wide (or is the opposite
+// of such an arc), so checking both ends of the small view angle range is enough.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static BBoxVis getBBoxVisForCacheEntry(const Fixed bspcoord[BOXCOUNT], const BspVisCacheEntry& entry) noexcept {
+    const float boxLx = fixed16ToFloat(bspcoord[BOXLEFT]);
+    const float boxRx = fixed16ToFloat(bspcoord[BOXRIGHT]);
+    const float boxTy = fixed16ToFloat(bspcoord[BOXTOP]);
+    const float boxBy = fixed16ToFloat(bspcoord[BOXBOTTOM]);
+
+    const vertexf_t boxPts[4] = { { boxLx, boxTy }, { boxRx, boxTy }, { boxRx, boxBy }, { boxLx, boxBy } };
+    const vertexf_t boxCenter = { (boxLx + boxRx) * 0.5f, (boxTy + boxBy) * 0.5f };
+    const vertexf_t viewPts[4] = {
+        { entry.viewMinX, entry.viewMinY },
+        { entry.viewMaxX, entry.viewMinY },
+        { entry.viewMaxX, entry.viewMaxY },
+        { entry.viewMinX, entry.viewMaxY }
+    };
+
+    const float viewAngles[2] = {
+        bamAngleToRadians(entry.angleRange << BSP_VIS_ANGLE_RANGE_SHIFT),
+        bamAngleToRadians((entry.angleRange + 1) << BSP_VIS_ANGLE_RANGE_SHIFT)
+    };
+
+    const float r0c0 = gProjMatrix.r0c0;
+    const float margin = BSP_VIS_TEST_MARGIN;
+
+    // Note: 'depth' and 'side' here are the view space 'y' and clip space 'x' values that 'checkBBox' computes.
+    // The box is culled if all points are behind, left or right for every view, and always visible if the center is always on screen.
+    // For 'behind' a depth of '0' is used rather than 'Z_NEAR', to keep the arc of view angles where a point is behind at 180 degrees.
+    bool bAlwaysAllBehind = true;
+    bool bAlwaysAllToLeft = true;
+    bool bAlwaysAllToRight = true;
+    bool bCenterAlwaysOnScreen = true;
+
+    for (const float viewAngle : viewAngles) {
+        const float dirX = std::cos(viewAngle);
+        const float dirY = std::sin(viewAngle);
+
+        for (const vertexf_t& viewPt : viewPts) {
+            for (const vertexf_t& boxPt : boxPts) {
+                const float dx = boxPt.x - viewPt.x;
+                const float dy = boxPt.y - viewPt.y;
+                const float depth = dx * dirX + dy * dirY;
+                const float side = (dx * dirY - dy * dirX) * r0c0;
+
+                bAlwaysAllBehind &= (depth < -margin);
+                bAlwaysAllToLeft &= (side + depth < -margin);
+                bAlwaysAllToRight &= (depth - side < -margin);
+            }
+
+            const float dx = boxCenter.x - viewPt.x;
+            const float dy = boxCenter.y - viewPt.y;
+            const float depth = dx * dirX + dy * dirY;
+            const float side = (dx * dirY - dy * dirX) * r0c0;
+
+            bCenterAlwaysOnScreen &= (
+                (depth >= Z_NEAR + margin) &&
+                (side + depth >= margin) &&
+                (depth - side >= margin)
+            );
+        }
+    }
+
+    if (bAlwaysAllBehind || bAlwaysAllToLeft || bAlwaysAllToRight)
+        return BBoxVis::CULLED;
+
+    return (bCenterAlwaysOnScreen) ? BBoxVis::VISIBLE : BBoxVis::VARIES;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Get the visibility cache entry to use for the current view, creating it if required.
+// Returns null if the cache can't be used for the current view.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static BspVisCacheEntry* getBspVisCacheEntryForView() noexcept {
+    // If the projection has changed (screen size change) then nothing remembered is valid anymore
+    if (gBspVisCacheProjR0C0 != gProjMatrix.r0c0) {
+        clearBspVisCache();
+        gBspVisCacheProjR0C0 = gProjMatrix.r0c0;
+    }
+
+    const subsector_t* const pSubsector = gPlayer.mo->subsector;
+    const uint32_t angleRange = gViewAngleBAM >> BSP_VIS_ANGLE_RANGE_SHIFT;
+    ++gBspVisCacheFrameNum;
+
+    // Try to find an existing entry for the view, otherwise replace the least recently used one
+    BspVisCacheEntry* pEntry = nullptr;
+    BspVisCacheEntry* pOldestEntry = &gBspVisCache[0];
+
+    for (BspVisCacheEntry& entry : gBspVisCache) {
+        if ((entry.pSubsector == pSubsector) && (entry.angleRange == angleRange)) {
+            pEntry = &entry;
+            break;
+        }
+
+        if (entry.lastUsedFrame < pOldestEntry->lastUsedFrame) {
+            pOldestEntry = &entry;
+        }
+    }
+
+    if (!pEntry) {
+        pEntry = pOldestEntry;
+        pEntry->pSubsector = pSubsector;
+        pEntry->angleRange = angleRange;
+        pEntry->viewMinX = std::numeric_limits<float>::max();
+        pEntry->viewMaxX = -std::numeric_limits<float>::max();
+        pEntry->viewMinY = std::numeric_limits<float>::max();
+        pEntry->viewMaxY = -std::numeric_limits<float>::max();
+
+        const seg_t* const pBegSeg = pSubsector->firstline;
+        const seg_t* const pEndSeg = pBegSeg + pSubsector->numsublines;
+
+        for (const seg_t* pSeg = pBegSeg; pSeg < pEndSeg; ++pSeg) {
+            pEntry->viewMinX = std::min(pEntry->viewMinX, std::min(pSeg->v1.x, pSeg->v2.x));
+            pEntry->viewMaxX = std::max(pEntry->viewMaxX, std::max(pSeg->v1.x, pSeg->v2.x));
+            pEntry->viewMinY = std::min(pEntry->viewMinY, std::min(pSeg->v1.y, pSeg->v2.y));
+            pEntry->viewMaxY = std::max(pEntry->viewMaxY, std::max(pSeg->v1.y, pSeg->v2.y));
+        }
+
+        pEntry->nodeBBoxVis.assign((size_t) gNumBSPNodes * 2, BBoxVis::UNKNOWN);
+    }
+
+    pEntry->lastUsedFrame = gBspVisCacheFrameNum;
+
+    // Can only use the entry if the view is within the range of positions it covers
+    const bool bViewInRange = (
+        (gViewX >= pEntry->viewMinX) &&
+        (gViewX <= pEntry->viewMaxX) &&
+        (gViewY >= pEntry->viewMinY) &&
+        (gViewY <= pEntry->viewMaxY)
+    );
+
+    return (bViewInRange) ? pEntry : nullptr;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Same as 'checkBBox' for the given child of a BSP node, but uses the visibility cache if possible
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool checkNodeChildBBox(const node_t& node, const uint32_t childIdx) noexcept {
+    if (!gpCurBspVisCacheEntry)
+        return checkBBox(node.bbox[childIdx]);
+
+    const uint32_t nodeIdx = getBspNodeIdx(node);
+    BBoxVis& bboxVis = gpCurBspVisCacheEntry->nodeBBoxVis[nodeIdx * 2 + childIdx];
+
+    if (bboxVis == BBoxVis::UNKNOWN) {
+        bboxVis = getBBoxVisForCacheEntry(node.bbox[childIdx], *gpCurBspVisCacheEntry);
+    }
+
+    switch (bboxVis) {
+        case BBoxVis::CULLED:   return false;
+        case BBoxVis::VISIBLE:  return ((!Config::gbOcclusionCulling) || (!isBBoxHidden(node.bbox[childIdx])));
+        default:                return checkBBox(node.bbox[childIdx]);
+    }
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Traverse the BSP tree starting from a tree node (Or sector) and recursively subdivide if needed.
 // Use a cross product from the line cast from the viewxy to the bspxy and the bsp line itself.
@@ -147,20 +425,29 @@ static void addBspNodeToFrame(node_t* const pNode) noexcept {
         // Process the sub sector.
         // N.B: Need to fix up the pointer as well due to the lowest bit set as a flag!
         subsector_t* const pSubSector = (subsector_t*) getActualBspNodePtr(pNode);
-        addSubsectorToFrame(*pSubSector);
+
+        // Skip the subsector if it can't possibly be seen from the sector the view is in
+        if (MapPvs::canSectorSeeSector(gViewSectorIdx, (uint32_t)(pSubSector->sector - gpSectors))) {
+            addSubsectorToFrame(*pSubSector);
+        }
+
         return;
     }
     
     // If we have filled the screen then exit now - don't traverse the BSP any further
     if (gNumFullSegCols >= g3dViewWidth)
         return;
+
+    // If nothing under this node can be seen from the sector the view is in then skip it entirely
+    if (!MapPvs::canSectorSeeBspNode(gViewSectorIdx, getBspNodeIdx(*pNode)))
+        return;
     
     // Decide which side the view point is on
     uint32_t side = PointOnVectorSide(gViewXFrac, gViewYFrac, pNode->Line);     // Is this the front side?
     addBspNodeToFrame((node_t*) pNode->Children[side]);                         // Process the side closer to me
     side ^= 1;                                                                  // Swap the side
 
-    if (checkBBox(pNode->bbox[side])) {                         // Is the viewing rect on both sides?
+    if (checkNodeChildBBox(*pNode, side)) {                     // Is the viewing rect on both sides?
         addBspNodeToFrame((node_t*) pNode->Children[side]);     // Render the back side
     }
 }
@@ -170,8 +457,24 @@ static void addBspNodeToFrame(node_t* const pNode) noexcept {
 // screen by placing fake posts on the farthest left and right sides in solidsegs 0 and 1.
 //------------------------------------------------------------------------------------------------------------------------------------------
 void doBspTraversal() noexcept {
+    PROFILE_ZONE("BSP Traversal");
+
     ++gValidCount;                          // For sprite recursion
+    gpCurBspVisCacheEntry = (Config::gbBspVisibilityCache) ? getBspVisCacheEntryForView() : nullptr;
+    gViewSectorIdx = (uint32_t)(gPlayer.mo->subsector->sector - gpSectors);
     addBspNodeToFrame(gpBSPTreeRoot);       // Begin traversing the BSP tree for all walls in render range
+    gpCurBspVisCacheEntry = nullptr;
+}
+
+void clearBspVisCache() noexcept {
+    for (BspVisCacheEntry& entry : gBspVisCache) {
+        entry.pSubsector = nullptr;
+        entry.lastUsedFrame = 0;
+        entry.nodeBBoxVis.clear();
+    }
+
+    gBspVisCacheFrameNum = 0;
+    gpCurBspVisCacheEntry = nullptr;
 }
 
 END_NAMESPACE(Renderer)
@@ -0,0 +1,299 @@
+#include "Renderer_Internal.h"
+
+#include "Base/Profiler.h"
+#include "Base/Tables.h"
+#include "Game/Config.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Multi-threaded rasterization of the 3D view.
+//
+// Every fragment emitted for the frame (walls, floors, ceilings, sky) is an independent screen column, and sprites are
+// drawn one column at a time also. This means the 3D view can be split up into vertical bands of screen columns which
+// are rasterized in parallel, with each band being drawn start to finish (sky, flats, walls, then sprites) on its own
+// thread. Since each band only writes to its own columns of the framebuffer no locking is needed during drawing, and
+// because each band draws in exactly the same order as the single threaded case the output is identical.
+//
+// Normally the calling thread draws the first band while worker threads draw the rest. When drawing asynchronously
+// (see 'beginDrawingAllBands') worker threads draw every band, leaving the calling thread free to do other work.
+// The worker for the first band is only created if pipelined rendering is enabled, since nothing else draws asynchronously.
+//------------------------------------------------------------------------------------------------------------------------------------------
+BEGIN_NAMESPACE(Renderer)
+
+// Maximum number of bands the 3D view can be split into (one per thread)
+static constexpr uint32_t MAX_DRAW_THREADS = 32;
+
+// Don't make bands narrower than this many screen columns, it's not worth the thread overhead
+static constexpr uint32_t MIN_DRAW_BAND_WIDTH = 16;
+
+static std::vector<DrawBand>        gDrawBands;             // The draw bands: one per thread
+static std::vector<std::thread>     gDrawWorkers;           // Worker threads: one per band
+static std::mutex                   gDrawMutex;             // Guards all of the worker sync state below
+static std::condition_variable      gDrawStartCondVar;      // Signalled when there is a new frame for workers to draw or they should quit
+static std::condition_variable      gDrawDoneCondVar;       // Signalled when a worker finishes drawing its band
+static uint32_t                     gDrawFrameNum;          // Incremented every time workers are asked to draw
+static uint32_t                     gNumActiveBands;        // How many bands are being drawn for the current frame
+static uint32_t                     gFirstWorkerBandIdx;    // The first band drawn by a worker: bands before this are drawn by the calling thread
+static uint32_t                     gNumWorkersBusy;        // How many workers are still drawing the current frame
+static bool                         gbDrawWorkersQuit;      // If set then the worker threads should exit
+static bool                         gbHaveFirstBandWorker;  // If set then there is a worker for the first band, so all bands can be drawn asynchronously
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draws everything in the 3D view for the given band of screen columns
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void drawBand(DrawBand& band) noexcept {
+    if (!gbCollectFrameTimings) {
+        drawAllSkyFragments(band);
+        drawAllFloorFragments(band);
+        drawAllCeilingFragments(band);
+        drawAllWallFragments(band);
+        drawAllSprites(band);
+        return;
+    }
+
+    // Same as above, but also record how long each draw pass takes
+    const double skyStartTime = getTimestampUSec();
+    drawAllSkyFragments(band);
+
+    const double floorStartTime = getTimestampUSec();
+    drawAllFloorFragments(band);
+
+    const double ceilingStartTime = getTimestampUSec();
+    drawAllCeilingFragments(band);
+
+    const double wallStartTime = getTimestampUSec();
+    drawAllWallFragments(band);
+
+    const double spriteStartTime = getTimestampUSec();
+    drawAllSprites(band);
+
+    const double endTime = getTimestampUSec();
+    band.skyDrawTime = floorStartTime - skyStartTime;
+    band.floorDrawTime = ceilingStartTime - floorStartTime;
+    band.ceilingDrawTime = wallStartTime - ceilingStartTime;
+    band.wallDrawTime = spriteStartTime - wallStartTime;
+    band.spriteDrawTime = endTime - spriteStartTime;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Adds up the draw pass timings for all bands used this frame and saves them to the frame timings
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void sumDrawBandTimings(const uint32_t numBands) noexcept {
+    FrameTimings& timings = gFrameTimings;
+
+    for (uint32_t bandIdx = 0; bandIdx < numBands; ++bandIdx) {
+        const DrawBand& band = gDrawBands[bandIdx];
+        timings.skyDraw += band.skyDrawTime;
+        timings.floorDraw += band.floorDrawTime;
+        timings.ceilingDraw += band.ceilingDrawTime;
+        timings.wallDraw += band.wallDrawTime;
+        timings.spriteDraw += band.spriteDrawTime;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Main loop for a draw worker thread: waits for frames to draw and draws the given band for each
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void drawWorkerMain(const uint32_t bandIdx) noexcept {
+    uint32_t lastFrameNum = 0;
+
+    while (true) {
+        // Wait until there is a new frame to draw or until told to quit
+        {
+            std::unique_lock<std::mutex> lock(gDrawMutex);
+            gDrawStartCondVar.wait(lock, [&]() noexcept { return (gbDrawWorkersQuit || (gDrawFrameNum != lastFrameNum)); });
+
+            if (gbDrawWorkersQuit)
+                return;
+
+            lastFrameNum = gDrawFrameNum;
+
+            // Nothing to do if this band is not in use for this frame (view is too narrow to give every thread a band),
+            // or if the calling thread is drawing it.
+            if ((bandIdx >= gNumActiveBands) || (bandIdx < gFirstWorkerBandIdx))
+                continue;
+        }
+
+        drawBand(gDrawBands[bandIdx]);
+
+        // Tell the main thread we are done with this band
+        {
+            std::lock_guard<std::mutex> lock(gDrawMutex);
+            --gNumWorkersBusy;
+        }
+
+        gDrawDoneCondVar.notify_one();
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Determines how many threads to use for drawing the 3D view
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t determineNumDrawThreads() noexcept {
+    uint32_t numThreads = Config::gRenderThreadCount;
+
+    // Auto thread count: use however many hardware threads the system has
+    if (numThreads == 0) {
+        numThreads = std::thread::hardware_concurrency();
+    }
+
+    return std::min(std::max(numThreads, 1u), MAX_DRAW_THREADS);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Partitions the 3D view into equally sized bands of screen columns, for the given number of bands
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void setupDrawBandBounds(const uint32_t numBands) noexcept {
+    ASSERT(numBands > 0);
+    ASSERT(numBands <= gDrawBands.size());
+
+    const uint32_t viewW = g3dViewWidth;
+
+    for (uint32_t bandIdx = 0; bandIdx < numBands; ++bandIdx) {
+        DrawBand& band = gDrawBands[bandIdx];
+        band.beginX = (viewW * bandIdx) / numBands;
+        band.endX = (viewW * (bandIdx + 1)) / numBands;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Sorts sprites and splits the 3D view into bands for drawing the current frame. Returns the number of bands to draw.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t setupDrawBandsForFrame() noexcept {
+    ASSERT(!gDrawBands.empty());
+
+    // Sprites must be sorted up front since every band draws them in the same order
+    sortAllSprites();
+
+    // Figure out how many bands to use: if the view is very narrow then some threads might sit this frame out
+    const uint32_t maxBands = std::max(g3dViewWidth / MIN_DRAW_BAND_WIDTH, 1u);
+    const uint32_t numBands = std::min((uint32_t) gDrawBands.size(), maxBands);
+    setupDrawBandBounds(numBands);
+    return numBands;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Kicks off the worker threads to draw the given number of bands, starting at the given band
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void startDrawWorkers(const uint32_t numBands, const uint32_t firstWorkerBandIdx) noexcept {
+    ASSERT(firstWorkerBandIdx <= numBands);
+
+    {
+        std::lock_guard<std::mutex> lock(gDrawMutex);
+        gNumActiveBands = numBands;
+        gFirstWorkerBandIdx = firstWorkerBandIdx;
+        gNumWorkersBusy = numBands - firstWorkerBandIdx;
+        ++gDrawFrameNum;
+    }
+
+    gDrawStartCondVar.notify_all();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Waits until all worker threads have finished drawing their bands for the current frame
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void waitForDrawWorkers() noexcept {
+    std::unique_lock<std::mutex> lock(gDrawMutex);
+    gDrawDoneCondVar.wait(lock, []() noexcept { return (gNumWorkersBusy == 0); });
+}
+
+uint32_t getNumDrawThreads() noexcept {
+    return (uint32_t) gDrawBands.size();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Creates the draw bands and spawns a worker thread for each band
+//------------------------------------------------------------------------------------------------------------------------------------------
+void initDrawBands() noexcept {
+    ASSERT(gDrawBands.empty());
+    ASSERT(gDrawWorkers.empty());
+
+    const uint32_t numThreads = determineNumDrawThreads();
+    gDrawBands.resize(numThreads);
+
+    gDrawFrameNum = 0;
+    gNumActiveBands = 0;
+    gFirstWorkerBandIdx = 0;
+    gNumWorkersBusy = 0;
+    gbDrawWorkersQuit = false;
+
+    // The worker for the first band is only needed when drawing asynchronously, which is only done for pipelined rendering.
+    // Otherwise the calling thread always draws the first band, so don't spawn a thread which would just sit idle.
+    gbHaveFirstBandWorker = Config::gbPipelinedRendering;
+    const uint32_t firstWorkerBandIdx = (gbHaveFirstBandWorker) ? 0 : 1;
+    gDrawWorkers.reserve(numThreads);
+
+    for (uint32_t bandIdx = firstWorkerBandIdx; bandIdx < numThreads; ++bandIdx) {
+        gDrawWorkers.emplace_back(drawWorkerMain, bandIdx);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells all worker threads to exit, waits for them to finish and frees the draw bands
+//------------------------------------------------------------------------------------------------------------------------------------------
+void shutdownDrawBands() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(gDrawMutex);
+        gbDrawWorkersQuit = true;
+    }
+
+    gDrawStartCondVar.notify_all();
+
+    for (std::thread& worker : gDrawWorkers) {
+        worker.join();
+    }
+
+    gDrawWorkers.clear();
+    gDrawBands.clear();
+    gbDrawWorkersQuit = false;
+    gbHaveFirstBandWorker = false;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draws all fragments and sprites in the 3D view, splitting the work across all of the draw threads.
+// Returns once the entire 3D view has been drawn.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void drawAllBands() noexcept {
+    PROFILE_ZONE("Draw Bands");
+
+    const uint32_t numBands = setupDrawBandsForFrame();
+
+    // If there is only the one band then just draw it on this thread and skip all the thread sync.
+    // Otherwise draw the first band on this thread and wait for the workers to draw the others.
+    if (numBands == 1) {
+        drawBand(gDrawBands[0]);
+    } else {
+        startDrawWorkers(numBands, 1);
+        drawBand(gDrawBands[0]);
+        waitForDrawWorkers();
+    }
+
+    if (gbCollectFrameTimings) {
+        sumDrawBandTimings(numBands);
+    }
+}
+
+void beginDrawingAllBands() noexcept {
+    const uint32_t numBands = setupDrawBandsForFrame();
+
+    // If there is no worker for the first band then it has to be drawn on this thread, so only the other bands are asynchronous
+    if (gbHaveFirstBandWorker) {
+        startDrawWorkers(numBands, 0);
+    } else {
+        startDrawWorkers(numBands, 1);
+        drawBand(gDrawBands[0]);
+    }
+}
+
+void endDrawingAllBands() noexcept {
+    PROFILE_ZONE("Wait For Bands");
+    waitForDrawWorkers();
+
+    if (gbCollectFrameTimings) {
+        sumDrawBandTimings(gNumActiveBands);
+    }
+}
+
+END_NAMESPACE(Renderer)
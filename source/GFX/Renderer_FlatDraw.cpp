@@ -1,7 +1,9 @@
 #include "Renderer_Internal.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
 #include "Blit.h"
+#include "Game/Config.h"
 #include "Textures.h"
 #include "Video.h"
 
@@ -61,6 +63,88 @@ static inline void doRayFlatPlaneIntersection(
     intersectZ = rayOriginZ + rayDirZ * intersectT;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Computes the point on the flat plane that is seen through the given screen y position of a flat column.
+// The ray direction in the xz plane for the column must be given.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <DrawFlatMode MODE>
+static inline void getFlatPointForColumnY(
+    const float flatPlaneZ,
+    const float rayDirX,
+    const float rayDirY,
+    const int32_t dstY,
+    float& intersectX,
+    float& intersectY,
+    float& intersectZ
+) noexcept {
+    // Note: take the vertical center position of the pixel to improve accuracy, hence + 0.5 here!
+    const float nearPlaneZ = gNearPlaneTz + gNearPlaneZStepPerViewColPixel * ((float) dstY + 0.5f);
+    const float rayDirZ = nearPlaneZ - gViewZ;
+
+    doRayFlatPlaneIntersection<MODE>(
+        flatPlaneZ,
+        gViewX,
+        gViewY,
+        gViewZ,
+        rayDirX,
+        rayDirY,
+        rayDirZ,
+        intersectX,
+        intersectY,
+        intersectZ
+    );
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Writes a single lit pixel of a flat to the given destination pixel, using the given world space texture coordinate.
+// The flat pixels can either be in ARGB1555 format, or the pre-expanded ARGB8888 format.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SrcPixelT>
+static inline void drawFlatPixel(
+    uint32_t* const pDstPixel,
+    const SrcPixelT* const pSrcPixels,
+    const float texX,
+    const float texY,
+    const float lightMul
+) noexcept {
+    // Get the source pixel (ARGB1555 or ARGB8888 format).
+    // Note that the flat texture is always expected to be 64x64, hence we can wraparound with a simple bitwise AND:
+    const uint32_t curSrcXInt = (uint32_t) texX & 63;
+    const uint32_t curSrcYInt = (uint32_t) texY & 63;
+    const SrcPixelT srcPixel = pSrcPixels[curSrcYInt * 64 + curSrcXInt];
+
+    // Extract RGB components.
+    // In the case of ARGB1555 also shift such that the maximum value is 255 instead of 31.
+    uint16_t texR;
+    uint16_t texG;
+    uint16_t texB;
+
+    if constexpr (std::is_same_v<SrcPixelT, uint16_t>) {
+        texR = (uint16_t)((srcPixel & uint16_t(0b0111110000000000)) >> 7);
+        texG = (uint16_t)((srcPixel & uint16_t(0b0000001111100000)) >> 2);
+        texB = (uint16_t)((srcPixel & uint16_t(0b0000000000011111)) << 3);
+    } else {
+        static_assert(std::is_same_v<SrcPixelT, uint32_t>);
+        texR = (uint16_t)((srcPixel & 0x00FF0000u) >> 16);
+        texG = (uint16_t)((srcPixel & 0x0000FF00u) >> 8);
+        texB = (uint16_t)(srcPixel & 0x000000FFu);
+    }
+
+    // Get the texture colors in 0-255 float format.
+    // Note that if we are not doing any color multiply these conversions would be redundant, but I'm guessing
+    // that the compiler would be smart enough to optimize out the useless operations in those cases (hopefully)!
+    const float r = std::min((float) texR * lightMul, 255.0f);
+    const float g = std::min((float) texG * lightMul, 255.0f);
+    const float b = std::min((float) texB * lightMul, 255.0f);
+
+    // Write out the pixel value
+    *pDstPixel = (
+        (uint32_t(r) << 16) |
+        (uint32_t(g) << 8) |
+        (uint32_t(b))
+    );
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Draw one vertical column of a flat.
 //
@@ -69,8 +153,8 @@ static inline void doRayFlatPlaneIntersection(
 // performance of the CPU instead of trawling through memory (slow) trying to match up visplanes and convert vertical
 // columns into horizontal ones.
 //------------------------------------------------------------------------------------------------------------------------------------------
-template <DrawFlatMode MODE>
-static inline void drawFlatColumn(const FlatFragment flatFrag) noexcept {
+template <DrawFlatMode MODE, class SrcPixelT>
+static inline void drawFlatColumn(const FlatFragment flatFrag, const SrcPixelT* const pSrcPixels) noexcept {
     // Cache some useful values
     const float viewX = gViewX;
     const float viewY = gViewY;
@@ -80,7 +164,6 @@ static inline void drawFlatColumn(const FlatFragment flatFrag) noexcept {
     const float nearPlaneZStep = gNearPlaneZStepPerViewColPixel;
 
     const LightParams& lightParams = getLightParams(flatFrag.sectorLightLevel);
-    const uint16_t* const pSrcPixels = flatFrag.pImageData->pPixels;
 
     // The x and y coordinate in world space of the screen column being drawn.
     // Note: take the horizontal center position of the pixel to improve accuracy, hence + 0.5 here:
@@ -105,8 +188,8 @@ static inline void drawFlatColumn(const FlatFragment flatFrag) noexcept {
         endDstY = (int32_t)(flatFrag.y - 1);
     }
 
-    const uint32_t startScreenX = g3dViewXOffset + flatFrag.x;
-    const uint32_t startScreenY = g3dViewYOffset + (uint32_t) curDstY;
+    const uint32_t startViewX = flatFrag.x;
+    const uint32_t startViewY = (uint32_t) curDstY;
 
     // This is where we store the intersection of a ray going from the view point to the flat plane.
     // The ray passes through whatever near plane pixel on the screen we are rendering and we update
@@ -143,8 +226,8 @@ static inline void drawFlatColumn(const FlatFragment flatFrag) noexcept {
     }
 
     // Draw the column!
-    const uint32_t screenWidth = Video::gScreenWidth;
-    uint32_t* pDstPixel = Video::gpFrameBuffer + (uintptr_t) startScreenY * screenWidth + startScreenX;
+    const uint32_t screenWidth = gViewPixelsPitch;
+    uint32_t* pDstPixel = gpViewPixels + (uintptr_t) startViewY * screenWidth + startViewX;
 
     while (true) {
         // Are we done?
@@ -156,34 +239,10 @@ static inline void drawFlatColumn(const FlatFragment flatFrag) noexcept {
                 break;
         }
 
-        // Get the source pixel (ARGB1555 format).
-        // Note that the flat texture is always expected to be 64x64, hence we can wraparound with a simple bitwise AND:
-        const uint32_t curSrcXInt = (uint32_t) intersectX & 63;
-        const uint32_t curSrcYInt = (uint32_t) intersectY & 63;
-        const uint16_t srcPixelARGB1555 = pSrcPixels[curSrcYInt * 64 + curSrcXInt];
-
-        // Extract RGB components and shift such that the maximum value is 255 instead of 31.
-        const uint16_t texR = (uint16_t)((srcPixelARGB1555 & uint16_t(0b0111110000000000)) >> 7);
-        const uint16_t texG = (uint16_t)((srcPixelARGB1555 & uint16_t(0b0000001111100000)) >> 2);
-        const uint16_t texB = (uint16_t)((srcPixelARGB1555 & uint16_t(0b0000000000011111)) << 3);
-
-        // Get the distance to the view point and light multiplier for that distance
+        // Get the distance to the view point and light multiplier for that distance, then draw the pixel
         const float distToView = FMath::distance3d(intersectX, intersectY, intersectZ, viewX, viewY, viewZ);
         const float lightMul = lightParams.getLightMulForDist(distToView);
-
-        // Get the texture colors in 0-255 float format.
-        // Note that if we are not doing any color multiply these conversions would be redundant, but I'm guessing
-        // that the compiler would be smart enough to optimize out the useless operations in those cases (hopefully)!
-        const float r = std::min((float) texR * lightMul, 255.0f);
-        const float g = std::min((float) texG * lightMul, 255.0f);
-        const float b = std::min((float) texB * lightMul, 255.0f);
-
-        // Write out the pixel value
-        *pDstPixel = (
-            (uint32_t(r) << 16) |
-            (uint32_t(g) << 8) |
-            (uint32_t(b))
-        );
+        drawFlatPixel(pDstPixel, pSrcPixels, intersectX, intersectY, lightMul);
 
         // Move onto the next pixel
         if constexpr (MODE == DrawFlatMode::FLOOR) {
@@ -216,15 +275,193 @@ static inline void drawFlatColumn(const FlatFragment flatFrag) noexcept {
     }
 }
 
-void drawAllFloorFragments() noexcept {
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draw one vertical column of a flat, doing the expensive calculations only at the ends of spans of pixels.
+//
+// The lighting for each span is computed exactly at both ends of the span and linearly interpolated in between. If 'AFFINE' is
+// set then the texture coordinates are also linearly interpolated, otherwise they are computed exactly for each pixel. Note that
+// since the depth of the ray intersection varies with the reciprocal of the screen y position, the perspective correct texture
+// coordinate only costs one division per pixel. Affine texture mapping can cause some visible warping near the horizon.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <DrawFlatMode MODE, bool AFFINE, class SrcPixelT>
+static inline void drawFlatColumnInSpans(
+    const FlatFragment flatFrag,
+    const SrcPixelT* const pSrcPixels,
+    const uint32_t spanLength
+) noexcept {
+    BLIT_ASSERT(spanLength > 1);
+
+    // Cache some useful values
+    const float viewX = gViewX;
+    const float viewY = gViewY;
+    const float viewZ = gViewZ;
+    const float flatPlaneZ = flatFrag.worldZ;
+
+    const LightParams& lightParams = getLightParams(flatFrag.sectorLightLevel);
+
+    // Compute the xz direction of the ray going from the view through this screen column (same as 'drawFlatColumn')
+    const float nearPlaneX = gNearPlaneP1x + ((float) flatFrag.x + 0.5f) * gNearPlaneXStepPerViewCol;
+    const float nearPlaneY = gNearPlaneP1y + ((float) flatFrag.x + 0.5f) * gNearPlaneYStepPerViewCol;
+    const float rayDirX = nearPlaneX - viewX;
+    const float rayDirY = nearPlaneY - viewY;
+
+    // Where to start outputting to and which direction to step in.
+    // Note that floors rendered in a top to bottom direction, while ceilings are bottom to top:
+    constexpr int32_t DST_Y_STEP = (MODE == DrawFlatMode::FLOOR) ? +1 : -1;
+    int32_t curDstY;
+
+    if constexpr (MODE == DrawFlatMode::FLOOR) {
+        curDstY = (int32_t)(flatFrag.y);
+    } else {
+        curDstY = (int32_t)(flatFrag.y + flatFrag.height - 1);
+    }
+
+    const uint32_t screenWidth = gViewPixelsPitch;
+    const intptr_t dstPixelStep = (intptr_t) screenWidth * DST_Y_STEP;
+    const uint32_t startViewX = flatFrag.x;
+    const uint32_t startViewY = (uint32_t) curDstY;
+    uint32_t* pDstPixel = gpViewPixels + (uintptr_t) startViewY * screenWidth + startViewX;
+
+    // Get the world position and light for the first pixel in the column.
+    // Clamp the texture coordinate for the first pixel if specified, same as 'drawFlatColumn':
+    BLIT_ASSERT(flatFrag.depth >= 0.0f);
+    float spanStartX;
+    float spanStartY;
+    float spanStartZ;
+
+    if (flatFrag.bClampFirstPixel) {
+        spanStartX = flatFrag.worldX;
+        spanStartY = flatFrag.worldY;
+        spanStartZ = flatFrag.worldZ;
+    } else {
+        getFlatPointForColumnY<MODE>(flatPlaneZ, rayDirX, rayDirY, curDstY, spanStartX, spanStartY, spanStartZ);
+    }
+
+    float spanStartLightMul = lightParams.getLightMulForDist(
+        FMath::distance3d(spanStartX, spanStartY, spanStartZ, viewX, viewY, viewZ)
+    );
+
+    // Draw all the spans in the column
+    uint32_t numPixelsLeft = flatFrag.height;
+
+    while (numPixelsLeft > 0) {
+        // Figure out how many pixels are in this span and which pixel to compute the exact values for at the end of the span.
+        // If there are more pixels after this span then use the first pixel of the next span, so it's values can be re-used.
+        // Otherwise use the last pixel in the span so we never compute values outside of the flat column.
+        const uint32_t spanNumPixels = std::min(spanLength, numPixelsLeft);
+        const uint32_t spanEndOffset = (spanNumPixels < numPixelsLeft) ? spanNumPixels : spanNumPixels - 1;
+
+        float spanEndX = spanStartX;
+        float spanEndY = spanStartY;
+        float spanEndZ = spanStartZ;
+        float spanEndLightMul = spanStartLightMul;
+
+        if (spanEndOffset > 0) {
+            getFlatPointForColumnY<MODE>(
+                flatPlaneZ,
+                rayDirX,
+                rayDirY,
+                curDstY + (int32_t) spanEndOffset * DST_Y_STEP,
+                spanEndX,
+                spanEndY,
+                spanEndZ
+            );
+
+            spanEndLightMul = lightParams.getLightMulForDist(
+                FMath::distance3d(spanEndX, spanEndY, spanEndZ, viewX, viewY, viewZ)
+            );
+        }
+
+        // How much to step the interpolated values by on each pixel
+        const float stepScale = (spanEndOffset > 0) ? 1.0f / (float) spanEndOffset : 0.0f;
+        const float lightMulStep = (spanEndLightMul - spanStartLightMul) * stepScale;
+        [[maybe_unused]] const float texXStep = (spanEndX - spanStartX) * stepScale;
+        [[maybe_unused]] const float texYStep = (spanEndY - spanStartY) * stepScale;
+
+        // Draw the span. Note: the first pixel of the span always uses the values for the start of the span exactly.
+        float lightMul = spanStartLightMul;
+        float texX = spanStartX;
+        float texY = spanStartY;
+
+        for (uint32_t pixelIdx = 0; pixelIdx < spanNumPixels; ++pixelIdx) {
+            if constexpr (!AFFINE) {
+                if (pixelIdx > 0) {
+                    float intersectZ;
+                    getFlatPointForColumnY<MODE>(flatPlaneZ, rayDirX, rayDirY, curDstY, texX, texY, intersectZ);
+                }
+            }
+
+            drawFlatPixel(pDstPixel, pSrcPixels, texX, texY, lightMul);
+
+            // Move onto the next pixel
+            curDstY += DST_Y_STEP;
+            pDstPixel += dstPixelStep;
+            lightMul += lightMulStep;
+
+            if constexpr (AFFINE) {
+                texX += texXStep;
+                texY += texYStep;
+            }
+        }
+
+        // Onto the next span: the end of this span is the start of the next one
+        numPixelsLeft -= spanNumPixels;
+        spanStartX = spanEndX;
+        spanStartY = spanEndY;
+        spanStartZ = spanEndZ;
+        spanStartLightMul = spanEndLightMul;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draw one vertical column of a flat, using whatever method the user has chosen and the given flat pixels
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <DrawFlatMode MODE, class SrcPixelT>
+static inline void drawFlatColumnWithConfiguredMethod(const FlatFragment flatFrag, const SrcPixelT* const pSrcPixels) noexcept {
+    const uint32_t spanLength = Config::gFlatDrawSpanLength;
+
+    if (spanLength <= 1) {
+        drawFlatColumn<MODE>(flatFrag, pSrcPixels);
+    } else if (Config::gbFlatDrawAffineTexturing) {
+        drawFlatColumnInSpans<MODE, true>(flatFrag, pSrcPixels, spanLength);
+    } else {
+        drawFlatColumnInSpans<MODE, false>(flatFrag, pSrcPixels, spanLength);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draw one vertical column of a flat, using the pre-expanded 32-bit version of the flat texture if available
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <DrawFlatMode MODE>
+static inline void drawFlatFragment(const FlatFragment flatFrag) noexcept {
+    const ImageData& flatImage = *flatFrag.pImageData;
+
+    if (flatImage.pPixels32) {
+        drawFlatColumnWithConfiguredMethod<MODE>(flatFrag, flatImage.pPixels32);
+    } else {
+        drawFlatColumnWithConfiguredMethod<MODE>(flatFrag, flatImage.pPixels);
+    }
+}
+
+void drawAllFloorFragments(const DrawBand& band) noexcept {
+    PROFILE_ZONE("Floors");
+
     for (const FlatFragment& flatFrag : gFloorFragments) {
-        drawFlatColumn<DrawFlatMode::FLOOR>(flatFrag);
+        if ((flatFrag.x < band.beginX) || (flatFrag.x >= band.endX))
+            continue;
+
+        drawFlatFragment<DrawFlatMode::FLOOR>(flatFrag);
     }
 }
 
-void drawAllCeilingFragments() noexcept {
+void drawAllCeilingFragments(const DrawBand& band) noexcept {
+    PROFILE_ZONE("Ceilings");
+
     for (const FlatFragment& flatFrag : gCeilFragments) {
-        drawFlatColumn<DrawFlatMode::CEILING>(flatFrag);
+        if ((flatFrag.x < band.beginX) || (flatFrag.x >= band.endX))
+            continue;
+
+        drawFlatFragment<DrawFlatMode::CEILING>(flatFrag);
     }
 }
 
@@ -5,9 +5,13 @@
 // Nothing here is used by outside code.
 //------------------------------------------------------------------------------------------------------------------------------------------
 #include "Base/Angle.h"
+#include "Base/Arena.h"
+#include "Base/Tables.h"
 #include "Game/DoomDefines.h"
 #include "Renderer.h"
+#include <algorithm>
 #include <cstddef>
+#include <type_traits>
 #include <vector>
 
 struct ImageData;
@@ -60,14 +64,29 @@ namespace Renderer {
     // Describes lighting params for an input light level
     //------------------------------------------------------------------------------------------------------------------
     struct LightParams {
-        float   lightMin;       // Minimum light value allowed
-        float   lightMax;       // Maximum light value allowed
-        float   lightSub;       // Subtract this as part of the light diminishing calculations
-        float   lightCoef;      // Controls the falloff for light diminishing
+        float           lightMin;           // Minimum light value allowed
+        float           lightMax;           // Maximum light value allowed
+        float           lightSub;           // Subtract this as part of the light diminishing calculations
+        float           lightCoef;          // Controls the falloff for light diminishing
+        float           distToTableIdx;     // Converts a distance to an index in the light multiplier table
+        const float*    pLightMulTable;     // Precomputed light multipliers for this light level at evenly spaced distances
 
         // For these light parameters, gives a light multiplier that can be applied to textures etc.
         // after doing light diminishing effects. Requires the distance of the object from the camera.
-        float getLightMulForDist(const float dist) const noexcept;
+        // This version computes the light multiplier exactly and is used to build the precomputed light tables.
+        float getLightMulForDistExact(const float dist) const noexcept;
+
+        // Same as 'getLightMulForDistExact' but much faster, since it interpolates between precomputed values in the light table.
+        // Beyond the end of the table the light multiplier no longer changes with distance, so the last table value is used.
+        inline float getLightMulForDist(const float dist) const noexcept {
+            const float tableIdx = std::min(std::max(dist, 0.0f) * distToTableIdx, (float) LIGHT_TABLE_SIZE);
+            const uint32_t tableIdxInt = (uint32_t) tableIdx;
+            const float lerpFactor = tableIdx - (float) tableIdxInt;
+
+            const float lightMul1 = pLightMulTable[tableIdxInt];
+            const float lightMul2 = pLightMulTable[tableIdxInt + 1];
+            return lightMul1 + (lightMul2 - lightMul1) * lerpFactor;
+        }
     };
 
     //------------------------------------------------------------------------------------------------------------------
@@ -176,6 +195,7 @@ namespace Renderer {
     //------------------------------------------------------------------------------------------------------------------
     struct DrawSprite {
         const uint16_t*     pPixels;            // Pixels for the sprite (in column major format)
+        const uint32_t*     pPixels32;          // Optional pre-expanded ARGB8888 pixels for the sprite (in column major format), or 'nullptr' if not available
         float               worldX;             // World center X position of the sprite (used for occlusion tests)
         float               worldY;             // World center Y position of the sprite (used for occlusion tests)
         float               screenLx;           // Left and right screen X values
@@ -191,50 +211,83 @@ namespace Renderer {
     };
 
     //------------------------------------------------------------------------------------------------------------------
-    // Contains a fragment of a sprite to be drawn
+    // A column of a sprite to be drawn, after clipping against occluders
     //------------------------------------------------------------------------------------------------------------------
-    struct SpriteFragment {
+    struct SpriteColumn {
         uint16_t            x;                      // Screen x and y
-        int16_t             y;
+        uint16_t            y;
         uint16_t            height;                 // Screen height
-        uint16_t            texH : 15;              // Height of the sprite texture
-        uint16_t            isTransparent : 1;      // If '1' then draw the sprite transparent (used for spectres)
-        float               depth;                  // Depth that the sprite is at (used for all sprite fragments)
-        float               lightMul;               // Light multiplier
-        float               texYStep;               // Stepping to use for the 'Y' texture coordinate
+        float               texY;                   // 'Y' texture coordinate for the first pixel
         float               texYSubPixelAdjust;     // Sub-pixel adjustment for 'Y' texture coordinate. Applied to every pixel after the first.
-        const uint16_t*     pSpriteColPixels;       // The image data for the sprite (in column major format)
-        float               spriteWorldX;           // World center of the sprite: X
-        float               spriteWorldY;           // World center of the sprite: Y
+        const uint16_t*     pPixels;                // The image data for the sprite column (in column major format)
+        const uint32_t*     pPixels32;              // Optional pre-expanded ARGB8888 image data for the sprite column, or 'nullptr' if not available
+
+        template <class SrcPixelT>
+        inline const SrcPixelT* getPixels() const noexcept {
+            if constexpr (std::is_same_v<SrcPixelT, uint16_t>) {
+                return pPixels;
+            } else {
+                static_assert(std::is_same_v<SrcPixelT, uint32_t>);
+                return pPixels32;
+            }
+        }
     };
 
     //------------------------------------------------------------------------------------------------------------------
-    // Data structure that for every column on the screen describes all of the occluding columns.
-    // Used for sprite rendering.
+    // A block of occluding columns for one screen column, used for sprite rendering.
+    //
+    // The occluding columns for each screen column are stored in a chain of these blocks, which are allocated from the
+    // 'gOccluderBlocks' pool for the frame. This allows any number of occluders per screen column without reserving room
+    // for the worst case in every column. Data is laid out so that the line depths for a whole block can be tested against
+    // a sprite at once with SIMD.
     //------------------------------------------------------------------------------------------------------------------
-    struct OccludingColumns {
-        static constexpr uint32_t MAX_ENTRIES = 16;
-
-        // The number of occluding column entries.
-        uint32_t count;
+    struct alignas(16) OccluderBlock {
+        static constexpr uint32_t NUM_ENTRIES = 4;
 
-        // The depths of each occluding column.
-        // Note: is automatically in ascending order due to the nature of the BSP tree rendering - hence can be binary searched!
-        float depths[MAX_ENTRIES];
+        // The min and max depths of the line for each occluding column in the block.
+        // Used for quickly determining whether a sprite is definitely in front of or behind the line.
+        float lineMinDepths[NUM_ENTRIES];
+        float lineMaxDepths[NUM_ENTRIES];
 
         // The lines for each occluding column.
         // Used for the purposes of sprite clipping.
-        line_t* pLines[MAX_ENTRIES];
+        line_t* pLines[NUM_ENTRIES];
 
         // How much screen real estate each occluding column occupies at the top and bottom of the screen.
         // Anything at or above the top coordinate is occluded.
         // Anything at or below the bottom coordinate is occluded.
+        //
+        // Note: each occluding column in a screen column only ever narrows the bounds of the previous one, hence the
+        // clip bounds for a sprite are simply the bounds of the last occluding column which is in front of it.
         struct Bounds {
             int16_t top;
             int16_t bottom;
         };
 
-        Bounds bounds[MAX_ENTRIES];
+        Bounds bounds[NUM_ENTRIES];
+
+        // The number of occluding column entries used in this block and the index of the previous block for the
+        // screen column (or 'INVALID_IDX' if none). Only the most recent block for a screen column can be partially used.
+        uint32_t count;
+        uint32_t prevBlockIdx;
+
+        static constexpr uint32_t INVALID_IDX = UINT32_MAX;
+    };
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Data structure that for every column on the screen describes all of the occluding columns.
+    // Used for sprite rendering.
+    //------------------------------------------------------------------------------------------------------------------
+    struct OccludingColumns {
+        // The number of occluding column entries.
+        uint32_t count;
+
+        // The most recently added block of occluding columns, or 'OccluderBlock::INVALID_IDX' if there are none
+        uint32_t lastBlockIdx;
+
+        // The depth of the most recently added occluding column.
+        // Note: occluding columns are automatically in ascending order of depth due to the nature of the BSP tree rendering.
+        float lastDepth;
     };
 
     //------------------------------------------------------------------------------------------------------------------
@@ -276,6 +329,43 @@ namespace Renderer {
         const ImageData*    pImageData;
     };
 
+    //------------------------------------------------------------------------------------------------------------------
+    // Coarse coverage info for a tile of adjacent screen columns, kept up to date as segs are emitted.
+    // Used to quickly cull BSP nodes and sprites which are completely hidden behind nearer walls, floors and ceilings.
+    //------------------------------------------------------------------------------------------------------------------
+    struct CoverageTile {
+        static constexpr uint32_t NUM_COLS = 8;     // Number of screen columns in each tile
+
+        uint16_t    numFullSegCols;     // Number of columns in the tile which accept no more seg (wall + floor) pixels
+        uint16_t    numOccludedCols;    // Number of columns in the tile where the last occluding column leaves nothing visible
+        float       maxOccluderDepth;   // The greatest max line depth out of all those fully occluding columns in the tile
+    };
+
+    //------------------------------------------------------------------------------------------------------------------
+    // Describes a vertical band of screen columns in the 3D view which is rasterized by a single thread.
+    // Each band only ever writes to its own columns in the framebuffer, hence no locking is required between bands.
+    // Any state which would otherwise be shared (and written to) during drawing is also kept here, per band.
+    //------------------------------------------------------------------------------------------------------------------
+    struct DrawBand {
+        uint32_t                    beginX;                     // First screen column in the band (inclusive)
+        uint32_t                    endX;                       // End screen column for the band (exclusive)
+        uint32_t                    spriteValidCount;           // Incremented for every sprite drawn: used to tell if the line sprite clip caches below are stale
+        std::vector<uint32_t>       lineSpriteValidCounts;      // Per line: the value of 'spriteValidCount' when 'lineIsInFrontOfSprite' was last computed
+        std::vector<uint8_t>        lineIsInFrontOfSprite;      // Per line: whether the line is considered in front of the current sprite being drawn
+        Arena                       scratchArena;               // Per frame scratch memory for the band: reset when drawing the band's sprites
+        ArenaVector<SpriteColumn>   spriteColumns;              // The clipped columns of the current sprite being drawn
+        ArenaVector<uint32_t>       spriteRowTexYs;             // The texture row to use for each screen row of the run of sprite columns being drawn
+        ArenaVector<uint32_t>       spriteCoverage;             // Front to back sprite drawing only: bits for which pixels are already covered, column by column
+        uint32_t                    spriteCoverageColWords;     // Number of 32-bit words of 'spriteCoverage' used by each screen column
+
+        // Time spent on each draw pass for the band (microseconds), only updated if collecting frame timings
+        double  skyDrawTime;
+        double  floorDrawTime;
+        double  ceilingDrawTime;
+        double  wallDrawTime;
+        double  spriteDrawTime;
+    };
+
     //==================================================================================================================
     // Globals shared throughout the renderer - defined in Renderer.cpp
     //==================================================================================================================
@@ -311,33 +401,51 @@ namespace Renderer {
     extern float                            gNearPlaneZStepPerViewColPixel;     // How much to step world z for each successive pixel in a screen column at the near plane
     extern ProjectionMatrix                 gProjMatrix;                        // 3D projection matrix
     extern uint32_t                         gExtraLight;                        // Bumped light from gun blasts
+    extern uint32_t*                        gpViewPixels;                       // Where the top left pixel of the 3D view is drawn to: in the framebuffer, or the dynamic resolution buffer
+    extern uint32_t                         gViewPixelsPitch;                   // Number of pixels from one row of 'gpViewPixels' to the next
     extern std::vector<angle_t>             gScreenXToAngleBAM;                 // Convert from a screen X coordinate to a Doom format (BAM) angle
-    extern std::vector<DrawSeg>             gDrawSegs;
+    extern Arena                            gFrameArena;                        // Memory for all the lists of things to draw for the current frame: reset at the start of each frame
     extern std::vector<SegClip>             gSegClip;                           // Used to clip seg columns (walls + floors) vertically as segs are being submitted. One entry per screen column.
     extern std::vector<OccludingColumns>    gOccludingCols;                     // Used to clip sprite columns. One entry per screen column.
+    extern ArenaVector<OccluderBlock>       gOccluderBlocks;                    // Storage for the occluding columns of all screen columns, for the current frame
     extern uint32_t                         gNumFullSegCols;                    // The number of columns that will accept no more seg pixels. Used to stop emitting segs when we have filled the screen.
-    extern std::vector<WallFragment>        gWallFragments;                     // Wall fragments to be drawn
-    extern std::vector<FlatFragment>        gFloorFragments;                    // Floor fragments to be drawn
-    extern std::vector<FlatFragment>        gCeilFragments;                     // Ceiling fragments to be drawn
-    extern std::vector<SkyFragment>         gSkyFragments;                      // Sky fragments to be drawn
-    extern std::vector<DrawSprite>          gDrawSprites;                       // Sprites to be drawn that will later be turned into fragments (after depth sort)
+    extern std::vector<CoverageTile>        gCoverageTiles;                     // Coarse coverage info for each tile of 'CoverageTile::NUM_COLS' screen columns
+    extern ArenaVector<WallFragment>        gWallFragments;                     // Wall fragments to be drawn
+    extern ArenaVector<FlatFragment>        gFloorFragments;                    // Floor fragments to be drawn
+    extern ArenaVector<FlatFragment>        gCeilFragments;                     // Ceiling fragments to be drawn
+    extern ArenaVector<SkyFragment>         gSkyFragments;                      // Sky fragments to be drawn
+    extern ArenaVector<DrawSprite>          gDrawSprites;                       // Sprites to be drawn that will later be turned into fragments (after depth sort)
     
     //==================================================================================================================
     // Functions
     //==================================================================================================================
 
     void doBspTraversal() noexcept;
-    void addSegToFrame(seg_t& seg) noexcept;
+    bool isScreenRangeFullOfSegs(const uint32_t lx, const uint32_t rx) noexcept;
+    bool isScreenRangeOccluded(const uint32_t lx, const uint32_t rx, const float depth) noexcept;
+    void addSegsToFrame(seg_t* const pSegs, const uint32_t numSegs) noexcept;
     void addSpriteToFrame(const mobj_t& thing) noexcept;
     void drawAllLineSegs() noexcept;
-    void drawAllWallFragments() noexcept;
-    void drawAllFloorFragments() noexcept;
-    void drawAllCeilingFragments() noexcept;
-    void drawAllSkyFragments() noexcept;
-    void drawAllSprites() noexcept;
+    void drawAllWallFragments(const DrawBand& band) noexcept;
+    void drawAllFloorFragments(const DrawBand& band) noexcept;
+    void drawAllCeilingFragments(const DrawBand& band) noexcept;
+    void updateSkyColumnCache() noexcept;
+    void drawAllSkyFragments(const DrawBand& band) noexcept;
+    void sortAllSprites() noexcept;
+    void drawAllSprites(DrawBand& band) noexcept;
+    void captureWeaponDrawState() noexcept;
     void drawWeapons() noexcept;
+    void capturePostFxState() noexcept;
     void doPostFx() noexcept;
 
+    // Multi-threaded rasterization of the 3D view in vertical column bands: see 'Renderer_DrawBands.cpp'.
+    // The view can be drawn either synchronously, or asynchronously by starting the drawing and waiting for it to end later.
+    void initDrawBands() noexcept;
+    void shutdownDrawBands() noexcept;
+    void drawAllBands() noexcept;
+    void beginDrawingAllBands() noexcept;
+    void endDrawingAllBands() noexcept;
+
     // Get light parameters for a floor or wall at the given light level
     LightParams getLightParams(const uint32_t sectorLightLevel) noexcept;
 }
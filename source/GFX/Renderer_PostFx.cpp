@@ -1,31 +1,62 @@
 #include "Renderer_Internal.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
 #include "Game/Data.h"
+#include "SIMD.h"
 #include "Video.h"
 #include <algorithm>
 
 BEGIN_NAMESPACE(Renderer)
 
-static void doInvulnerabilityEffect() noexcept {
-    // The invunerability effect in 3DO Doom was a simple bit inverse.
-    // The 3DO game did not use the palette switching technique that the PC version did because there was no palette...
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Replaces every pixel in the 3D view with the result of the given color transform, in a single pass over the view.
+// When SIMD is available the 4 pixel version of the transform is used for as much of each row as possible, which must give exactly the
+// same results as the single pixel version. The single pixel version handles whatever is left over at the end of each row.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class ColorTransformT, class ColorTransform4T>
+static void transformViewPixels(
+    const ColorTransformT& colorTransform,
+    [[maybe_unused]] const ColorTransform4T& colorTransform4
+) noexcept {
+    const uint32_t viewW = g3dViewWidth;
     const uint32_t viewH = g3dViewHeight;
-    const uint32_t screenH = Video::gScreenWidth;
+    const uint32_t pitch = gViewPixelsPitch;
 
-    for (uint32_t y = 0; y <= viewH; ++y) {
-        // Process this row of pixels and invert RGB values
-        uint32_t* pPixel = &Video::gpFrameBuffer[g3dViewXOffset + (g3dViewYOffset + y) * screenH];
-        uint32_t* const pEndPixel = pPixel + g3dViewWidth;
+    for (uint32_t y = 0; y < viewH; ++y) {
+        uint32_t* const pRow = gpViewPixels + (uintptr_t) y * pitch;
+        uint32_t x = 0;
 
-        while (pPixel < pEndPixel) {
-            const uint32_t color = *pPixel;
-            *pPixel = (~color) & 0x00FFFFFFu;
-            ++pPixel;
+        #if SIMD_ENABLED == 1
+            for (; x + 4 <= viewW; x += 4) {
+                colorTransform4(pRow + x);
+            }
+        #endif
+
+        for (; x < viewW; ++x) {
+            pRow[x] = colorTransform(pRow[x]);
         }
     }
 }
 
+static void doInvulnerabilityEffect() noexcept {
+    // The invunerability effect in 3DO Doom was a simple bit inverse.
+    // The 3DO game did not use the palette switching technique that the PC version did because there was no palette...
+    transformViewPixels(
+        [](const uint32_t color) noexcept {
+            return (~color) & 0x00FFFFFFu;
+        },
+        []([[maybe_unused]] uint32_t* const pPixels) noexcept {
+            #if SIMD_SSE2
+                const __m128i pixelsV = _mm_loadu_si128((const __m128i*) pPixels);
+                _mm_storeu_si128((__m128i*) pPixels, _mm_andnot_si128(pixelsV, _mm_set1_epi32(0x00FFFFFF)));
+            #elif SIMD_NEON
+                vst1q_u32(pPixels, vbicq_u32(vdupq_n_u32(0x00FFFFFFu), vld1q_u32(pPixels)));
+            #endif
+        }
+    );
+}
+
 static void doTintEffect(const uint32_t r5, const uint32_t g5, const uint32_t b5) noexcept {
     // If there is no effect do nothing
     if (r5 == 0 && g5 == 0 && b5 == 0)
@@ -33,65 +64,103 @@ static void doTintEffect(const uint32_t r5, const uint32_t g5, const uint32_t b5
 
     // Create a fixed point multiplier for RGB values
     constexpr Fixed COL5_MAX_FRAC = intToFixed16(31);
-    constexpr Fixed COL8_MAX_FRAC = intToFixed16(255);
     constexpr Fixed EFFECT_STRENGHT = intToFixed16(2);
 
-    const Fixed rMul = FRACUNIT + fixed16Mul(fixed16Div(intToFixed16((int32_t) r5), COL5_MAX_FRAC), EFFECT_STRENGHT);
-    const Fixed gMul = FRACUNIT + fixed16Mul(fixed16Div(intToFixed16((int32_t) g5), COL5_MAX_FRAC), EFFECT_STRENGHT);
-    const Fixed bMul = FRACUNIT + fixed16Mul(fixed16Div(intToFixed16((int32_t) b5), COL5_MAX_FRAC), EFFECT_STRENGHT);
-
-    // Modulate all of the RGB values in the framebuffer
-    const uint32_t screenH = g3dViewHeight;
-
-    for (uint32_t y = 0; y <= screenH; ++y) {
-        // Process this row of pixels
-        uint32_t* pPixel = &Video::gpFrameBuffer[g3dViewXOffset + (g3dViewYOffset + y) * Video::gScreenWidth];
-        uint32_t* const pEndPixel = pPixel + g3dViewWidth;
-
-        while (pPixel < pEndPixel) {
-            // Get the old colors from 0-1
-            const uint32_t color = *pPixel;
-            const Fixed oldRFrac = intToFixed16((color >> 16) & 0xFFu);
-            const Fixed oldGFrac = intToFixed16((color >> 8) & 0xFFu);
-            const Fixed oldBFrac = intToFixed16(color & 0xFFu);
-
-            // Modulate and clamp
-            const Fixed rFrac = std::min(fixed16Mul(oldRFrac, rMul), COL8_MAX_FRAC);
-            const Fixed gFrac = std::min(fixed16Mul(oldGFrac, gMul), COL8_MAX_FRAC);
-            const Fixed bFrac = std::min(fixed16Mul(oldBFrac, bMul), COL8_MAX_FRAC);
-
-            // Make a framebuffer color
-            const uint32_t finalColor = (
-                ((uint32_t) fixed16ToInt(rFrac) << 16) |
-                ((uint32_t) fixed16ToInt(gFrac) << 8) |
-                ((uint32_t) fixed16ToInt(bFrac))
-            );
-
-            *pPixel = finalColor;
-            ++pPixel;
+    const uint32_t rMul = (uint32_t)(FRACUNIT + fixed16Mul(fixed16Div(intToFixed16((int32_t) r5), COL5_MAX_FRAC), EFFECT_STRENGHT));
+    const uint32_t gMul = (uint32_t)(FRACUNIT + fixed16Mul(fixed16Div(intToFixed16((int32_t) g5), COL5_MAX_FRAC), EFFECT_STRENGHT));
+    const uint32_t bMul = (uint32_t)(FRACUNIT + fixed16Mul(fixed16Div(intToFixed16((int32_t) b5), COL5_MAX_FRAC), EFFECT_STRENGHT));
+
+    // For the SIMD version each color component is widened to 16-bits and the multiply is split into whole and fractional parts,
+    // each of which fits in 16-bits since the multiplier is at most 3.0. The fractional part is done with a 'multiply high' which
+    // gives the top 16-bits of the 32-bit product, so overall this gives exactly the same result as the single pixel version.
+    // The multipliers are laid out in memory order for an XRGB8888 pixel: B, G, R and then X (which is zeroed).
+    [[maybe_unused]] const uint16_t mulInt[4] = { (uint16_t)(bMul >> 16), (uint16_t)(gMul >> 16), (uint16_t)(rMul >> 16), 0 };
+    [[maybe_unused]] const uint16_t mulFrac[4] = { (uint16_t) bMul, (uint16_t) gMul, (uint16_t) rMul, 0 };
+
+    #if SIMD_SSE2
+        const __m128i mulIntV = _mm_set_epi16(0, mulInt[2], mulInt[1], mulInt[0], 0, mulInt[2], mulInt[1], mulInt[0]);
+        const __m128i mulFracV = _mm_set_epi16(
+            0, (int16_t) mulFrac[2], (int16_t) mulFrac[1], (int16_t) mulFrac[0],
+            0, (int16_t) mulFrac[2], (int16_t) mulFrac[1], (int16_t) mulFrac[0]
+        );
+    #elif SIMD_NEON
+        const uint16x8_t mulIntV = vcombine_u16(vld1_u16(mulInt), vld1_u16(mulInt));
+        const uint16x4_t mulFracV = vld1_u16(mulFrac);
+    #endif
+
+    // Modulate all of the RGB values in the 3D view.
+    // Note: multiplying the 8-bit integer color by the 16.16 multiplier gives the same result as a 16.16 fixed point multiply of the
+    // color, but without needing 64-bit math. The result always fits in 32-bits since the multiplier is at most 3.0.
+    transformViewPixels(
+        [=](const uint32_t color) noexcept {
+            const uint32_t r = std::min((((color >> 16) & 0xFFu) * rMul) >> 16, 0xFFu);
+            const uint32_t g = std::min((((color >> 8) & 0xFFu) * gMul) >> 16, 0xFFu);
+            const uint32_t b = std::min(((color & 0xFFu) * bMul) >> 16, 0xFFu);
+            return (r << 16) | (g << 8) | b;
+        },
+        [=]([[maybe_unused]] uint32_t* const pPixels) noexcept {
+            #if SIMD_SSE2
+                const __m128i pixelsV = _mm_loadu_si128((const __m128i*) pPixels);
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i maxColor = _mm_set1_epi16(0xFF);
+
+                auto modulate = [&](const __m128i colors) noexcept {
+                    const __m128i mulColors = _mm_add_epi16(_mm_mullo_epi16(colors, mulIntV), _mm_mulhi_epu16(colors, mulFracV));
+                    return _mm_min_epi16(mulColors, maxColor);
+                };
+
+                const __m128i pixels01 = modulate(_mm_unpacklo_epi8(pixelsV, zero));
+                const __m128i pixels23 = modulate(_mm_unpackhi_epi8(pixelsV, zero));
+                _mm_storeu_si128((__m128i*) pPixels, _mm_packus_epi16(pixels01, pixels23));
+            #elif SIMD_NEON
+                const uint8x16_t pixelsV = vreinterpretq_u8_u32(vld1q_u32(pPixels));
+                const uint16x8_t maxColor = vdupq_n_u16(0xFF);
+
+                auto modulate = [&](const uint16x8_t colors) noexcept {
+                    const uint16x8_t mulColorsFrac = vcombine_u16(
+                        vshrn_n_u32(vmull_u16(vget_low_u16(colors), mulFracV), 16),
+                        vshrn_n_u32(vmull_u16(vget_high_u16(colors), mulFracV), 16)
+                    );
+
+                    return vminq_u16(vaddq_u16(vmulq_u16(colors, mulIntV), mulColorsFrac), maxColor);
+                };
+
+                const uint16x8_t pixels01 = modulate(vmovl_u8(vget_low_u8(pixelsV)));
+                const uint16x8_t pixels23 = modulate(vmovl_u8(vget_high_u8(pixelsV)));
+                vst1q_u32(pPixels, vreinterpretq_u32_u8(vcombine_u8(vmovn_u16(pixels01), vmovn_u16(pixels23))));
+            #endif
         }
-    }
+    );
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Does post processing fx on the entire 3D view
+// Post fx to apply to the 3D view, decided from the player state at the start of drawing the view.
+// Captured up front so that the game can keep simulating while the view is still being drawn.
 //------------------------------------------------------------------------------------------------------------------------------------------
-void doPostFx() noexcept {
+struct PostFxState {
+    bool        bDoInvunFx;     // Do the invulnerability effect? If so then no other effects are done
+    uint32_t    redFx;          // Amount of red, green and blue tint to apply (0-31)
+    uint32_t    greenFx;
+    uint32_t    blueFx;
+};
+
+static PostFxState gPostFxState;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Decides what post fx to do for the view from the current player state
+//------------------------------------------------------------------------------------------------------------------------------------------
+void capturePostFxState() noexcept {
     const player_t& player = gPlayer;
+    PostFxState& fxState = gPostFxState;
 
     // See if we are to do the invulnerability effect.
     // If this effect is in place then do that exclusively and nothing else:
     const uint32_t invunTicksLeft = player.powers[pw_invulnerability];
-    const bool bDoInvunFx = (
+    fxState.bDoInvunFx = (
         (invunTicksLeft > TICKSPERSEC * 4) ||   // Full strength?
         (invunTicksLeft & 0x10)                 // Flashing?
     );
 
-    if (bDoInvunFx) {
-        doInvulnerabilityEffect();
-        return;
-    }
-
     // Do color effects due to other powerups and pain/item-pickup
     const uint32_t pickupFx = player.bonuscount / 2;
 
@@ -121,11 +190,24 @@ void doPostFx() noexcept {
         blueFx += player.cheatFxTicksLeft;
     }
 
-    redFx = std::min(redFx, 31u);
-    greenFx = std::min(greenFx, 31u);
-    blueFx = std::min(blueFx, 31u);
+    fxState.redFx = std::min(redFx, 31u);
+    fxState.greenFx = std::min(greenFx, 31u);
+    fxState.blueFx = std::min(blueFx, 31u);
+}
 
-    doTintEffect(redFx, greenFx, blueFx);
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Does post processing fx on the entire 3D view
+//------------------------------------------------------------------------------------------------------------------------------------------
+void doPostFx() noexcept {
+    PROFILE_ZONE("Post FX");
+
+    const PostFxState& fxState = gPostFxState;
+
+    if (fxState.bDoInvunFx) {
+        doInvulnerabilityEffect();
+    } else {
+        doTintEffect(fxState.redFx, fxState.greenFx, fxState.blueFx);
+    }
 }
 
 END_NAMESPACE(Renderer)
@@ -1,14 +1,18 @@
 #include "Renderer_Internal.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
 #include "Blit.h"
+#include "Game/Config.h"
 #include "Game/Data.h"
 #include "Map/MapData.h"
 #include "Map/MapUtil.h"
+#include "SIMD.h"
 #include "Sprites.h"
 #include "Things/Info.h"
 #include "Things/MapObj.h"
 #include "Video.h"
+#include <cstring>
 
 BEGIN_NAMESPACE(Renderer)
 
@@ -252,12 +256,24 @@ void addSpriteToFrame(const mobj_t& thing) noexcept {
     float screenBy;
     transformSpriteCoordsToScreenSpace(clipLx, clipRx, clipTz, clipBz, clipW, screenLx, screenRx, screenTy, screenBy);
 
+    // If the sprite would be completely clipped away by walls that are definitely in front of it then don't bother adding it.
+    // Note: the range of columns checked includes the extra column which might be drawn past the right side of the sprite.
+    if (Config::gbOcclusionCulling) {
+        const float viewW = (float) g3dViewWidth;
+        const uint32_t lx = (uint32_t) std::min(std::max(screenLx, 0.0f), viewW - 1.0f);
+        const uint32_t rx = (uint32_t) std::min(std::max(screenRx + 1.0f, 0.0f), viewW - 1.0f);
+
+        if ((lx <= rx) && isScreenRangeOccluded(lx, rx, clipW))
+            return;
+    }
+
     // Determine the light multiplier for the sprite
     const float lightMul = determineLightMultiplierForThing(thing, bIsSpriteFullBright, clipW);
 
     // Makeup the draw sprite and add to the list
     DrawSprite drawSprite;
     drawSprite.pPixels = spriteFrameAngle->pTexture;
+    drawSprite.pPixels32 = spriteFrameAngle->pTexture32;
     drawSprite.worldX = worldX;
     drawSprite.worldY = worldY;
     drawSprite.screenLx = screenLx;
@@ -275,16 +291,91 @@ void addSpriteToFrame(const mobj_t& thing) noexcept {
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Sorts all sprites in the 3d view submitted to the renderer from back to front
+// The order to draw sprites in and whether to draw them front to back, worked out by 'sortAllSprites'
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct SpriteSortEntry {
+    uint32_t    key;            // Sort key, derived from the sprite depth
+    uint32_t    spriteIdx;      // Index of the sprite in 'gDrawSprites'
+};
+
+static ArenaVector<SpriteSortEntry>     gSpriteSortEntries;         // Note: allocated from the frame arena
+static ArenaVector<SpriteSortEntry>     gSpriteSortTmpEntries;      // Scratch for the radix sort, also allocated from the frame arena
+static bool                             gbDrawSpritesFrontToBack;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Gets a key for a sprite depth such that sorting the keys in ascending order sorts the sprites from back to front
+//------------------------------------------------------------------------------------------------------------------------------------------
+static inline uint32_t getSpriteDepthSortKey(const float depth) noexcept {
+    // Make the float bits sort in ascending order of depth as unsigned integers, then invert so the deepest sprites come first
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    const uint32_t ascendingKey = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    return ~ascendingKey;
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
-static void sortAllSprites() noexcept {
-    std::sort(
-        gDrawSprites.begin(),
-        gDrawSprites.end(),
-        [](const DrawSprite& s1, const DrawSprite& s2) noexcept {
-            return (s1.depth > s2.depth);
+// Sorts all sprites in the 3d view submitted to the renderer from back to front.
+// Must be done before any sprites are drawn, and on one thread only.
+//
+// Rather than moving the sprites themselves, a list of sort keys and sprite indexes is sorted using a radix sort (8 bits at a time).
+// Passes where every key has the same value for those 8 bits are skipped, which is often the case for the upper bits of the depth.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void sortAllSprites() noexcept {
+    // The memory used by the lists from the previous frame has been freed by now, get new memory from the frame arena
+    const uint32_t numSprites = (uint32_t) gDrawSprites.size();
+    releaseArenaVector(gSpriteSortEntries, gFrameArena);
+    releaseArenaVector(gSpriteSortTmpEntries, gFrameArena);
+    gSpriteSortEntries.resize(numSprites);
+    gSpriteSortTmpEntries.resize(numSprites);
+
+    for (uint32_t spriteIdx = 0; spriteIdx < numSprites; ++spriteIdx) {
+        gSpriteSortEntries[spriteIdx].key = getSpriteDepthSortKey(gDrawSprites[spriteIdx].depth);
+        gSpriteSortEntries[spriteIdx].spriteIdx = spriteIdx;
+    }
+
+    // Count how many keys there are of each digit value, for all passes at once
+    uint32_t digitCounts[4][256] = {};
+
+    for (const SpriteSortEntry& entry : gSpriteSortEntries) {
+        ++digitCounts[0][(entry.key      ) & 0xFFu];
+        ++digitCounts[1][(entry.key >>  8) & 0xFFu];
+        ++digitCounts[2][(entry.key >> 16) & 0xFFu];
+        ++digitCounts[3][(entry.key >> 24) & 0xFFu];
+    }
+
+    // Do each sort pass from the least significant digit to the most significant
+    for (uint32_t passIdx = 0; passIdx < 4; ++passIdx) {
+        const uint32_t shift = passIdx * 8;
+        uint32_t (&counts)[256] = digitCounts[passIdx];
+
+        if ((numSprites == 0) || (counts[(gSpriteSortEntries[0].key >> shift) & 0xFFu] == numSprites))
+            continue;
+
+        uint32_t digitOffsets[256];
+        uint32_t curOffset = 0;
+
+        for (uint32_t digit = 0; digit < 256; ++digit) {
+            digitOffsets[digit] = curOffset;
+            curOffset += counts[digit];
         }
-    );
+
+        for (const SpriteSortEntry& entry : gSpriteSortEntries) {
+            const uint32_t digit = (entry.key >> shift) & 0xFFu;
+            gSpriteSortTmpEntries[digitOffsets[digit]++] = entry;
+        }
+
+        gSpriteSortEntries.swap(gSpriteSortTmpEntries);
+    }
+
+    // Sprites can only be drawn front to back if none of them need to be blended with what is behind
+    gbDrawSpritesFrontToBack = Config::gbFrontToBackSprites;
+
+    for (const DrawSprite& sprite : gDrawSprites) {
+        if (sprite.bTransparent) {
+            gbDrawSpritesFrontToBack = false;
+            break;
+        }
+    }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -296,108 +387,201 @@ enum class SpriteFlipMode {
 };
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Clips the given sprite column against the given set of occluding columns.
+// Does the full test to see if the given line is in front of the sprite, for when the line depths alone can't tell.
+// The result is cached for the line until the next sprite is drawn.
+//
+// Note: the result of the 'in front' test for each line is cached in the draw band rather than on the line itself,
+// since the same line may be tested against a different sprite by another band's thread at the same time.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool isLineInFrontOfSprite(const DrawSprite& sprite, const line_t& line, DrawBand& band) noexcept {
+    const uint32_t lineIdx = (uint32_t)(&line - gpLines);
+    BLIT_ASSERT(lineIdx < band.lineSpriteValidCounts.size());
+
+    uint8_t& bIsInFrontOfSprite = band.lineIsInFrontOfSprite[lineIdx];
+
+    if (band.lineSpriteValidCounts[lineIdx] != band.spriteValidCount) {
+        // Okay, this is where we do the magic cross product check to see if the sprite is in 'front' of the line.
+        // This is the same method as the 'SegBehindPoint' function in the original 3DO Doom code:
+        float spriteRx, spriteRy, lineDx, lineDy;
+
+        if (line.drawnSideIndex == 0) {
+            spriteRx = sprite.worldX - line.v1f.x;
+            spriteRy = sprite.worldY - line.v1f.y;
+            lineDx = line.v2f.x - line.v1f.x;
+            lineDy = line.v2f.y - line.v1f.y;
+        } else {
+            spriteRx = sprite.worldX - line.v2f.x;
+            spriteRy = sprite.worldY - line.v2f.y;
+            lineDx = line.v1f.x - line.v2f.x;
+            lineDy = line.v1f.y - line.v2f.y;
+        }
+
+        const float a = spriteRx * lineDy;
+        const float b = spriteRy * lineDx;
+        bIsInFrontOfSprite = (a < b);
+
+        // Don't run this calculation again for this sprite
+        band.lineSpriteValidCounts[lineIdx] = band.spriteValidCount;
+    }
+
+    return bIsInFrontOfSprite;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tests the sprite depth against the min and max line depths for each occluding column in the block.
+// Returns bit masks (one bit per entry) for lines which are definitely in front of and definitely behind the sprite:
+//
+//  (1) If the sprite is deeper than the max line depth then it must be clipped by the line.
+//      This handles cases where the sprite is past a corner but technically in 'front' of the line.
+//  (2) If the sprite is closer than the min line depth then it must be in front of the line.
+//      This handles cases where the sprite is in front of the line but technically 'behind' it.
+//
+// These tests take precedence over the cross-product test determining whether the sprite is in front of the line, which is only
+// needed for entries in neither mask. These extra checks help produce clipping that works in a similar way to software rendered Doom,
+// with all of the same artifacts and corner cases too... Generally it works better than just a standard Z test since it avoids lots
+// of problems with sprites poking into walls. It still has issues in some places however with parallel lines that are subdivided,
+// often a sprite will be seen to be clipped at the subdivisions...
+//------------------------------------------------------------------------------------------------------------------------------------------
+static inline void getOccluderBlockDepthMasks(
+    const OccluderBlock& block,
+    const float spriteDepth,
+    uint32_t& lineInFrontMask,
+    uint32_t& lineBehindMask
+) noexcept {
+    static_assert(OccluderBlock::NUM_ENTRIES == 4);
+
+    #if SIMD_SSE2
+        const __m128 depth = _mm_set1_ps(spriteDepth);
+        const __m128 inFront = _mm_cmpgt_ps(depth, _mm_load_ps(block.lineMaxDepths));
+        const __m128 behind = _mm_cmplt_ps(depth, _mm_load_ps(block.lineMinDepths));
+        lineInFrontMask = (uint32_t) _mm_movemask_ps(inFront);
+        lineBehindMask = (uint32_t) _mm_movemask_ps(behind);
+    #elif SIMD_NEON
+        // Note: no movemask on NEON, so give each lane its own bit and add the lanes together (works on 32-bit ARM also)
+        const uint32x4_t bitValues = { 1, 2, 4, 8 };
+        const float32x4_t depth = vdupq_n_f32(spriteDepth);
+        const uint32x4_t inFront = vandq_u32(vcgtq_f32(depth, vld1q_f32(block.lineMaxDepths)), bitValues);
+        const uint32x4_t behind = vandq_u32(vcltq_f32(depth, vld1q_f32(block.lineMinDepths)), bitValues);
+        const uint32x2_t inFrontSums = vpadd_u32(vget_low_u32(inFront), vget_high_u32(inFront));
+        const uint32x2_t behindSums = vpadd_u32(vget_low_u32(behind), vget_high_u32(behind));
+        lineInFrontMask = vget_lane_u32(vpadd_u32(inFrontSums, inFrontSums), 0);
+        lineBehindMask = vget_lane_u32(vpadd_u32(behindSums, behindSums), 0);
+    #else
+        lineInFrontMask = 0;
+        lineBehindMask = 0;
+
+        for (uint32_t i = 0; i < OccluderBlock::NUM_ENTRIES; ++i) {
+            lineInFrontMask |= (spriteDepth > block.lineMaxDepths[i]) ? (1u << i) : 0u;
+            lineBehindMask |= (spriteDepth < block.lineMinDepths[i]) ? (1u << i) : 0u;
+        }
+    #endif
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Clips a column of the given sprite against the given set of occluding columns.
 // Modifies the given top and bottom y clip bounds.
+//
+// Since each occluding column only narrows the bounds of the one before it, the clip bounds are just the bounds of the last occluding
+// column which is in front of the sprite. Hence the occluding columns are searched from last to first, stopping at the first match.
 //------------------------------------------------------------------------------------------------------------------------------------------
-static void clipSpriteFragmentAgainstOccludingCols(
-    const SpriteFragment& frag,
+static void clipSpriteColumnAgainstOccludingCols(
+    const DrawSprite& sprite,
     const OccludingColumns& cols,
+    DrawBand& band,
     int16_t& yClipT,
     int16_t& yClipB
 ) noexcept {
-    const uint32_t validCount = gValidCount;
-    const uint32_t numCols = cols.count;
-    BLIT_ASSERT(numCols <= OccludingColumns::MAX_ENTRIES);
-    
-    for (uint32_t i = 0; i < numCols; ++i) {
-        // Grab the line associated with this column and see if we did an 'in front' test against this column
-        line_t& line = *cols.pLines[i];
-
-        if (line.validCount != validCount) {
-            // Get the min and max depths of the line. These are used for tests that take precedence over
-            // the cross-product test determining whether the sprite is in front of the line:
-            //
-            //  (1) If the sprite is deeper than the max line depth then it must be clipped by the line.
-            //      This handles cases where the sprite is past a corner but technically in 'front' of the line.
-            //  (2) If the sprite is closer than the min line depth then it must be in front of the line.
-            //      This handles cases where the sprite is in front of the line but technically 'behind' it.
-            //
-            // These extra checks help produce clipping that works in a similar way to software rendered Doom,
-            // with all of the same artifacts and corner cases too... Generally it works better than just a
-            // standard Z test since it avoids lots of problems with sprites poking into walls. It still has
-            // issues in some places however with parallel lines that are subdivided, often a sprite will be
-            // seen to be clipped at the subdivisions...
-            //
-            const float lineMinDepth = std::min(line.v1DrawDepth, line.v2DrawDepth);
-            const float lineMaxDepth = std::max(line.v1DrawDepth, line.v2DrawDepth);
-
-            if (frag.depth > lineMaxDepth) {
-                line.bIsInFrontOfSprite = true;
-            } 
-            else if (frag.depth < lineMinDepth) {
-                line.bIsInFrontOfSprite = false;
-            }
-            else {
-                // Okay, this is where we do the magic cross product check to see if the sprite is in 'front' of the line.
-                // This is the same method as the 'SegBehindPoint' function in the original 3DO Doom code:
-                float spriteRx, spriteRy, lineDx, lineDy;
-
-                if (line.drawnSideIndex == 0) {
-                    spriteRx = frag.spriteWorldX - line.v1f.x;
-                    spriteRy = frag.spriteWorldY - line.v1f.y;
-                    lineDx = line.v2f.x - line.v1f.x;
-                    lineDy = line.v2f.y - line.v1f.y;
-                } else {
-                    spriteRx = frag.spriteWorldX - line.v2f.x;
-                    spriteRy = frag.spriteWorldY - line.v2f.y;
-                    lineDx = line.v1f.x - line.v2f.x;
-                    lineDy = line.v1f.y - line.v2f.y;
-                }
+    uint32_t blockIdx = cols.lastBlockIdx;
 
-                const float a = spriteRx * lineDy;
-                const float b = spriteRy * lineDx;
-                line.bIsInFrontOfSprite = (a < b);
-            }
+    while (blockIdx != OccluderBlock::INVALID_IDX) {
+        const OccluderBlock& block = gOccluderBlocks[blockIdx];
+        BLIT_ASSERT((block.count > 0) && (block.count <= OccluderBlock::NUM_ENTRIES));
 
-            // Don't run this calculation again for this sprite
-            line.validCount = validCount;
+        uint32_t lineInFrontMask;
+        uint32_t lineBehindMask;
+        getOccluderBlockDepthMasks(block, sprite.depth, lineInFrontMask, lineBehindMask);
+
+        for (uint32_t i = block.count; i-- > 0;) {
+            // Does this line occlude the sprite?
+            const uint32_t entryBit = 1u << i;
+
+            if (lineBehindMask & entryBit)
+                continue;
+
+            if (((lineInFrontMask & entryBit) == 0) && (!isLineInFrontOfSprite(sprite, *block.pLines[i], band)))
+                continue;
+
+            // This line occludes the sprite: update the clip bounds
+            const OccluderBlock::Bounds bounds = block.bounds[i];
+            yClipT = std::max(yClipT, bounds.top);
+            yClipB = std::min(yClipB, bounds.bottom);
+            return;
         }
 
-        // Ignore this line if it is not in front of the sprite
-        if (!line.bIsInFrontOfSprite)
-            continue;
-        
-        // This line occludes the sprite: update the clip bounds
-        const OccludingColumns::Bounds bounds = cols.bounds[i];
-        yClipT = std::max(yClipT, bounds.top);
-        yClipB = std::min(yClipB, bounds.bottom);
+        blockIdx = block.prevBlockIdx;
     }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Clips and draws a single sprite fragment
+// Get the sprite coverage bits for the given screen column in the band, when drawing sprites front to back
 //------------------------------------------------------------------------------------------------------------------------------------------
-static void clipAndDrawSpriteFragment(const SpriteFragment& frag) noexcept {
-    BLIT_ASSERT(frag.x < g3dViewWidth);
+static inline uint32_t* getSpriteCoverageCol(DrawBand& band, const uint32_t x) noexcept {
+    BLIT_ASSERT(x >= band.beginX && x < band.endX);
+    return band.spriteCoverage.data() + (uintptr_t)(x - band.beginX) * band.spriteCoverageColWords;
+}
 
-    // Firstly figure out the top and bottom clip bounds for the sprite fragment
-    int16_t yClipT = -1;
-    int16_t yClipB = (int16_t) g3dViewHeight;
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if all pixels in the given screen column range have already been covered by nearer sprites, when drawing front to back
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool isSpriteColumnCovered(DrawBand& band, const uint32_t x, const uint32_t y, const uint32_t height) noexcept {
+    const uint32_t* const pCoverage = getSpriteCoverageCol(band, x);
+    const uint32_t endY = y + height;
+    uint32_t curY = y;
 
-    {
-        const OccludingColumns& occludingCols = gOccludingCols[frag.x];
-        clipSpriteFragmentAgainstOccludingCols(frag, occludingCols, yClipT, yClipB);
+    while (curY < endY) {
+        const uint32_t bitIdx = curY & 31;
+        const uint32_t numBits = std::min(32 - bitIdx, endY - curY);
+        const uint32_t mask = (numBits >= 32) ? UINT32_MAX : ((1u << numBits) - 1u) << bitIdx;
+
+        if ((pCoverage[curY >> 5] & mask) != mask)
+            return false;
+
+        curY += numBits;
     }
 
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Clips the given column of a sprite against the occluding columns and adds it to the band's list of sprite columns to draw,
+// if anything of it remains. The clipping works exactly the same way as 'Blit::blitColumn' does when clipping the top of a column.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void addSpriteColumn(
+    const DrawSprite& sprite,
+    const uint32_t x,
+    const uint32_t texX,
+    const int16_t spriteY,
+    const uint16_t spriteH,
+    const float texYStep,
+    const float texYSubPixelAdjust,
+    DrawBand& band
+) noexcept {
+    BLIT_ASSERT(x >= band.beginX && x < band.endX);
+
+    // Firstly figure out the top and bottom clip bounds for the sprite column
+    int16_t yClipT = -1;
+    int16_t yClipB = (int16_t) g3dViewHeight;
+    clipSpriteColumnAgainstOccludingCols(sprite, gOccludingCols[x], band, yClipT, yClipB);
+
     // If we are drawing nothing then bail
     if (yClipT >= yClipB)
         return;
-    
+
     // Do clipping against the top of the bounds
     float srcTexY = 0.0f;
-    float srcTexYSubPixelAdjust = frag.texYSubPixelAdjust;
-    int32_t dstY = frag.y;
-    uint32_t dstCount = frag.height;
+    float srcTexYSubPixelAdjust = texYSubPixelAdjust;
+    int32_t dstY = spriteY;
+    uint32_t dstCount = spriteH;
 
     if (dstY <= yClipT) {
         const uint32_t numPixelsOffscreen = (uint32_t)(yClipT - dstY + 1);
@@ -405,7 +589,7 @@ static void clipAndDrawSpriteFragment(const SpriteFragment& frag) noexcept {
         if (numPixelsOffscreen >= dstCount)
             return;
 
-        srcTexY = frag.texYStep * (float) numPixelsOffscreen + srcTexYSubPixelAdjust;
+        srcTexY = texYStep * (float) numPixelsOffscreen + srcTexYSubPixelAdjust;
         srcTexYSubPixelAdjust = 0.0f;
         dstY += numPixelsOffscreen;
         dstCount -= numPixelsOffscreen;
@@ -425,74 +609,221 @@ static void clipAndDrawSpriteFragment(const SpriteFragment& frag) noexcept {
         }
     }
 
-    // Draw the actual sprite column
-    if (!frag.isTransparent) {
-        Blit::blitColumn<
-            Blit::BCF_STEP_Y |
-            Blit::BCF_ALPHA_TEST |
-            Blit::BCF_COLOR_MULT_RGB |
-            Blit::BCF_V_WRAP_DISCARD |
-            Blit::BCF_V_CLIP
-        >(
-            frag.pSpriteColPixels,
-            1,
-            frag.texH,
-            0.0f,
-            srcTexY,
-            0.0f,
-            srcTexYSubPixelAdjust,
-            Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * Video::gScreenWidth + g3dViewXOffset,
-            g3dViewWidth,
-            g3dViewHeight,
-            Video::gScreenWidth,
-            frag.x,
-            dstY,
-            dstCount,
-            0.0f,
-            frag.texYStep,
-            frag.lightMul,
-            frag.lightMul,
-            frag.lightMul
-        );
+    // Note: the occluding column bounds are always within the 3D view, so no further clipping against the view is needed
+    BLIT_ASSERT((dstY >= 0) && (dstY + dstCount <= g3dViewHeight));
+
+    // When drawing front to back, skip the column if nearer sprites have already covered all of it
+    if (gbDrawSpritesFrontToBack && isSpriteColumnCovered(band, x, (uint32_t) dstY, dstCount))
+        return;
+
+    SpriteColumn& col = band.spriteColumns.emplace_back();
+    col.x = (uint16_t) x;
+    col.y = (uint16_t) dstY;
+    col.height = (uint16_t) dstCount;
+    col.texY = srcTexY;
+    col.texYSubPixelAdjust = srcTexYSubPixelAdjust;
+    col.pPixels = sprite.pPixels + (uintptr_t) texX * sprite.texH;
+    col.pPixels32 = (sprite.pPixels32) ? sprite.pPixels32 + (uintptr_t) texX * sprite.texH : nullptr;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Works out which row of the sprite texture to use for each screen row of a run of sprite columns, or 'UINT32_MAX' if nothing should
+// be drawn for the screen row. This is exactly the same stepping and vertical 'discard' texture wrapping done by 'Blit::blitColumn'.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void getSpriteRowTexYs(
+    const SpriteColumn& col,
+    const uint32_t texH,
+    const float texYStep,
+    ArenaVector<uint32_t>& rowTexYs
+) noexcept {
+    rowTexYs.resize(col.height);
+
+    uint32_t curTexYInt = (uint32_t) col.texY;                  // Note: unsigned allows us to test < 0 at the same time as >= texture height!
+    float nextTexY = col.texY + col.texYSubPixelAdjust;         // Note: the adjustment is applied AFTER the first pixel
+    bool bDidWrapDiscardClamp = false;
+
+    for (uint32_t rowIdx = 0; rowIdx < col.height; ++rowIdx) {
+        uint32_t rowTexY = curTexYInt;
+
+        // Note that we allow ONE out of bounds coordinate provided that it has an integer texture coordinate DIFFERENT to the last.
+        // This ensures that we always show the last row of the texture for borders.
+        if (curTexYInt >= texH) {
+            if (bDidWrapDiscardClamp) {
+                rowTexY = UINT32_MAX;
+            } else {
+                curTexYInt = Blit::wrapYCoord<Blit::BCF_V_WRAP_CLAMP>((int32_t) curTexYInt, texH);
+                bDidWrapDiscardClamp = true;
+                const uint32_t prevTexYInt = (uint32_t)(nextTexY - texYStep);
+                rowTexY = (prevTexYInt == curTexYInt) ? UINT32_MAX : curTexYInt;
+            }
+        }
+
+        rowTexYs[rowIdx] = rowTexY;
+        nextTexY += texYStep;
+        curTexYInt = (uint32_t) nextTexY;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Alpha tests, shades and optionally blends one sprite pixel into the framebuffer.
+// Gives exactly the same result as 'Blit::blitColumn' does for sprites. Returns 'false' if the pixel was not drawn due to the alpha test.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <bool TRANSPARENT, class SrcPixelT>
+static inline bool drawSpritePixel(const SrcPixelT srcPixel, uint32_t& dstPixel, const float colorMul) noexcept {
+    // Alpha test first, to skip all the other work for see through pixels
+    uint8_t texA;
+    uint8_t texR;
+    uint8_t texG;
+    uint8_t texB;
+
+    if constexpr (std::is_same_v<SrcPixelT, uint16_t>) {
+        texA = (uint8_t)((srcPixel & uint16_t(0b1000000000000000)) >> 15);
     } else {
-        Blit::blitColumn<
-            Blit::BCF_STEP_Y |
-            Blit::BCF_ALPHA_TEST |
-            Blit::BCF_ALPHA_BLEND |
-            Blit::BCF_COLOR_MULT_RGB |
-            Blit::BCF_COLOR_MULT_A |
-            Blit::BCF_V_WRAP_DISCARD |
-            Blit::BCF_V_CLIP
-        >(
-            frag.pSpriteColPixels,
-            1,
-            frag.texH,
-            0.0f,
-            srcTexY,
-            0.0f,
-            srcTexYSubPixelAdjust,
-            Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * Video::gScreenWidth + g3dViewXOffset,
-            g3dViewWidth,
-            g3dViewHeight,
-            Video::gScreenWidth,
-            frag.x,
-            dstY,
-            dstCount,
-            0.0f,
-            frag.texYStep,
-            frag.lightMul * MF_SHADOW_COLOR_MULT,
-            frag.lightMul * MF_SHADOW_COLOR_MULT,
-            frag.lightMul * MF_SHADOW_COLOR_MULT,
-            MF_SHADOW_ALPHA
-        );
+        texA = (uint8_t)(srcPixel >> 24);
+    }
+
+    if (texA <= 0)
+        return false;
+
+    if constexpr (std::is_same_v<SrcPixelT, uint16_t>) {
+        texR = (uint8_t)((srcPixel & uint16_t(0b0111110000000000)) >> 7);
+        texG = (uint8_t)((srcPixel & uint16_t(0b0000001111100000)) >> 2);
+        texB = (uint8_t)((srcPixel & uint16_t(0b0000000000011111)) << 3);
+    } else {
+        texR = (uint8_t)((srcPixel & 0x00FF0000u) >> 16);
+        texG = (uint8_t)((srcPixel & 0x0000FF00u) >> 8);
+        texB = (uint8_t)(srcPixel & 0x000000FFu);
+    }
+
+    float r = std::min((float) texR * colorMul, 255.0f);
+    float g = std::min((float) texG * colorMul, 255.0f);
+    float b = std::min((float) texB * colorMul, 255.0f);
+
+    if constexpr (TRANSPARENT) {
+        // N.B - in the case of ARGB1555 alpha is already in a 0-1 range, so just a cast is needed!
+        float a;
+
+        if constexpr (std::is_same_v<SrcPixelT, uint16_t>) {
+            a = (float) texA;
+        } else {
+            a = (float) texA / 255.0f;
+        }
+
+        a = std::min(a * MF_SHADOW_ALPHA, 1.0f);
+
+        const float dstR = (float)((uint8_t)(dstPixel >> 16));
+        const float dstG = (float)((uint8_t)(dstPixel >> 8));
+        const float dstB = (float)((uint8_t)(dstPixel));
+        const float srcFactor = a;
+        const float dstFactor = 1.0f - a;
+
+        r = r * srcFactor + dstR * dstFactor;
+        g = g * srcFactor + dstG * dstFactor;
+        b = b * srcFactor + dstB * dstFactor;
+    }
+
+    dstPixel = (
+        (uint32_t(r) << 16) |
+        (uint32_t(g) << 8) |
+        (uint32_t(b))
+    );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draws a run of adjacent sprite columns which all have the same screen y range after clipping.
+// Since the texture rows to use are the same for every column in the run, they are worked out once and the run is then drawn row by
+// row, which is much friendlier to the cache than drawing it column by column.
+// When drawing front to back, pixels already covered by nearer sprites are skipped and the pixels drawn are marked as covered.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <bool TRANSPARENT, bool FRONT_TO_BACK, class SrcPixelT>
+static void drawSpriteColumnRun(
+    const SpriteColumn* const pCols,
+    const uint32_t numCols,
+    const DrawSprite& sprite,
+    const float texYStep,
+    DrawBand& band
+) noexcept {
+    BLIT_ASSERT(numCols > 0);
+
+    const SpriteColumn& firstCol = pCols[0];
+    getSpriteRowTexYs(firstCol, sprite.texH, texYStep, band.spriteRowTexYs);
+
+    const float colorMul = (TRANSPARENT) ? sprite.lightMul * MF_SHADOW_COLOR_MULT : sprite.lightMul;
+    const uint32_t dstPitch = gViewPixelsPitch;
+    uint32_t* pDstRow = gpViewPixels + (uintptr_t) firstCol.y * dstPitch + firstCol.x;
+
+    for (uint32_t rowIdx = 0; rowIdx < firstCol.height; ++rowIdx, pDstRow += dstPitch) {
+        const uint32_t texY = band.spriteRowTexYs[rowIdx];
+
+        if (texY == UINT32_MAX)
+            continue;
+
+        if constexpr (FRONT_TO_BACK) {
+            const uint32_t y = firstCol.y + rowIdx;
+            const uint32_t coverageWordIdx = y >> 5;
+            const uint32_t coverageBit = 1u << (y & 31);
+            uint32_t* pCoverage = getSpriteCoverageCol(band, firstCol.x) + coverageWordIdx;
+
+            for (uint32_t colIdx = 0; colIdx < numCols; ++colIdx, pCoverage += band.spriteCoverageColWords) {
+                if (*pCoverage & coverageBit)
+                    continue;
+
+                const SrcPixelT* const pColPixels = pCols[colIdx].getPixels<SrcPixelT>();
+
+                if (drawSpritePixel<TRANSPARENT>(pColPixels[texY], pDstRow[colIdx], colorMul)) {
+                    *pCoverage |= coverageBit;
+                }
+            }
+        } else {
+            for (uint32_t colIdx = 0; colIdx < numCols; ++colIdx) {
+                const SrcPixelT* const pColPixels = pCols[colIdx].getPixels<SrcPixelT>();
+                drawSpritePixel<TRANSPARENT>(pColPixels[texY], pDstRow[colIdx], colorMul);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draws all of the clipped sprite columns in the band's list of sprite columns for the given sprite.
+// Splits the columns up into runs of adjacent columns with the same screen y range, which are drawn together.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <bool TRANSPARENT, bool FRONT_TO_BACK, class SrcPixelT>
+static void drawSpriteColumns(const DrawSprite& sprite, const float texYStep, DrawBand& band) noexcept {
+    const SpriteColumn* const pCols = band.spriteColumns.data();
+    const uint32_t numCols = (uint32_t) band.spriteColumns.size();
+    uint32_t runStartIdx = 0;
+
+    while (runStartIdx < numCols) {
+        const SpriteColumn& runStartCol = pCols[runStartIdx];
+        uint32_t runEndIdx = runStartIdx + 1;
+
+        while (runEndIdx < numCols) {
+            const SpriteColumn& col = pCols[runEndIdx];
+            const bool bContinuesRun = (
+                (col.x == runStartCol.x + (runEndIdx - runStartIdx)) &&
+                (col.y == runStartCol.y) &&
+                (col.height == runStartCol.height)
+            );
+
+            if (!bContinuesRun)
+                break;
+
+            ++runEndIdx;
+        }
+
+        drawSpriteColumnRun<TRANSPARENT, FRONT_TO_BACK, SrcPixelT>(pCols + runStartIdx, runEndIdx - runStartIdx, sprite, texYStep, band);
+        runStartIdx = runEndIdx;
     }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Emit the sprite fragments for one draw sprite
+// Draw one draw sprite, for the columns within the given draw band only.
+// All of the sprite's columns are clipped first and then the visible parts are drawn in runs of columns.
 //------------------------------------------------------------------------------------------------------------------------------------------
 template <SpriteFlipMode FLIP_MODE>
-static void drawSprite(const DrawSprite& sprite) noexcept {
+static void drawSprite(const DrawSprite& sprite, DrawBand& band) noexcept {
     BLIT_ASSERT(sprite.screenRx >= sprite.screenLx);
     BLIT_ASSERT(sprite.screenBy >= sprite.screenTy);
 
@@ -555,50 +886,55 @@ static void drawSprite(const DrawSprite& sprite) noexcept {
         endScreenX = spriteRxInt + 1;
     }
 
-    // Increment this marker for clipping checks
-    ++gValidCount;
+    // Figure out the starting texture coordinate
+    float texXf;
 
-    // Emit the columns
-    {
-        float texXf;
+    if constexpr (FLIP_MODE == SpriteFlipMode::FLIPPED) {
+        texXf = std::nextafterf(texW, 0.0f);
+    } else {
+        texXf = 0.0f;
+    }
+
+    // Skip past any columns which are before the start of the draw band.
+    // Compute the texture coordinate the same way the column loop below would, so the result is identical to drawing the whole sprite.
+    if (curScreenX < (int32_t) band.beginX) {
+        curColNum += (uint32_t)((int32_t) band.beginX - curScreenX);
+        curScreenX = (int32_t) band.beginX;
 
         if constexpr (FLIP_MODE == SpriteFlipMode::FLIPPED) {
-            texXf = std::nextafterf(texW, 0.0f);
+            texXf = texW - std::max(texXStep * (float) curColNum + texSubPixelXAdjust, 0.5f);
         } else {
-            texXf = 0.0f;
+            texXf = std::max(texXStep * (float) curColNum + texSubPixelXAdjust, 0.0f);
         }
+    }
 
-        while (curScreenX < endScreenX) {
-            BLIT_ASSERT(curScreenX >= 0 && curScreenX < (int32_t) g3dViewWidth);
-            const uint16_t texX = (uint16_t) texXf;
+    // Don't go past the end of the draw band either
+    endScreenX = std::min(endScreenX, (int32_t) band.endX);
 
-            if (texX >= texW)
-                break;
+    // Increment this marker for clipping checks
+    ++band.spriteValidCount;
 
-            SpriteFragment frag;
-            frag.x = (uint16_t) curScreenX;
-            frag.y = (int16_t) spriteTyInt;
-            frag.height = (uint16_t) spriteHInt;
-            frag.texH = (uint16_t) texHInt;
-            frag.isTransparent = (sprite.bTransparent) ? 1 : 0;
-            frag.depth = sprite.depth;
-            frag.lightMul = sprite.lightMul;
-            frag.texYStep = texYStep;
-            frag.texYSubPixelAdjust = texSubPixelYAdjust;
-            frag.pSpriteColPixels = sprite.pPixels + (uintptr_t) texX * texHInt;
-            frag.spriteWorldX = sprite.worldX;
-            frag.spriteWorldY = sprite.worldY;
-
-            clipAndDrawSpriteFragment(frag);
-
-            ++curScreenX;
-            ++curColNum;
-
-            if constexpr (FLIP_MODE == SpriteFlipMode::FLIPPED) {
-                texXf = texW - std::max(texXStep * (float) curColNum + texSubPixelXAdjust, 0.5f);
-            } else {
-                texXf = std::max(texXStep * (float) curColNum + texSubPixelXAdjust, 0.0f);
-            }
+    // Clip all of the columns for the sprite in one go first
+    const int16_t colY = (int16_t) spriteTyInt;
+    const uint16_t colH = (uint16_t) spriteHInt;
+    band.spriteColumns.clear();
+
+    while (curScreenX < endScreenX) {
+        BLIT_ASSERT(curScreenX >= 0 && curScreenX < (int32_t) g3dViewWidth);
+        const uint16_t texX = (uint16_t) texXf;
+
+        if (texX >= texW)
+            break;
+
+        addSpriteColumn(sprite, (uint32_t) curScreenX, texX, colY, colH, texYStep, texSubPixelYAdjust, band);
+
+        ++curScreenX;
+        ++curColNum;
+
+        if constexpr (FLIP_MODE == SpriteFlipMode::FLIPPED) {
+            texXf = texW - std::max(texXStep * (float) curColNum + texSubPixelXAdjust, 0.5f);
+        } else {
+            texXf = std::max(texXStep * (float) curColNum + texSubPixelXAdjust, 0.0f);
         }
     }
 
@@ -606,39 +942,84 @@ static void drawSprite(const DrawSprite& sprite) noexcept {
     if (bDoExtraCol) {
         curScreenX = spriteRxInt + 1;
 
-        if (curScreenX < (int32_t) g3dViewWidth) {
+        if ((curScreenX >= (int32_t) band.beginX) && (curScreenX < (int32_t) band.endX)) {
             const uint16_t texX = (FLIP_MODE == SpriteFlipMode::FLIPPED) ? 0 : texWInt - 1;
+            addSpriteColumn(sprite, (uint32_t) curScreenX, texX, colY, colH, texYStep, texSubPixelYAdjust, band);
+        }
+    }
 
-            SpriteFragment frag;
-            frag.x = (uint16_t) curScreenX;
-            frag.y = (int16_t) spriteTyInt;
-            frag.height = (uint16_t) spriteHInt;
-            frag.texH = (uint16_t) texHInt;
-            frag.isTransparent = (sprite.bTransparent) ? 1 : 0;
-            frag.depth = sprite.depth;
-            frag.lightMul = sprite.lightMul;
-            frag.texYStep = texYStep;
-            frag.texYSubPixelAdjust = texSubPixelYAdjust;
-            frag.pSpriteColPixels = sprite.pPixels + (uintptr_t) texX * texHInt;
-            frag.spriteWorldX = sprite.worldX;
-            frag.spriteWorldY = sprite.worldY;
-
-            clipAndDrawSpriteFragment(frag);
+    // Draw whatever is left of the sprite, using the pre-expanded 32-bit version of the sprite if available.
+    // Note: sprites are never drawn front to back if any are transparent.
+    if (sprite.pPixels32) {
+        if (sprite.bTransparent) {
+            drawSpriteColumns<true, false, uint32_t>(sprite, texYStep, band);
+        } else if (gbDrawSpritesFrontToBack) {
+            drawSpriteColumns<false, true, uint32_t>(sprite, texYStep, band);
+        } else {
+            drawSpriteColumns<false, false, uint32_t>(sprite, texYStep, band);
+        }
+    } else {
+        if (sprite.bTransparent) {
+            drawSpriteColumns<true, false, uint16_t>(sprite, texYStep, band);
+        } else if (gbDrawSpritesFrontToBack) {
+            drawSpriteColumns<false, true, uint16_t>(sprite, texYStep, band);
+        } else {
+            drawSpriteColumns<false, false, uint16_t>(sprite, texYStep, band);
         }
     }
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Draw all the sprites in the 3D view from back to front
+// Draw one sprite within the given draw band, if it overlaps the band
 //------------------------------------------------------------------------------------------------------------------------------------------
-void drawAllSprites() noexcept {
-    sortAllSprites();
+static void drawSpriteInBand(const DrawSprite& sprite, DrawBand& band) noexcept {
+    // Skip the sprite entirely if it does not overlap the band
+    if ((sprite.screenLx >= (float) band.endX) || (sprite.screenRx + 2.0f < (float) band.beginX))
+        return;
 
-    for (const DrawSprite& sprite : gDrawSprites) {
-        if (sprite.bFlip) {
-            drawSprite<SpriteFlipMode::FLIPPED>(sprite);
-        } else {
-            drawSprite<SpriteFlipMode::NOT_FLIPPED>(sprite);
+    if (sprite.bFlip) {
+        drawSprite<SpriteFlipMode::FLIPPED>(sprite, band);
+    } else {
+        drawSprite<SpriteFlipMode::NOT_FLIPPED>(sprite, band);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draw all the sprites in the given draw band from back to front, or front to back if that was decided when sorting.
+// Expects the sprites to have already been sorted via 'sortAllSprites'.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void drawAllSprites(DrawBand& band) noexcept {
+    PROFILE_ZONE("Sprites");
+
+    // Ensure the line sprite clip caches for the band are the right size for the map
+    if (band.lineSpriteValidCounts.size() != gNumLines) {
+        band.lineSpriteValidCounts.assign(gNumLines, 0);
+        band.lineIsInFrontOfSprite.assign(gNumLines, 0);
+        band.spriteValidCount = 0;
+    }
+
+    // Free the band's scratch memory from the previous frame and make room up front for the most that could be needed by any one sprite
+    band.scratchArena.reset();
+    releaseArenaVector(band.spriteColumns, band.scratchArena);
+    releaseArenaVector(band.spriteRowTexYs, band.scratchArena);
+    releaseArenaVector(band.spriteCoverage, band.scratchArena);
+    band.spriteColumns.reserve(band.endX - band.beginX);
+    band.spriteRowTexYs.reserve(g3dViewHeight);
+
+    const SpriteSortEntry* const pSortEntries = gSpriteSortEntries.data();
+    const uint32_t numSprites = (uint32_t) gSpriteSortEntries.size();
+
+    if (gbDrawSpritesFrontToBack) {
+        // Nothing is covered by sprites to begin with
+        band.spriteCoverageColWords = (g3dViewHeight + 31) / 32;
+        band.spriteCoverage.assign((size_t)(band.endX - band.beginX) * band.spriteCoverageColWords, 0);
+
+        for (uint32_t i = numSprites; i > 0; --i) {
+            drawSpriteInBand(gDrawSprites[pSortEntries[i - 1].spriteIdx], band);
+        }
+    } else {
+        for (uint32_t i = 0; i < numSprites; ++i) {
+            drawSpriteInBand(gDrawSprites[pSortEntries[i].spriteIdx], band);
         }
     }
 }
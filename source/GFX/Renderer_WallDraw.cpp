@@ -1,5 +1,6 @@
 #include "Renderer_Internal.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
 #include "Blit.h"
 #include "Map/Setup.h"
@@ -17,18 +18,80 @@
 BEGIN_NAMESPACE(Renderer)
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Draws a single column of the sky
+// Cache of every column of the sky texture, pre-scaled to the height the sky is drawn at for the current view size and converted to the
+// framebuffer pixel format. This turns drawing each column of the sky into a straight copy.
+// Rebuilt whenever the sky texture or the view height changes.
 //------------------------------------------------------------------------------------------------------------------------------------------
-static void drawSkyColumn(const uint32_t viewX, const uint32_t maxColHeight) noexcept {
-    // Figure out the angle this sky column is at.
-    // From that figure out the texture coordinate: the sky texture is 256 pixels wide and repeats 4 times over a circle.
-    const angle_t angle = gViewAngleBAM + gScreenXToAngleBAM[viewX];
-    const uint32_t texX = (angle >> 22) & 0xFFu;
+struct SkyColumnCache {
+    const ImageData*        pTexImage;      // The sky texture the cache was built for
+    const void*             pTexPixels;     // The pixels of the sky texture the cache was built from
+    uint32_t                viewHeight;     // The 3D view height the cache was built for
+    uint32_t                numCols;        // Number of columns in the cache (the sky texture width)
+    uint32_t                colHeight;      // Height of each column in the cache
+    std::vector<uint32_t>   pixels;         // The pixels for each column, column after column
+};
 
-    // Figure out the sky column height and texel step (y)
+static SkyColumnCache gSkyColumnCache;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Blits a single column of the sky texture using the given sky texture pixels (ARGB1555 or the pre-expanded ARGB8888 pixels).
+// The column is blitted to the given destination, which can be the framebuffer or the sky column cache.
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SrcPixelT>
+static inline void blitSkyColumn(
+    const SrcPixelT* const pSrcPixels,
+    const ImageData& texImg,
+    const uint32_t texX,
+    const float texYStep,
+    uint32_t* const pDstPixels,
+    const uint32_t dstW,
+    const uint32_t dstH,
+    const uint32_t dstPitch,
+    const uint32_t dstX,
+    const uint32_t colHeight
+) noexcept {
+    Blit::blitColumn<
+        Blit::BCF_STEP_Y
+    >(
+        pSrcPixels,
+        texImg.width,
+        texImg.height,
+        (float) texX,
+        0.0f,
+        0.0f,
+        0.0f,
+        pDstPixels,
+        dstW,
+        dstH,
+        dstPitch,
+        (int32_t) dstX,
+        0,
+        colHeight,
+        0,
+        texYStep
+    );
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Rebuilds the sky column cache if the sky texture or the 3D view height has changed since it was last built.
+// Must be called before drawing starts, since the draw bands read the cache from multiple threads.
+//------------------------------------------------------------------------------------------------------------------------------------------
+void updateSkyColumnCache() noexcept {
     const Texture* const pTex = (const Texture*) Textures::getWall(gSkyTextureNum);
     const ImageData& texImg = pTex->data;
+    const void* const pTexPixels = (texImg.pPixels32) ? (const void*) texImg.pPixels32 : (const void*) texImg.pPixels;
+    SkyColumnCache& cache = gSkyColumnCache;
+
+    const bool bIsCacheValid = (
+        (cache.pTexImage == &texImg) &&
+        (cache.pTexPixels == pTexPixels) &&
+        (cache.viewHeight == g3dViewHeight)
+    );
 
+    if (bIsCacheValid)
+        return;
+
+    // Figure out the sky column height and texel step (y)
     const uint32_t skyTexH = texImg.height;
     const Fixed skyScale = fixed16Div(intToFixed16((int32_t) g3dViewHeight), intToFixed16(Renderer::REFERENCE_3D_VIEW_HEIGHT));
     const Fixed scaledColHeight = fixed16Mul(intToFixed16((int32_t) skyTexH), skyScale);
@@ -38,64 +101,113 @@ static void drawSkyColumn(const uint32_t viewX, const uint32_t maxColHeight) noe
 
     const float texYStep = fixed16ToFloat(Blit::calcTexelStep(skyTexH, colHeight));
 
-    // Draw the sky column
+    // Blit every column of the sky texture into the cache, exactly as it would be blitted to the screen
+    cache.pTexImage = &texImg;
+    cache.pTexPixels = pTexPixels;
+    cache.viewHeight = g3dViewHeight;
+    cache.numCols = texImg.width;
+    cache.colHeight = colHeight;
+    cache.pixels.resize((size_t) cache.numCols * colHeight);
+
+    for (uint32_t texX = 0; texX < cache.numCols; ++texX) {
+        uint32_t* const pColPixels = cache.pixels.data() + (uintptr_t) texX * colHeight;
+
+        if (texImg.pPixels32) {
+            blitSkyColumn(texImg.pPixels32, texImg, texX, texYStep, pColPixels, 1, colHeight, 1, 0, colHeight);
+        } else {
+            blitSkyColumn(texImg.pPixels, texImg, texX, texYStep, pColPixels, 1, colHeight, 1, 0, colHeight);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draws a single column of the sky by copying it from the sky column cache
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void drawSkyColumn(const uint32_t viewX, const uint32_t maxColHeight) noexcept {
+    // Figure out the angle this sky column is at.
+    // From that figure out the texture coordinate: the sky texture is 256 pixels wide and repeats 4 times over a circle.
+    const angle_t angle = gViewAngleBAM + gScreenXToAngleBAM[viewX];
+    const uint32_t texX = (angle >> 22) & 0xFFu;
+
+    // Copy the column from the cache to the screen
+    const SkyColumnCache& cache = gSkyColumnCache;
+    BLIT_ASSERT(cache.viewHeight == g3dViewHeight);
+    BLIT_ASSERT(texX < cache.numCols);
+
+    const uint32_t drawColHeight = std::min(cache.colHeight, maxColHeight);
+    const uint32_t dstPitch = gViewPixelsPitch;
+    const uint32_t* pSrc = cache.pixels.data() + (uintptr_t) texX * cache.colHeight;
+    const uint32_t* const pSrcEnd = pSrc + drawColHeight;
+    uint32_t* pDst = gpViewPixels + viewX;
+
+    while (pSrc < pSrcEnd) {
+        *pDst = *pSrc;
+        ++pSrc;
+        pDst += dstPitch;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draws a single wall fragment using the given wall texture pixels (ARGB1555 or the pre-expanded ARGB8888 pixels)
+//------------------------------------------------------------------------------------------------------------------------------------------
+template <class SrcPixelT>
+static inline void drawWallFragment(const WallFragment& wallFrag, const SrcPixelT* const pSrcPixels) noexcept {
+    const ImageData& wallImage = *wallFrag.pImageData;
+
     Blit::blitColumn<
-        Blit::BCF_STEP_Y
+        Blit::BCF_STEP_Y |
+        Blit::BCF_H_WRAP_WRAP |
+        Blit::BCF_V_WRAP_WRAP |
+        Blit::BCF_COLOR_MULT_RGB
     >(
-        texImg.pPixels,
-        texImg.width,
-        texImg.height,
-        (float) texX,
-        0.0f,
+        pSrcPixels,
+        wallImage.width,
+        wallImage.height,
+        (float) wallFrag.texcoordX,
+        wallFrag.texcoordY,
         0.0f,
-        0.0f,
-        Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * Video::gScreenWidth + g3dViewXOffset,
+        wallFrag.texcoordYSubPixelAdjust,
+        gpViewPixels,
         g3dViewWidth,
         g3dViewHeight,
-        Video::gScreenWidth,
-        (int32_t) viewX,
-        0,
-        std::min(colHeight, maxColHeight),
+        gViewPixelsPitch,
+        wallFrag.x,
+        wallFrag.y,
+        wallFrag.height,
         0,
-        texYStep
+        wallFrag.texcoordYStep,
+        wallFrag.lightMul,
+        wallFrag.lightMul,
+        wallFrag.lightMul
     );
 }
 
-void drawAllWallFragments() noexcept {
+void drawAllWallFragments(const DrawBand& band) noexcept {
+    PROFILE_ZONE("Walls");
+
     for (const WallFragment& wallFrag : gWallFragments) {
+        // Skip the fragment if it is not within the columns being drawn
+        if ((wallFrag.x < band.beginX) || (wallFrag.x >= band.endX))
+            continue;
+
+        // Use the pre-expanded 32-bit version of the texture if available
         const ImageData& wallImage = *wallFrag.pImageData;
 
-        Blit::blitColumn<
-            Blit::BCF_STEP_Y |
-            Blit::BCF_H_WRAP_WRAP |
-            Blit::BCF_V_WRAP_WRAP |
-            Blit::BCF_COLOR_MULT_RGB
-        >(
-            wallImage.pPixels,
-            wallImage.width,
-            wallImage.height,
-            (float) wallFrag.texcoordX,
-            wallFrag.texcoordY,
-            0.0f,
-            wallFrag.texcoordYSubPixelAdjust,
-            Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * Video::gScreenWidth + g3dViewXOffset,
-            g3dViewWidth,
-            g3dViewHeight,
-            Video::gScreenWidth,
-            wallFrag.x,
-            wallFrag.y,
-            wallFrag.height,
-            0,
-            wallFrag.texcoordYStep,
-            wallFrag.lightMul,
-            wallFrag.lightMul,
-            wallFrag.lightMul
-        );
+        if (wallImage.pPixels32) {
+            drawWallFragment(wallFrag, wallImage.pPixels32);
+        } else {
+            drawWallFragment(wallFrag, wallImage.pPixels);
+        }
     }
 }
 
-void drawAllSkyFragments() noexcept {
+void drawAllSkyFragments(const DrawBand& band) noexcept {
+    PROFILE_ZONE("Sky");
+
     for (const SkyFragment& skyFrag : gSkyFragments) {
+        if ((skyFrag.x < band.beginX) || (skyFrag.x >= band.endX))
+            continue;
+
         drawSkyColumn(skyFrag.x, skyFrag.height);
     }
 }
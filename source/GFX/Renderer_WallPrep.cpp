@@ -1,7 +1,9 @@
 ﻿#include "Renderer_Internal.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
 #include "Map/MapData.h"
+#include "SIMD.h"
 #include "Textures.h"
 #include "Blit.h"
 
@@ -58,42 +60,11 @@ static void transformPointToViewSpace(float& x, float& y) noexcept {
     y = yRot;
 }
 
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Transforms the XY coordinates for the seg into view space
-//------------------------------------------------------------------------------------------------------------------------------------------
-static void transformSegXYToViewSpace(const seg_t& inSeg, DrawSeg& outSeg) noexcept {    
-    outSeg.p1x = inSeg.v1.x;
-    outSeg.p1y = inSeg.v1.y;
-    outSeg.p2x = inSeg.v2.x;
-    outSeg.p2y = inSeg.v2.y;
-    transformPointToViewSpace(outSeg.p1x, outSeg.p1y);
-    transformPointToViewSpace(outSeg.p2x, outSeg.p2y);
-}
-
 static bool isScreenSpaceSegBackFacing(const DrawSeg& seg) noexcept {
     // Front facing segs are always left to right when drawn, so if it's opposite way then it's a back facing seg!
     return (seg.p1x >= seg.p2x);
 }
 
-//------------------------------------------------------------------------------------------------------------------------------------------
-// Transforms the XY and W coordinates for the seg into clip space
-//------------------------------------------------------------------------------------------------------------------------------------------
-static void transformSegXYWToClipSpace(DrawSeg& seg) noexcept {
-    // Notes:
-    //  (1) We treat 'y' as if it were 'z' for the purposes of these calculations, since the
-    //      projection matrix has 'z' as the depth value and not y (Doom coord sys).
-    //  (2) We assume that the seg always starts off with an implicit 'w' value of '1'.
-    const float y1Orig = seg.p1y;
-    const float y2Orig = seg.p2y;
-
-    seg.p1x *= gProjMatrix.r0c0;
-    seg.p2x *= gProjMatrix.r0c0;
-    seg.p1y = gProjMatrix.r2c2 * y1Orig + gProjMatrix.r2c3;
-    seg.p2y = gProjMatrix.r2c2 * y2Orig + gProjMatrix.r2c3;
-    seg.p1w = y1Orig;   // Note: r3c2 is an implicit 1.0 - hence we just do this!
-    seg.p2w = y2Orig;   // Note: r3c2 is an implicit 1.0 - hence we just do this!
-}
-
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Clipping functions:
 //
@@ -278,6 +249,235 @@ static bool clipSegAgainstRightPlane(DrawSeg& seg) noexcept {
     return true;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Clip space XY and W coordinates for a batch of segs, stored in structure of arrays format so that several segs at a time can be
+// transformed and tested against the clip planes using SIMD. Segs which can be rejected without doing any actual clipping are flagged,
+// so that they can be skipped before any other work is done on them.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t SEG_BATCH_SIZE = 64;      // Note: must be a multiple of 4
+
+struct ClipSpaceSegBatch {
+    alignas(16) float       p1x[SEG_BATCH_SIZE];
+    alignas(16) float       p1y[SEG_BATCH_SIZE];
+    alignas(16) float       p1w[SEG_BATCH_SIZE];
+    alignas(16) float       p2x[SEG_BATCH_SIZE];
+    alignas(16) float       p2y[SEG_BATCH_SIZE];
+    alignas(16) float       p2w[SEG_BATCH_SIZE];
+    alignas(16) uint32_t    bRejected[SEG_BATCH_SIZE];      // Non zero if the seg is entirely outside of the clip planes
+};
+
+#if SIMD_ENABLED == 0
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tells if the given clip space seg will be rejected by the clip functions above.
+// Only segs that can be rejected without first being clipped against an earlier clip plane are detected.
+// Note: the signed distance tests here MUST match the clip functions exactly!
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool isClipSpaceSegTriviallyRejected(
+    const float p1x,
+    const float p1y,
+    const float p1w,
+    const float p2x,
+    const float p2y,
+    const float p2w
+) noexcept {
+    const bool p1InFront = (p1y + p1w >= 0);
+    const bool p2InFront = (p2y + p2w >= 0);
+
+    if (p1InFront != p2InFront)
+        return false;   // Would be clipped against the front plane, can't tell what the other planes will do
+
+    if (!p1InFront)
+        return true;
+
+    const bool p1InLeft = (p1x + p1w >= 0);
+    const bool p2InLeft = (p2x + p2w >= 0);
+
+    if (p1InLeft != p2InLeft)
+        return false;   // Would be clipped against the left plane, can't tell what the right plane will do
+
+    if (!p1InLeft)
+        return true;
+
+    const bool p1InRight = (-p1x + p1w >= 0);
+    const bool p2InRight = (-p2x + p2w >= 0);
+    return ((!p1InRight) && (!p2InRight));
+}
+#endif
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Transforms the XY coordinates for a batch of segs into view space and then clip space, and flags which segs are trivially rejected.
+//
+// Notes:
+//  (1) We treat 'y' as if it were 'z' for the purposes of these calculations, since the
+//      projection matrix has 'z' as the depth value and not y (Doom coord sys).
+//  (2) We assume that the segs always start off with an implicit 'w' value of '1'.
+//  (3) Since r3c2 in the projection matrix is an implicit 1.0, clip space 'w' is just the view space 'y'.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void transformSegBatchToClipSpace(const seg_t* const pSegs, const uint32_t numSegs, ClipSpaceSegBatch& batch) noexcept {
+    ASSERT(numSegs <= SEG_BATCH_SIZE);
+
+    // Gather the seg coordinates into the batch arrays first, padding the last group of 4 with zeros
+    const uint32_t numSegsPadded = (numSegs + 3) & ~3u;
+
+    for (uint32_t i = 0; i < numSegs; ++i) {
+        const seg_t& seg = pSegs[i];
+        batch.p1x[i] = seg.v1.x;
+        batch.p1y[i] = seg.v1.y;
+        batch.p2x[i] = seg.v2.x;
+        batch.p2y[i] = seg.v2.y;
+    }
+
+    for (uint32_t i = numSegs; i < numSegsPadded; ++i) {
+        batch.p1x[i] = 0.0f;
+        batch.p1y[i] = 0.0f;
+        batch.p2x[i] = 0.0f;
+        batch.p2y[i] = 0.0f;
+    }
+
+    // Transform and classify the segs, 4 at a time if possible
+    #if SIMD_SSE2
+        const __m128 viewX = _mm_set1_ps(gViewX);
+        const __m128 viewY = _mm_set1_ps(gViewY);
+        const __m128 viewSin = _mm_set1_ps(gViewSin);
+        const __m128 viewCos = _mm_set1_ps(gViewCos);
+        const __m128 r0c0 = _mm_set1_ps(gProjMatrix.r0c0);
+        const __m128 r2c2 = _mm_set1_ps(gProjMatrix.r2c2);
+        const __m128 r2c3 = _mm_set1_ps(gProjMatrix.r2c3);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 allBits = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (uint32_t i = 0; i < numSegsPadded; i += 4) {
+            const __m128 x1 = _mm_sub_ps(_mm_load_ps(batch.p1x + i), viewX);
+            const __m128 y1 = _mm_sub_ps(_mm_load_ps(batch.p1y + i), viewY);
+            const __m128 x2 = _mm_sub_ps(_mm_load_ps(batch.p2x + i), viewX);
+            const __m128 y2 = _mm_sub_ps(_mm_load_ps(batch.p2y + i), viewY);
+
+            const __m128 x1Rot = _mm_sub_ps(_mm_mul_ps(viewCos, x1), _mm_mul_ps(viewSin, y1));
+            const __m128 y1Rot = _mm_add_ps(_mm_mul_ps(viewSin, x1), _mm_mul_ps(viewCos, y1));
+            const __m128 x2Rot = _mm_sub_ps(_mm_mul_ps(viewCos, x2), _mm_mul_ps(viewSin, y2));
+            const __m128 y2Rot = _mm_add_ps(_mm_mul_ps(viewSin, x2), _mm_mul_ps(viewCos, y2));
+
+            const __m128 p1x = _mm_mul_ps(x1Rot, r0c0);
+            const __m128 p1y = _mm_add_ps(_mm_mul_ps(r2c2, y1Rot), r2c3);
+            const __m128 p1w = y1Rot;
+            const __m128 p2x = _mm_mul_ps(x2Rot, r0c0);
+            const __m128 p2y = _mm_add_ps(_mm_mul_ps(r2c2, y2Rot), r2c3);
+            const __m128 p2w = y2Rot;
+
+            _mm_store_ps(batch.p1x + i, p1x);
+            _mm_store_ps(batch.p1y + i, p1y);
+            _mm_store_ps(batch.p1w + i, p1w);
+            _mm_store_ps(batch.p2x + i, p2x);
+            _mm_store_ps(batch.p2y + i, p2y);
+            _mm_store_ps(batch.p2w + i, p2w);
+
+            // Same signed distance tests as the clip functions: a seg is rejected if both points are outside a plane and it has not
+            // been clipped against an earlier plane (which would have moved one of the points).
+            // Note: '-x + w' is computed as 'w - x', which gives exactly the same result.
+            const __m128 p1InFront = _mm_cmpge_ps(_mm_add_ps(p1y, p1w), zero);
+            const __m128 p2InFront = _mm_cmpge_ps(_mm_add_ps(p2y, p2w), zero);
+            const __m128 p1InLeft = _mm_cmpge_ps(_mm_add_ps(p1x, p1w), zero);
+            const __m128 p2InLeft = _mm_cmpge_ps(_mm_add_ps(p2x, p2w), zero);
+            const __m128 p1InRight = _mm_cmpge_ps(_mm_sub_ps(p1w, p1x), zero);
+            const __m128 p2InRight = _mm_cmpge_ps(_mm_sub_ps(p2w, p2x), zero);
+
+            const __m128 bothOutFront = _mm_andnot_ps(_mm_or_ps(p1InFront, p2InFront), allBits);
+            const __m128 bothInFront = _mm_and_ps(p1InFront, p2InFront);
+            const __m128 bothOutLeft = _mm_andnot_ps(_mm_or_ps(p1InLeft, p2InLeft), allBits);
+            const __m128 bothInLeft = _mm_and_ps(p1InLeft, p2InLeft);
+            const __m128 bothOutRight = _mm_andnot_ps(_mm_or_ps(p1InRight, p2InRight), allBits);
+
+            const __m128 bRejected = _mm_or_ps(
+                bothOutFront,
+                _mm_and_ps(bothInFront, _mm_or_ps(bothOutLeft, _mm_and_ps(bothInLeft, bothOutRight)))
+            );
+
+            _mm_store_si128((__m128i*)(batch.bRejected + i), _mm_castps_si128(bRejected));
+        }
+    #elif SIMD_NEON
+        const float32x4_t viewX = vdupq_n_f32(gViewX);
+        const float32x4_t viewY = vdupq_n_f32(gViewY);
+        const float32x4_t viewSin = vdupq_n_f32(gViewSin);
+        const float32x4_t viewCos = vdupq_n_f32(gViewCos);
+        const float32x4_t r0c0 = vdupq_n_f32(gProjMatrix.r0c0);
+        const float32x4_t r2c2 = vdupq_n_f32(gProjMatrix.r2c2);
+        const float32x4_t r2c3 = vdupq_n_f32(gProjMatrix.r2c3);
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+
+        for (uint32_t i = 0; i < numSegsPadded; i += 4) {
+            const float32x4_t x1 = vsubq_f32(vld1q_f32(batch.p1x + i), viewX);
+            const float32x4_t y1 = vsubq_f32(vld1q_f32(batch.p1y + i), viewY);
+            const float32x4_t x2 = vsubq_f32(vld1q_f32(batch.p2x + i), viewX);
+            const float32x4_t y2 = vsubq_f32(vld1q_f32(batch.p2y + i), viewY);
+
+            // Note: not using the multiply-accumulate instructions here, since they may be fused and give different results to the
+            // scalar code.
+            const float32x4_t x1Rot = vsubq_f32(vmulq_f32(viewCos, x1), vmulq_f32(viewSin, y1));
+            const float32x4_t y1Rot = vaddq_f32(vmulq_f32(viewSin, x1), vmulq_f32(viewCos, y1));
+            const float32x4_t x2Rot = vsubq_f32(vmulq_f32(viewCos, x2), vmulq_f32(viewSin, y2));
+            const float32x4_t y2Rot = vaddq_f32(vmulq_f32(viewSin, x2), vmulq_f32(viewCos, y2));
+
+            const float32x4_t p1x = vmulq_f32(x1Rot, r0c0);
+            const float32x4_t p1y = vaddq_f32(vmulq_f32(r2c2, y1Rot), r2c3);
+            const float32x4_t p1w = y1Rot;
+            const float32x4_t p2x = vmulq_f32(x2Rot, r0c0);
+            const float32x4_t p2y = vaddq_f32(vmulq_f32(r2c2, y2Rot), r2c3);
+            const float32x4_t p2w = y2Rot;
+
+            vst1q_f32(batch.p1x + i, p1x);
+            vst1q_f32(batch.p1y + i, p1y);
+            vst1q_f32(batch.p1w + i, p1w);
+            vst1q_f32(batch.p2x + i, p2x);
+            vst1q_f32(batch.p2y + i, p2y);
+            vst1q_f32(batch.p2w + i, p2w);
+
+            // Same signed distance tests as the clip functions (see the SSE2 version above)
+            const uint32x4_t p1InFront = vcgeq_f32(vaddq_f32(p1y, p1w), zero);
+            const uint32x4_t p2InFront = vcgeq_f32(vaddq_f32(p2y, p2w), zero);
+            const uint32x4_t p1InLeft = vcgeq_f32(vaddq_f32(p1x, p1w), zero);
+            const uint32x4_t p2InLeft = vcgeq_f32(vaddq_f32(p2x, p2w), zero);
+            const uint32x4_t p1InRight = vcgeq_f32(vsubq_f32(p1w, p1x), zero);
+            const uint32x4_t p2InRight = vcgeq_f32(vsubq_f32(p2w, p2x), zero);
+
+            const uint32x4_t bothOutFront = vmvnq_u32(vorrq_u32(p1InFront, p2InFront));
+            const uint32x4_t bothInFront = vandq_u32(p1InFront, p2InFront);
+            const uint32x4_t bothOutLeft = vmvnq_u32(vorrq_u32(p1InLeft, p2InLeft));
+            const uint32x4_t bothInLeft = vandq_u32(p1InLeft, p2InLeft);
+            const uint32x4_t bothOutRight = vmvnq_u32(vorrq_u32(p1InRight, p2InRight));
+
+            const uint32x4_t bRejected = vorrq_u32(
+                bothOutFront,
+                vandq_u32(bothInFront, vorrq_u32(bothOutLeft, vandq_u32(bothInLeft, bothOutRight)))
+            );
+
+            vst1q_u32(batch.bRejected + i, bRejected);
+        }
+    #else
+        const float r0c0 = gProjMatrix.r0c0;
+        const float r2c2 = gProjMatrix.r2c2;
+        const float r2c3 = gProjMatrix.r2c3;
+
+        for (uint32_t i = 0; i < numSegs; ++i) {
+            transformPointToViewSpace(batch.p1x[i], batch.p1y[i]);
+            transformPointToViewSpace(batch.p2x[i], batch.p2y[i]);
+
+            const float y1 = batch.p1y[i];
+            const float y2 = batch.p2y[i];
+            batch.p1x[i] *= r0c0;
+            batch.p2x[i] *= r0c0;
+            batch.p1y[i] = r2c2 * y1 + r2c3;
+            batch.p2y[i] = r2c2 * y2 + r2c3;
+            batch.p1w[i] = y1;
+            batch.p2w[i] = y2;
+
+            batch.bRejected[i] = isClipSpaceSegTriviallyRejected(
+                batch.p1x[i], batch.p1y[i], batch.p1w[i],
+                batch.p2x[i], batch.p2y[i], batch.p2w[i]
+            );
+        }
+    #endif
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Add the clip space Z (height) values to the seg.
 // We add these lazily after other clipping operations have succeeded.
@@ -422,6 +622,14 @@ namespace FragEmitFlags {
     static constexpr FragEmitFlagsT LOWER_WALL_OCCLUDER     = 0x0100;       // Emit a lower wall occluder entry
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Marks the given screen column as accepting no more seg pixels
+//------------------------------------------------------------------------------------------------------------------------------------------
+static inline void markSegColumnFull(const uint32_t x) noexcept {
+    ++gNumFullSegCols;
+    ++gCoverageTiles[x / CoverageTile::NUM_COLS].numFullSegCols;
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Adds the currently emitted wall column part (upper, lower, mid) to the given column clip bounds.
 // The wall column is specified by it's top and bottom screen space bounds.
@@ -429,6 +637,7 @@ namespace FragEmitFlags {
 //------------------------------------------------------------------------------------------------------------------------------------------
 template <FragEmitFlagsT FLAGS>
 static inline void addWallColumnPartToClipBounds(
+    const uint32_t x,
     SegClip& clipBounds,
     [[maybe_unused]] const int32_t zt,
     [[maybe_unused]] const int32_t zb
@@ -446,7 +655,7 @@ static inline void addWallColumnPartToClipBounds(
     // Decide what to do
     if constexpr (FLAGS == FragEmitFlags::MID_WALL) {
         clipBounds = SegClip{ 0, 0 };
-        ++gNumFullSegCols;
+        markSegColumnFull(x);
     }
     else {
         if constexpr (FLAGS == FragEmitFlags::UPPER_WALL) {
@@ -457,7 +666,7 @@ static inline void addWallColumnPartToClipBounds(
 
         if (clipBounds.top + 1 >= clipBounds.bottom) {
             clipBounds = SegClip{ 0, 0 };
-            ++gNumFullSegCols;
+            markSegColumnFull(x);
         }
     }
 }
@@ -566,7 +775,7 @@ static uint32_t clipAndEmitWallColumn(
     } while (false);
 
     // Add this column to the clip bounds for this screen column
-    addWallColumnPartToClipBounds<FLAGS>(clipBounds, (int32_t) zt, (int32_t) std::floor(zb));
+    addWallColumnPartToClipBounds<FLAGS>(x, clipBounds, (int32_t) zt, (int32_t) std::floor(zb));
     return numColumnsEmitted;
 }
 
@@ -646,7 +855,7 @@ static uint32_t clipAndEmitFlatColumn(
             clipBounds = SegClip{ (int16_t) zbInt, clipBounds.bottom };
         } else {
             clipBounds = SegClip{ 0, 0 };
-            gNumFullSegCols++;
+            markSegColumnFull(x);
         }
     }
     else {
@@ -654,7 +863,7 @@ static uint32_t clipAndEmitFlatColumn(
             clipBounds = SegClip{ clipBounds.top, (int16_t) ztInt };
         } else {
             clipBounds = SegClip{ 0, 0 };
-            gNumFullSegCols++;
+            markSegColumnFull(x);
         }
     }
 
@@ -669,6 +878,61 @@ enum class EmitOccluderMode {
     BOTTOM      // Occlude at the given screen coordinate and below
 };
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Updates the coverage tile for the given screen column if the last occluding column there now leaves nothing visible.
+// Must only be called if the screen column was not already fully occluded before the last occluding column was added or changed.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static inline void updateCoverageForOccluderColumn(const uint32_t x, const OccluderBlock& lastBlock) noexcept {
+    const uint32_t lastEntryIdx = lastBlock.count - 1;
+    const OccluderBlock::Bounds lastBounds = lastBlock.bounds[lastEntryIdx];
+
+    if (lastBounds.top + 1 >= lastBounds.bottom) {
+        CoverageTile& tile = gCoverageTiles[x / CoverageTile::NUM_COLS];
+        ++tile.numOccludedCols;
+        tile.maxOccluderDepth = std::max(tile.maxOccluderDepth, lastBlock.lineMaxDepths[lastEntryIdx]);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Adds a new occluding column to the given screen column's list of occluders, allocating a new block for it if required
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void addOccludingColumn(
+    const uint32_t x,
+    OccludingColumns& occludingCols,
+    const float depth,
+    line_t& line,
+    const int16_t boundsTop,
+    const int16_t boundsBottom
+) noexcept {
+    // Need a new block if there is no room in the current one
+    uint32_t blockIdx = occludingCols.lastBlockIdx;
+
+    if ((blockIdx == OccluderBlock::INVALID_IDX) || (gOccluderBlocks[blockIdx].count >= OccluderBlock::NUM_ENTRIES)) {
+        const uint32_t newBlockIdx = (uint32_t) gOccluderBlocks.size();
+        OccluderBlock& newBlock = gOccluderBlocks.emplace_back();
+        newBlock.count = 0;
+        newBlock.prevBlockIdx = blockIdx;
+        occludingCols.lastBlockIdx = newBlockIdx;
+        blockIdx = newBlockIdx;
+    }
+
+    // Fill in the new entry
+    OccluderBlock& block = gOccluderBlocks[blockIdx];
+    const uint32_t entryIdx = block.count;
+    block.lineMinDepths[entryIdx] = std::min(line.v1DrawDepth, line.v2DrawDepth);
+    block.lineMaxDepths[entryIdx] = std::max(line.v1DrawDepth, line.v2DrawDepth);
+    block.pLines[entryIdx] = &line;
+    block.bounds[entryIdx].top = boundsTop;
+    block.bounds[entryIdx].bottom = boundsBottom;
+    ++block.count;
+
+    ++occludingCols.count;
+    occludingCols.lastDepth = depth;
+
+    // Note: a new occluding column is only ever added if the screen column is not already fully occluded
+    updateCoverageForOccluderColumn(x, block);
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Emits an occluder column that occludes sprites.
 // Either the top or bottom can be occluded.
@@ -694,65 +958,42 @@ static void emitOccluderColumn(
 
     // Determine if we need a new occluder column
     OccludingColumns& occludingCols = gOccludingCols[x];
-    const uint32_t numOccludingCols = occludingCols.count;
-    const uint32_t curOccluderIdx = numOccludingCols - 1;
 
-    if (numOccludingCols <= 0) {
+    if (occludingCols.count <= 0) {
         // No occluders for this column yet: need a new occluding columns bounds entry
-        ASSERT_LOG(numOccludingCols < OccludingColumns::MAX_ENTRIES, "Too many occluders for column!");
-
-        if (numOccludingCols >= OccludingColumns::MAX_ENTRIES)
-            return;
-
-        ++occludingCols.count;
-        occludingCols.depths[0] = depth;
-        occludingCols.pLines[0] = &line;
-        OccludingColumns::Bounds& bounds = occludingCols.bounds[0];
-
         if constexpr (MODE == EmitOccluderMode::TOP) {
-            bounds.top = (int16_t) screenYCoord;
-            bounds.bottom = (int16_t) g3dViewHeight;
+            addOccludingColumn(x, occludingCols, depth, line, (int16_t) screenYCoord, (int16_t) g3dViewHeight);
         } else {
-            bounds.top = -1;
-            bounds.bottom = (int16_t) screenYCoord;
+            addOccludingColumn(x, occludingCols, depth, line, -1, (int16_t) screenYCoord);
         }
+
+        return;
     }
-    else if (occludingCols.depths[curOccluderIdx] < depth) {
+
+    OccluderBlock& lastBlock = gOccluderBlocks[occludingCols.lastBlockIdx];
+    OccluderBlock::Bounds& lastBounds = lastBlock.bounds[lastBlock.count - 1];
+
+    if (occludingCols.lastDepth < depth) {
         // Closer occluders at this column.
         // Only emit a new occluder if it would decrease the number of visible pixels.
-        const OccludingColumns::Bounds prevBounds = occludingCols.bounds[curOccluderIdx];
+        const OccluderBlock::Bounds prevBounds = lastBounds;
         const int32_t numRowsVisible = std::max((int32_t) prevBounds.bottom - (int32_t) prevBounds.top - 1, 0);
 
         // Figure out the new bounds and new number of rows visible.
         // Only emit the occluder which is deeper in if it occludes more:
         const int16_t newBound = (int16_t) screenYCoord;
-        bool bEmitOccluder;
 
         if constexpr (MODE == EmitOccluderMode::TOP) {
             const int32_t newNumRowsVisible = std::max((int32_t) prevBounds.bottom - (int32_t) newBound - 1, 0);
-            bEmitOccluder = (newNumRowsVisible < numRowsVisible);
+
+            if (newNumRowsVisible < numRowsVisible) {
+                addOccludingColumn(x, occludingCols, depth, line, newBound, prevBounds.bottom);
+            }
         } else {
             const int32_t newNumRowsVisible = std::max((int32_t) newBound - (int32_t) prevBounds.top - 1, 0);
-            bEmitOccluder = (newNumRowsVisible < numRowsVisible);
-        }
-
-        if (bEmitOccluder) {
-            ASSERT_LOG(numOccludingCols < OccludingColumns::MAX_ENTRIES, "Too many occluders for column!");
 
-            if (numOccludingCols >= OccludingColumns::MAX_ENTRIES)
-                return;
-
-            ++occludingCols.count;
-            occludingCols.depths[numOccludingCols] = depth;
-            occludingCols.pLines[numOccludingCols] = &line;
-            OccludingColumns::Bounds& bounds = occludingCols.bounds[numOccludingCols];
-
-            if constexpr (MODE == EmitOccluderMode::TOP) {
-                bounds.top = newBound;
-                bounds.bottom = prevBounds.bottom;
-            } else {
-                bounds.top = prevBounds.top;
-                bounds.bottom = newBound;
+            if (newNumRowsVisible < numRowsVisible) {
+                addOccludingColumn(x, occludingCols, depth, line, prevBounds.top, newBound);
             }
         }
     } else {
@@ -765,12 +1006,16 @@ static void emitOccluderColumn(
         // rare cases where this does not occur for some strange reason, maybe due to the imperfect nature
         // of the BSP splits and lower accuracy of fixed point numbers?
         //
-        OccludingColumns::Bounds& bounds = occludingCols.bounds[curOccluderIdx];
+        const bool bWasFullyOccluded = (lastBounds.top + 1 >= lastBounds.bottom);
 
         if constexpr (MODE == EmitOccluderMode::TOP) {
-            bounds.top = std::max((int16_t) screenYCoord, bounds.top);
+            lastBounds.top = std::max((int16_t) screenYCoord, lastBounds.top);
         } else {
-            bounds.bottom = std::min((int16_t) screenYCoord, bounds.bottom);
+            lastBounds.bottom = std::min((int16_t) screenYCoord, lastBounds.bottom);
+        }
+
+        if (!bWasFullyOccluded) {
+            updateCoverageForOccluderColumn(x, lastBlock);
         }
     }
 }
@@ -1383,15 +1628,12 @@ static uint32_t emitDrawSegColumns(const DrawSeg& drawSeg, seg_t& seg) noexcept
     return numWallAndFlatCols;
 }
 
-void addSegToFrame(seg_t& seg) noexcept {
-    // First transform the seg into viewspace and populate vertex attributes
-    DrawSeg drawSeg;
-    populateSegVertexAttribs(seg, drawSeg);
-    transformSegXYToViewSpace(seg, drawSeg);
-
-    // Next transform to clip space and clip against the front and left + right planes
-    transformSegXYWToClipSpace(drawSeg);
-
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Finishes preparing the given seg once it has been transformed to clip space and emits all of its wall and floor fragments.
+// The seg may still be rejected by clipping or back face culling.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void addClipSpaceSegToFrame(seg_t& seg, DrawSeg& drawSeg) noexcept {
+    // Clip against the front and left + right planes
     if (!clipSegAgainstFrontPlane(drawSeg))
         return;
 
@@ -1472,4 +1714,36 @@ void addSegToFrame(seg_t& seg) noexcept {
     }
 }
 
+void addSegsToFrame(seg_t* const pSegs, const uint32_t numSegs) noexcept {
+    PROFILE_ZONE("Wall Prep");
+
+    // Transform and classify the segs in batches, then finish preparing the segs which are not trivially rejected.
+    // Note: segs must be emitted in their original order, so the rest of the work is done one seg at a time.
+    ClipSpaceSegBatch batch;
+
+    for (uint32_t batchStartIdx = 0; batchStartIdx < numSegs; batchStartIdx += SEG_BATCH_SIZE) {
+        seg_t* const pBatchSegs = pSegs + batchStartIdx;
+        const uint32_t numBatchSegs = std::min(numSegs - batchStartIdx, SEG_BATCH_SIZE);
+        transformSegBatchToClipSpace(pBatchSegs, numBatchSegs, batch);
+
+        for (uint32_t i = 0; i < numBatchSegs; ++i) {
+            if (batch.bRejected[i])
+                continue;
+
+            seg_t& seg = pBatchSegs[i];
+            DrawSeg drawSeg = {};
+            populateSegVertexAttribs(seg, drawSeg);
+
+            drawSeg.p1x = batch.p1x[i];
+            drawSeg.p1y = batch.p1y[i];
+            drawSeg.p1w = batch.p1w[i];
+            drawSeg.p2x = batch.p2x[i];
+            drawSeg.p2y = batch.p2y[i];
+            drawSeg.p2w = batch.p2w[i];
+
+            addClipSpaceSegToFrame(seg, drawSeg);
+        }
+    }
+}
+
 END_NAMESPACE(Renderer)
@@ -1,5 +1,6 @@
 #include "Renderer_Internal.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
 #include "Blit.h"
 #include "CelImages.h"
@@ -15,13 +16,32 @@ BEGIN_NAMESPACE(Renderer)
 
 static constexpr int32_t SCREEN_GUN_Y = -38;  // Y offset to center the player's weapon properly
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Details on the player's weapons to draw, captured from the player at the start of drawing the view.
+// Captured up front so that the game can keep simulating while the view is still being drawn.
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct WeaponDrawState {
+    const state_t*  pSpriteStates[NUMPSPRITES];     // The state for each weapon sprite, or null if the sprite is not active
+    int32_t         spriteX[NUMPSPRITES];           // X and Y position of each weapon sprite in pixels
+    int32_t         spriteY[NUMPSPRITES];
+    uint32_t        lightLevel;                     // Light level to draw the weapon at, if not fullbright
+    bool            bShadow;                        // Draw the weapon partially invisible?
+};
+
+static WeaponDrawState gWeaponDrawState;
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Draw a single weapon or muzzle flash on the screen
 //------------------------------------------------------------------------------------------------------------------------------------------
-static void DrawAWeapon(const pspdef_t& psp, const bool bShadow) noexcept {
+static void DrawAWeapon(
+    const state_t& playerSpriteState,
+    const int32_t weaponX,
+    const int32_t weaponY,
+    const uint32_t lightLevel,
+    const bool bShadow
+) noexcept {
     // Get the images to draw for this weapon.
     // Note that the weapon image data includes offsets for where to render the sprite!
-    const state_t& playerSpriteState = *psp.StatePtr;
     const uint32_t resourceNum = playerSpriteState.SpriteFrame >> FF_SPRITESHIFT;
     const CelImageArray& weaponImgs = CelImages::loadImages(
         resourceNum,
@@ -37,13 +57,13 @@ static void DrawAWeapon(const pspdef_t& psp, const bool bShadow) noexcept {
     if ((playerSpriteState.SpriteFrame & FF_FULLBRIGHT) != 0) {
         lightMul = 1.0f;
     } else {
-        const LightParams& lightParams = getLightParams(gPlayer.mo->subsector->sector->lightlevel + gExtraLight);
+        const LightParams& lightParams = getLightParams(lightLevel);
         lightMul = lightParams.getLightMulForDist(0.0f);
     }
 
     // Decide where to draw the gun sprite part
-    float gunX = (float)(img.offsetX + psp.WeaponX);
-    float gunY = (float)(img.offsetY + psp.WeaponY + SCREEN_GUN_Y);
+    float gunX = (float)(img.offsetX + weaponX);
+    float gunY = (float)(img.offsetY + weaponY + SCREEN_GUN_Y);
 
     // HACK: Fixes somewhat (not completely though, due to the asset) a slight wiggle in one of the rocket
     // launcher frames. Not sure how this error got added, but the bug was in the original 3DO version.
@@ -73,10 +93,10 @@ static void DrawAWeapon(const pspdef_t& psp, const bool bShadow) noexcept {
             0.0f,
             (float) img.width,
             (float) img.height,
-            Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * Video::gScreenWidth + g3dViewXOffset,
+            gpViewPixels,
             g3dViewWidth,
             g3dViewHeight,
-            Video::gScreenWidth,
+            gViewPixelsPitch,
             (float) gunX,
             (float) gunY,
             (float) img.width * gGunXScale,
@@ -101,10 +121,10 @@ static void DrawAWeapon(const pspdef_t& psp, const bool bShadow) noexcept {
             0.0f,
             (float) img.width,
             (float) img.height,
-            Video::gpFrameBuffer + (uintptr_t) g3dViewYOffset * Video::gScreenWidth + g3dViewXOffset,
+            gpViewPixels,
             g3dViewWidth,
             g3dViewHeight,
-            Video::gScreenWidth,
+            gViewPixelsPitch,
             (float) gunX,
             (float) gunY,
             (float) img.width * gGunXScale,
@@ -119,30 +139,47 @@ static void DrawAWeapon(const pspdef_t& psp, const bool bShadow) noexcept {
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Draw the player's weapon in the foreground
+// Saves the details of the player's weapons to draw from the current player state.
+// Must be done after the extra light for the view has been determined.
 //------------------------------------------------------------------------------------------------------------------------------------------
-void drawWeapons() noexcept {
+void captureWeaponDrawState() noexcept {
+    const player_t& player = gPlayer;
+    WeaponDrawState& drawState = gWeaponDrawState;
+
     // Determine whether to draw the weapon partially invisible
-    bool bShadow = false;
-    if (gPlayer.mo->flags & MF_SHADOW) {
-        const uint32_t powerTicksLeft = gPlayer.powers[pw_invisibility];    // Get flash time
-        bShadow = (
+    drawState.bShadow = false;
+    if (player.mo->flags & MF_SHADOW) {
+        const uint32_t powerTicksLeft = player.powers[pw_invisibility];     // Get flash time
+        drawState.bShadow = (
             (powerTicksLeft >= (5 * TICKSPERSEC)) ||    // Is there a long time left for the power still?
             ((powerTicksLeft & 0x10) != 0)              // Allowed to show while flashing off?
         );
     }
 
+    drawState.lightLevel = player.mo->subsector->sector->lightlevel + gExtraLight;
+
+    for (uint32_t i = 0; i < NUMPSPRITES; ++i) {
+        const pspdef_t& sprite = player.psprites[i];
+        drawState.pSpriteStates[i] = sprite.StatePtr;
+        drawState.spriteX[i] = sprite.WeaponX;
+        drawState.spriteY[i] = sprite.WeaponY;
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Draw the player's weapon in the foreground
+//------------------------------------------------------------------------------------------------------------------------------------------
+void drawWeapons() noexcept {
+    PROFILE_ZONE("Weapons");
+
     // Draw the sprites (if valid)
-    {
-        const pspdef_t* pSprite = gPlayer.psprites;                 // Get the first sprite in the array
-        const pspdef_t* const pEndSprite = pSprite + NUMPSPRITES;
+    const WeaponDrawState& drawState = gWeaponDrawState;
 
-        while (pSprite < pEndSprite) {
-            if (pSprite->StatePtr) {                // Valid state record?
-                DrawAWeapon(*pSprite, bShadow);     // Draw the weapon
-            }
+    for (uint32_t i = 0; i < NUMPSPRITES; ++i) {
+        const state_t* const pState = drawState.pSpriteStates[i];
 
-            ++pSprite;
+        if (pState) {   // Valid state record?
+            DrawAWeapon(*pState, drawState.spriteX[i], drawState.spriteY[i], drawState.lightLevel, drawState.bShadow);
         }
     }
 
@@ -0,0 +1,29 @@
+#pragma once
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Detects which SIMD instruction set (if any) is available for the target CPU and includes the intrinsics header for it.
+// Code with hand written SIMD paths should test these macros rather than checking for particular compilers or CPUs itself.
+//
+//  SIMD_ENABLED    : '1' if any of the instruction sets below are available, '0' otherwise.
+//  SIMD_SSE2       : '1' if SSE2 is available (x86 and x64).
+//  SIMD_NEON       : '1' if NEON is available (ARM).
+//
+// Set 'SIMD_ENABLED' to '0' beforehand to force the plain scalar code to always be used.
+//------------------------------------------------------------------------------------------------------------------------------------------
+#ifndef SIMD_ENABLED
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define SIMD_ENABLED 1
+        #define SIMD_SSE2 1
+    #elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        #define SIMD_ENABLED 1
+        #define SIMD_NEON 1
+    #else
+        #define SIMD_ENABLED 0
+    #endif
+#endif
+
+#if SIMD_SSE2
+    #include <emmintrin.h>
+#elif SIMD_NEON
+    #include <arm_neon.h>
+#endif
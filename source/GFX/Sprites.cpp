@@ -3,16 +3,20 @@
 #include "Base/Endian.h"
 #include "Base/Mem.h"
 #include "Base/Resource.h"
+#include "Game/Config.h"
 #include "Game/DoomRez.h"
 #include "Game/Resources.h"
+#include "ImageData.h"
 #include "ThreeDO/CelUtils.h"
 #include <algorithm>
+#include <cstdlib>
 #include <map>
 #include <vector>
 
 BEGIN_NAMESPACE(Sprites)
 
 static std::vector<Sprite> gSprites;
+static uint32_t            gMaxHorizontalExtent;   // Value returned by 'getMaxHorizontalExtent', worked out for all sprites on init
 
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Header for sprite data.
@@ -61,8 +65,8 @@ static Sprite& getSpriteForResourceNum(const uint32_t resourceNum) noexcept {
 // Frees the texture data associated with a sprite
 //------------------------------------------------------------------------------------------------------------------------------------------
 static void freeSprite(Sprite& sprite) noexcept {
-    // Gather up all the texture data pointers that need to be freed
-    std::vector<uint16_t*> tmpTexturePtrList;
+    // Gather up all the texture data pointers that need to be freed (including expanded 32-bit textures)
+    std::vector<void*> tmpTexturePtrList;
 
     {
         SpriteFrame* pCurSpriteFrame = sprite.pFrames;
@@ -77,6 +81,10 @@ static void freeSprite(Sprite& sprite) noexcept {
                 if (pAngleTexture && pAngleTexture != pPrevTexture) {
                     tmpTexturePtrList.push_back(pAngleTexture);
                     pPrevTexture = pAngleTexture;
+
+                    if (angle.pTexture32) {
+                        tmpTexturePtrList.push_back(angle.pTexture32);
+                    }
                 }
             }
 
@@ -89,9 +97,9 @@ static void freeSprite(Sprite& sprite) noexcept {
 
     // Now free all the pointers and cleanup the temp list
     {
-        uint16_t* pPrevFreedTexture = nullptr;
+        void* pPrevFreedTexture = nullptr;
 
-        for (uint16_t* pTexture : tmpTexturePtrList) {
+        for (void* pTexture : tmpTexturePtrList) {
             if (pTexture != pPrevFreedTexture) {
                 MemFree(pTexture);
                 pPrevFreedTexture = pTexture;
@@ -116,14 +124,64 @@ static SpriteImageHeader readSpriteFrameHeader(const std::byte* const pData) noe
     return header;
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Gives the furthest any column of the given sprite image can be drawn to the left or right of the sprite's position.
+// Only the image header and CEL control block are read, the image itself is not decoded.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t getImageHorizontalExtent(const std::byte* const pImageHeaderData) noexcept {
+    const SpriteImageHeader header = readSpriteFrameHeader(pImageHeaderData);
+    const CelControlBlock& ccb = reinterpret_cast<const CelControlBlock&>(pImageHeaderData[sizeof(SpriteImageHeader)]);
+
+    // Note: Doom sprites are stored in COLUMN MAJOR format, so the CEL height is actually the sprite width
+    const int32_t width = CelUtils::getCCBHeight(ccb);
+    const uint32_t extentL = (uint32_t) std::abs((int32_t) header.leftOffset);
+    const uint32_t extentR = (uint32_t) std::abs(width - (int32_t) header.leftOffset);
+    return std::max(extentL, extentR);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Works out the furthest any frame of any sprite can be drawn to the left or right of the sprite's position, without loading sprites
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t determineMaxHorizontalExtent() noexcept {
+    uint32_t maxExtent = 0;
+
+    for (uint32_t resourceNum = getFirstSpriteResourceNum(); resourceNum < getEndSpriteResourceNum(); ++resourceNum) {
+        const std::byte* const pSpriteData = (const std::byte*) Resources::load(resourceNum)->pData;
+        const uint32_t* const pFrameOffsets = (const uint32_t*) pSpriteData;
+        const uint32_t numFrames = (Endian::bigToHost(pFrameOffsets[0]) & REMOVE_SPR_OFFSET_FLAGS_MASK) / sizeof(uint32_t);
+
+        for (uint32_t frameIdx = 0; frameIdx < numFrames; ++frameIdx) {
+            const uint32_t frameOffsetWithFlags = Endian::bigToHost(pFrameOffsets[frameIdx]);
+            const uint32_t frameOffset = frameOffsetWithFlags & REMOVE_SPR_OFFSET_FLAGS_MASK;
+
+            if (frameOffsetWithFlags & SPR_OFFSET_FLAG_ROTATED) {
+                const uint32_t* const pFrameAngleOffsets = (const uint32_t*)(pSpriteData + frameOffset);
+
+                for (uint8_t angle = 0; angle < NUM_SPRITE_DIRECTIONS; ++angle) {
+                    const uint32_t frameAngleOffset = (frameOffset + Endian::bigToHost(pFrameAngleOffsets[angle])) & REMOVE_SPR_OFFSET_FLAGS_MASK;
+                    maxExtent = std::max(maxExtent, getImageHorizontalExtent(pSpriteData + frameAngleOffset));
+                }
+            } else {
+                maxExtent = std::max(maxExtent, getImageHorizontalExtent(pSpriteData + frameOffset));
+            }
+        }
+
+        Resources::release(resourceNum);
+    }
+
+    return maxExtent;
+}
+
 void init() noexcept {
     ASSERT(gSprites.empty());
     gSprites.resize(getNumSprites());
+    gMaxHorizontalExtent = determineMaxHorizontalExtent();
 }
 
 void shutdown() noexcept {
     freeAll();
     gSprites.clear();
+    gMaxHorizontalExtent = 0;
 }
 
 void freeAll() noexcept {
@@ -183,6 +241,7 @@ const Sprite* load(const uint32_t resourceNum) noexcept {
     // Only want to load each unique images - some frames may use duplicate or flipped sprite data!
     struct DecodedImage {
         uint16_t*   pPixels;
+        uint32_t*   pPixels32;
         uint16_t    width;
         uint16_t    height;
         uint16_t    _unused[2];
@@ -211,6 +270,7 @@ const Sprite* load(const uint32_t resourceNum) noexcept {
 
                 SpriteFrameAngle& frameAngle = frame.angles[angle];
                 frameAngle.pTexture = (uint16_t*)(uintptr_t) imageDataOffset;   // Hold the desired image offset for now
+                frameAngle.pTexture32 = nullptr;                                // Filled in once we load the image
                 frameAngle.width = 0;                                           // Unknown until we load the image
                 frameAngle.height = 0;                                          // Unknown until we load the image
                 frameAngle.flipped = ((frameAngleOffsetWithFlags & SPR_OFFSET_FLAG_FLIP) != 0);
@@ -229,6 +289,7 @@ const Sprite* load(const uint32_t resourceNum) noexcept {
 
             SpriteFrameAngle& frameAngle = frame.angles[0];
             frameAngle.pTexture = (uint16_t*)(uintptr_t) imageDataOffset;       // Hold the desired image offset for now
+            frameAngle.pTexture32 = nullptr;                                    // Filled in once we load the image
             frameAngle.width = 0;                                               // Unknown until we load the image
             frameAngle.height = 0;                                              // Unknown until we load the image
             frameAngle.flipped = ((frameOffsetWithFlags & SPR_OFFSET_FLAG_FLIP) != 0);
@@ -285,6 +346,16 @@ const Sprite* load(const uint32_t resourceNum) noexcept {
         decodedImage.pPixels = celImg.pPixels;
         decodedImage.width = celImg.width;
         decodedImage.height = celImg.height;
+
+        // Make a 32-bit copy of the image for faster rendering, if enabled
+        if (Config::gbPreExpandTextures) {
+            decodedImage.pPixels32 = ImageDataUtils::allocExpandedARGB8888Pixels(
+                celImg.pPixels,
+                (uint32_t) celImg.width * celImg.height
+            );
+        } else {
+            decodedImage.pPixels32 = nullptr;
+        }
     }
 
     // Now once we have all the image data, fill in the actual texture info for all sprite frames
@@ -301,8 +372,10 @@ const Sprite* load(const uint32_t resourceNum) noexcept {
             // Note: Doom sprites are stored in COLUMN MAJOR format, so the width is actually the height and visa versa...
             // Swap them here to account for this!
             angle.pTexture = decodedImage.pPixels;
+            angle.pTexture32 = decodedImage.pPixels32;
             angle.width = decodedImage.height;
             angle.height = decodedImage.width;
+            ASSERT(getImageHorizontalExtent(pSpriteData + requestedImageOffset - sizeof(SpriteImageHeader)) <= gMaxHorizontalExtent);
         }
     }
 
@@ -310,6 +383,10 @@ const Sprite* load(const uint32_t resourceNum) noexcept {
     return &sprite;
 }
 
+uint32_t getMaxHorizontalExtent() noexcept {
+    return gMaxHorizontalExtent;
+}
+
 void free(const uint32_t resourceNum) noexcept {
     Sprite& sprite = getSpriteForResourceNum(resourceNum);
     freeSprite(sprite);
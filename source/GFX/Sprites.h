@@ -19,6 +19,7 @@ static constexpr uint32_t NUM_SPRITE_DIRECTIONS = 8;
 //------------------------------------------------------------------------------------------------------------------------------------------
 struct SpriteFrameAngle {
     uint16_t*   pTexture;       // The sprite texture to use for the frame. This texture is in RGBA5551 format and COLUMN MAJOR.
+    uint32_t*   pTexture32;     // Optional copy of the sprite texture expanded to ARGB8888 format for faster rendering, or 'nullptr' if not available.
     uint16_t    width;          // Width of sprite texture
     uint16_t    height : 15;    // Height of sprite texture
     uint16_t    flipped : 1;    // If '1' then the frame is flipped horizontally when rendered
@@ -62,4 +63,8 @@ const Sprite* get(const uint32_t resourceNum) noexcept;
 const Sprite* load(const uint32_t resourceNum) noexcept;
 void free(const uint32_t resourceNum) noexcept;
 
+// Returns the furthest any column of any sprite frame can be drawn to the left or right of the sprite's position, in world units.
+// This is worked out for all sprites on init, whether they are loaded or not, so it is a safe bound for how far a sprite can overhang.
+uint32_t getMaxHorizontalExtent() noexcept;
+
 END_NAMESPACE(Sprites)
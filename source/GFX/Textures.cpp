@@ -1,6 +1,7 @@
 #include "Textures.h"
 
 #include "Base/Endian.h"
+#include "Game/Config.h"
 #include "Game/DoomRez.h"
 #include "Game/Resources.h"
 #include <vector>
@@ -152,10 +153,16 @@ static void loadTexture(Texture& tex, uint32_t textureNum, const bool bIsWallTex
 
     Resources::free(tex.resourceNum);       // Don't need the raw data anymore!
     tex.animTexNum = textureNum;            // Initially the texture is not animated to display another frame
+
+    // Make a 32-bit copy of the texture for faster rendering, if enabled
+    if (Config::gbPreExpandTextures) {
+        tex.data.pPixels32 = ImageDataUtils::allocExpandedARGB8888Pixels(tex.data.pPixels, tex.data.width * tex.data.height);
+    }
 }
 
 static void freeTexture(Texture& tex) noexcept {
     MEM_FREE_AND_NULL(tex.data.pPixels);
+    MEM_FREE_AND_NULL(tex.data.pPixels32);
 }
 
 static void freeTextures(std::vector<Texture>& textures) noexcept {
@@ -1,23 +1,76 @@
 #include "Video.h"
 
+#include "Base/FileUtils.h"
+#include "Base/Profiler.h"
 #include "Game/Config.h"
 #include "Game/DoomDefines.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include <SDL.h>
 
 BEGIN_NAMESPACE(Video)
 
+// Alignment for the framebuffers in offscreen mode and asynchronous present mode: a typical cache line size.
+// This is also enough alignment for any SIMD loads and stores done on the framebuffer.
+static constexpr uintptr_t OFFSCREEN_FRAMEBUFFER_ALIGN = 64;
+
+// Window backend: state
 static SDL_Window*      gWindow;
 static SDL_Renderer*    gRenderer;
 static SDL_Texture*     gFramebufferTexture;
 static SDL_Rect         gOutputRect;
 
+// Window backend: asynchronous present state.
+// The game draws to one of a ring of CPU framebuffers. When a frame is presented, a worker thread copies the rows which changed into a
+// staging buffer (doing 16-bit framebuffer simulation as it goes) while the game gets on with the next frame. On the next present the
+// main thread uploads the staged rows to the framebuffer texture and shows them. Only the main thread ever calls into the SDL render
+// and window APIs, as SDL requires: the worker thread only touches plain CPU memory. Note that this does not decouple the game from the
+// display refresh, since presenting (and any vsync wait) still happens on the main thread, and it delays each frame by one present.
+// For these reasons it is disabled by default.
+static constexpr uint32_t NUM_ASYNC_FRAMEBUFFERS = 3;
+
+static bool                     gbAsyncPresent;                                     // If true then frames are prepared for upload by the frame prep thread
+static std::thread              gFramePrepThread;                                   // The thread which copies and converts frames into the staging buffer
+static std::mutex               gFramePrepMutex;                                    // Guards all of the frame prep thread sync state below
+static std::condition_variable  gFramePrepCondVar;                                  // Signalled whenever the frame prep thread sync state changes
+static std::byte*               gpAsyncFrameBuffersMem;                             // The memory allocation the aligned framebuffers live in
+static uint32_t*                gpAsyncFrameBuffers[NUM_ASYNC_FRAMEBUFFERS];        // The ring of framebuffers drawn to by the game
+static uint32_t*                gpStagingFrameBuffer;                               // Converted pixels of the last frame queued, ready for upload
+static uint32_t                 gStaleRowBeg[NUM_ASYNC_FRAMEBUFFERS];               // Main thread only: range of rows in each framebuffer which are out of
+static uint32_t                 gStaleRowEnd[NUM_ASYNC_FRAMEBUFFERS];               // date compared to the last frame queued. Empty if 'beg >= end'.
+static int32_t                  gDrawFrameBufferIdx;                                // Main thread only: which framebuffer the game is drawing to
+static int32_t                  gLastQueuedFrameBufferIdx;                          // Main thread only: the last framebuffer queued, or '-1' if none
+static bool                     gbLastQueuedFrameIs16Bit;                           // Main thread only: whether the last frame queued was 16-bit
+static bool                     gbForceFullPresent;                                 // Main thread only: if set then present the next frame in full
+static bool                     gbStagedFramePending;                               // Main thread only: set if a queued frame has not been shown yet
+static uint32_t                 gStagedRowBeg;                                      // Main thread only: range of rows in the staging buffer which
+static uint32_t                 gStagedRowEnd;                                      // need to be uploaded to the texture for the pending frame.
+static int32_t                  gPrepFrameBufferIdx;                                // Framebuffer the frame prep thread should copy, or '-1' if none
+static uint32_t                 gPrepRowBeg;                                        // Range of rows the frame prep thread should copy
+static uint32_t                 gPrepRowEnd;
+static bool                     gbPrepFrameIs16Bit;                                 // Whether to do 16-bit framebuffer simulation when copying
+static bool                     gbFramePrepThreadQuit;                              // If set then the frame prep thread should exit
+
+// Offscreen backend: state
+static std::byte*               gpOffscreenFrameBufferMem;      // The memory allocation the aligned offscreen framebuffer lives in
+static std::string              gFrameDumpDirPath;              // Where to save presented frames to, or empty if not saving frames
+static uint32_t                 gFrameDumpInterval;             // Save every Nth presented frame
+static uint32_t                 gNumFramesPresented;            // Number of frames presented since frame saving was last setup
+static std::vector<std::byte>   gFrameDumpFileData;             // Buffer used to build up the file for a saved frame
+
 uint32_t    gScreenWidth;
 uint32_t    gScreenHeight;
 uint32_t    gVideoOutputWidth;
 uint32_t    gVideoOutputHeight;
 bool        gbIsFullscreen;
+bool        gbIsHeadless;
 uint32_t*   gpFrameBuffer;
 uint32_t*   gpSavedFrameBuffer;
 
@@ -32,16 +85,19 @@ static void unlockFramebufferTexture() noexcept {
     SDL_UnlockTexture(gFramebufferTexture);
 }
 
-static void determineTargetVideoMode() noexcept {
-    // Fullscreen mode and game render resolution
-    gbIsFullscreen = Config::gbFullscreen;
-
+static void determineRenderResolution() noexcept {
     if (Config::gRenderScale <= 0) {
         FATAL_ERROR_F("Invalid render scale '%u'!", Config::gRenderScale);
     }
 
     gScreenWidth = Config::gRenderScale * REFERENCE_SCREEN_WIDTH;
     gScreenHeight = Config::gRenderScale * REFERENCE_SCREEN_HEIGHT;
+}
+
+static void determineTargetVideoMode() noexcept {
+    // Fullscreen mode and game render resolution
+    gbIsFullscreen = Config::gbFullscreen;
+    determineRenderResolution();
 
     // Get the current screen resolution.
     // Note: MAY not be correct for multiple monitors, but a user can specify manually in those cases.
@@ -133,49 +189,328 @@ static void determineTargetVideoMode() noexcept {
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Truncates an XRGB8888 color as if it were stored as an XRGB1555 color, and converts back to XRGB8888.
 // Used for 16-bit framebuffer simulation.
+//
+// Note: expanding each 5-bit component back to 8-bits via '(c5 * 255) / 31' and then truncating to 5-bits again gives back the original
+// 5-bit component, so the whole conversion reduces to just masking off the low 3 bits of each component. Doing it this way avoids
+// divides and lets the compiler vectorize the loops which call this.
 //------------------------------------------------------------------------------------------------------------------------------------------
 static inline uint32_t truncateFramebufferColorTo16Bit(const uint32_t colorIn) noexcept {
-    uint32_t r = (colorIn & 0x00F80000);
-    uint32_t g = (colorIn & 0x0000F800);
-    uint32_t b = (colorIn & 0x000000F8);
-    r = ((r * 255) / 248) & 0x00F80000;
-    g = ((g * 255) / 248) & 0x0000F800;
-    b = ((b * 255) / 248) & 0x000000F8;
-    return (r | g | b);
+    return (colorIn & 0x00F8F8F8u);
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Truncates framebuffer colors to RGB555 - similar to the framebuffer format used by the original 3DO game
+// Truncates framebuffer colors to RGB555 - similar to the framebuffer format used by the original 3DO game.
+// Reads the given number of pixels from the source and writes the truncated colors to the destination, which may be the same memory.
 //------------------------------------------------------------------------------------------------------------------------------------------
-static void do16BitFramebufferSimulation() noexcept {
+static void do16BitFramebufferSimulation(const uint32_t* const pSrcPixels, uint32_t* const pDstPixels, const uint32_t numPixels) noexcept {
     // Truncate 8 pixels at a time first
-    const uint32_t numPixels = gScreenWidth * gScreenHeight;
     const uint32_t numPixels8 = (numPixels / 8u) * 8u;
 
-    uint32_t* pCurPixel = gpFrameBuffer;
-    uint32_t* const pEndPixel = gpFrameBuffer + numPixels;
-    uint32_t* const pEndPixel8 = gpFrameBuffer + numPixels8;
-
-    while (pCurPixel < pEndPixel8) {
-        pCurPixel[0] = truncateFramebufferColorTo16Bit(pCurPixel[0]);
-        pCurPixel[1] = truncateFramebufferColorTo16Bit(pCurPixel[1]);
-        pCurPixel[2] = truncateFramebufferColorTo16Bit(pCurPixel[2]);
-        pCurPixel[3] = truncateFramebufferColorTo16Bit(pCurPixel[3]);
-        pCurPixel[4] = truncateFramebufferColorTo16Bit(pCurPixel[4]);
-        pCurPixel[5] = truncateFramebufferColorTo16Bit(pCurPixel[5]);
-        pCurPixel[6] = truncateFramebufferColorTo16Bit(pCurPixel[6]);
-        pCurPixel[7] = truncateFramebufferColorTo16Bit(pCurPixel[7]);
-        pCurPixel += 8;
+    const uint32_t* pSrcPixel = pSrcPixels;
+    uint32_t* pDstPixel = pDstPixels;
+    uint32_t* const pEndPixel = pDstPixels + numPixels;
+    uint32_t* const pEndPixel8 = pDstPixels + numPixels8;
+
+    while (pDstPixel < pEndPixel8) {
+        pDstPixel[0] = truncateFramebufferColorTo16Bit(pSrcPixel[0]);
+        pDstPixel[1] = truncateFramebufferColorTo16Bit(pSrcPixel[1]);
+        pDstPixel[2] = truncateFramebufferColorTo16Bit(pSrcPixel[2]);
+        pDstPixel[3] = truncateFramebufferColorTo16Bit(pSrcPixel[3]);
+        pDstPixel[4] = truncateFramebufferColorTo16Bit(pSrcPixel[4]);
+        pDstPixel[5] = truncateFramebufferColorTo16Bit(pSrcPixel[5]);
+        pDstPixel[6] = truncateFramebufferColorTo16Bit(pSrcPixel[6]);
+        pDstPixel[7] = truncateFramebufferColorTo16Bit(pSrcPixel[7]);
+        pSrcPixel += 8;
+        pDstPixel += 8;
     }
 
     // Do the rest
-    while (pCurPixel < pEndPixel) {
-        pCurPixel[0] = truncateFramebufferColorTo16Bit(pCurPixel[0]);
-        ++pCurPixel;
+    while (pDstPixel < pEndPixel) {
+        pDstPixel[0] = truncateFramebufferColorTo16Bit(pSrcPixel[0]);
+        ++pSrcPixel;
+        ++pDstPixel;
     }
 }
 
-void init() noexcept {
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Main loop for the frame prep thread: copies the changed rows of each frame queued by the game into the staging buffer, doing 16-bit
+// framebuffer simulation if required, until told to quit. Never calls into SDL.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void framePrepThreadMain() noexcept {
+    while (true) {
+        int32_t frameBufferIdx;
+        uint32_t rowBeg;
+        uint32_t rowEnd;
+        bool bSimulate16Bit;
+
+        // Wait for a frame to copy or until told to quit
+        {
+            std::unique_lock<std::mutex> lock(gFramePrepMutex);
+            gFramePrepCondVar.wait(lock, []() noexcept { return (gbFramePrepThreadQuit || (gPrepFrameBufferIdx >= 0)); });
+
+            if (gbFramePrepThreadQuit)
+                break;
+
+            frameBufferIdx = gPrepFrameBufferIdx;
+            rowBeg = gPrepRowBeg;
+            rowEnd = gPrepRowEnd;
+            bSimulate16Bit = gbPrepFrameIs16Bit;
+        }
+
+        // Rows are stored contiguously in both buffers, so the whole range can be done in one go
+        const size_t pixelsOffset = (size_t) rowBeg * gScreenWidth;
+        const uint32_t numPixels = (rowEnd - rowBeg) * gScreenWidth;
+        const uint32_t* const pSrcPixels = gpAsyncFrameBuffers[frameBufferIdx] + pixelsOffset;
+        uint32_t* const pDstPixels = gpStagingFrameBuffer + pixelsOffset;
+
+        if (bSimulate16Bit) {
+            do16BitFramebufferSimulation(pSrcPixels, pDstPixels, numPixels);
+        } else {
+            std::memcpy(pDstPixels, pSrcPixels, numPixels * sizeof(uint32_t));
+        }
+
+        // Let the main thread know the frame is ready
+        {
+            std::lock_guard<std::mutex> lock(gFramePrepMutex);
+            gPrepFrameBufferIdx = -1;
+        }
+
+        gFramePrepCondVar.notify_all();
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Allocates the ring of framebuffers and the staging buffer for asynchronous presenting and starts up the frame prep thread
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void initAsyncPresent() noexcept {
+    // Allocate all the buffers in one block, with each aligned to the start of a cache line.
+    // The staging buffer goes after the ring of framebuffers.
+    const size_t numPixels = (size_t) gScreenWidth * gScreenHeight;
+    const size_t frameBufferSize = (numPixels * sizeof(uint32_t) + OFFSCREEN_FRAMEBUFFER_ALIGN - 1) & ~(OFFSCREEN_FRAMEBUFFER_ALIGN - 1);
+    gpAsyncFrameBuffersMem = new std::byte[frameBufferSize * (NUM_ASYNC_FRAMEBUFFERS + 1) + OFFSCREEN_FRAMEBUFFER_ALIGN];
+
+    const uintptr_t memAddr = (uintptr_t) gpAsyncFrameBuffersMem;
+    const uintptr_t alignedMemAddr = (memAddr + OFFSCREEN_FRAMEBUFFER_ALIGN - 1) & ~(OFFSCREEN_FRAMEBUFFER_ALIGN - 1);
+
+    for (uint32_t i = 0; i < NUM_ASYNC_FRAMEBUFFERS; ++i) {
+        gpAsyncFrameBuffers[i] = (uint32_t*)(alignedMemAddr + i * frameBufferSize);
+        std::memset(gpAsyncFrameBuffers[i], 0, numPixels * sizeof(uint32_t));
+        gStaleRowBeg[i] = 0;
+        gStaleRowEnd[i] = 0;
+    }
+
+    gpStagingFrameBuffer = (uint32_t*)(alignedMemAddr + NUM_ASYNC_FRAMEBUFFERS * frameBufferSize);
+    std::memset(gpStagingFrameBuffer, 0, numPixels * sizeof(uint32_t));
+
+    gDrawFrameBufferIdx = 0;
+    gLastQueuedFrameBufferIdx = -1;
+    gbLastQueuedFrameIs16Bit = false;
+    gbForceFullPresent = true;
+    gbStagedFramePending = false;
+    gStagedRowBeg = 0;
+    gStagedRowEnd = 0;
+    gPrepFrameBufferIdx = -1;
+    gPrepRowBeg = 0;
+    gPrepRowEnd = 0;
+    gbPrepFrameIs16Bit = false;
+    gbFramePrepThreadQuit = false;
+    gpFrameBuffer = gpAsyncFrameBuffers[0];
+
+    gFramePrepThread = std::thread(framePrepThreadMain);
+}
+
+static void shutdownAsyncPresent() noexcept {
+    // Tell the frame prep thread to quit and wait for it to finish up
+    {
+        std::lock_guard<std::mutex> lock(gFramePrepMutex);
+        gbFramePrepThreadQuit = true;
+    }
+
+    gFramePrepCondVar.notify_all();
+
+    if (gFramePrepThread.joinable()) {
+        gFramePrepThread.join();
+    }
+
+    delete[] gpAsyncFrameBuffersMem;
+    gpAsyncFrameBuffersMem = nullptr;
+    gpStagingFrameBuffer = nullptr;
+
+    for (uint32_t*& pFrameBuffer : gpAsyncFrameBuffers) {
+        pFrameBuffer = nullptr;
+    }
+
+    gDrawFrameBufferIdx = 0;
+    gLastQueuedFrameBufferIdx = -1;
+    gbStagedFramePending = false;
+    gPrepFrameBufferIdx = -1;
+    gbFramePrepThreadQuit = false;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Compares two frames and finds the range of rows which differ between them, scanning inwards from the top and bottom of the screen.
+// Returns 'false' if the frames are identical. Typically the scans stop almost immediately when the frame has changed a lot (3D view
+// etc.) so this is cheap during gameplay, while screens which are not changing get the full comparison and can then skip presenting.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool findChangedRows(
+    const uint32_t* const pOldFrame,
+    const uint32_t* const pNewFrame,
+    uint32_t& rowBegOut,
+    uint32_t& rowEndOut
+) noexcept {
+    const uint32_t screenWidth = gScreenWidth;
+    const uint32_t screenHeight = gScreenHeight;
+    const size_t rowSize = screenWidth * sizeof(uint32_t);
+
+    auto isRowChanged = [=](const uint32_t y) noexcept {
+        const size_t rowOffset = (size_t) y * screenWidth;
+        return (std::memcmp(pOldFrame + rowOffset, pNewFrame + rowOffset, rowSize) != 0);
+    };
+
+    uint32_t rowBeg = 0;
+
+    while ((rowBeg < screenHeight) && (!isRowChanged(rowBeg))) {
+        ++rowBeg;
+    }
+
+    if (rowBeg >= screenHeight)
+        return false;
+
+    uint32_t rowEnd = screenHeight;
+
+    while (!isRowChanged(rowEnd - 1)) {
+        --rowEnd;
+    }
+
+    rowBegOut = rowBeg;
+    rowEndOut = rowEnd;
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Waits for the frame prep thread to finish copying the last frame queued into the staging buffer, if it is not done already
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void waitForFramePrep() noexcept {
+    std::unique_lock<std::mutex> lock(gFramePrepMutex);
+    gFramePrepCondVar.wait(lock, []() noexcept { return (gPrepFrameBufferIdx < 0); });
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Main thread: uploads the changed rows of the last frame queued from the staging buffer to the framebuffer texture and presents it.
+// Does nothing if there is no frame waiting to be shown.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void showStagedFrame() noexcept {
+    if (!gbStagedFramePending)
+        return;
+
+    waitForFramePrep();
+    gbStagedFramePending = false;
+
+    // The staging buffer always holds the whole of the last frame queued, so if the texture contents might have been lost then just
+    // upload all of it instead of only the rows which changed.
+    if (gbForceFullPresent) {
+        gStagedRowBeg = 0;
+        gStagedRowEnd = gScreenHeight;
+    }
+
+    const uint32_t screenWidth = gScreenWidth;
+    const SDL_Rect updateRect = { 0, (int) gStagedRowBeg, (int) screenWidth, (int)(gStagedRowEnd - gStagedRowBeg) };
+    const uint32_t* const pSrcPixels = gpStagingFrameBuffer + (size_t) gStagedRowBeg * screenWidth;
+
+    // If the upload fails then the texture is now in an unknown state, so make sure the next frame gets uploaded in full.
+    // Otherwise the texture matches the last frame queued again and only changes from here on need to be uploaded.
+    gbForceFullPresent = (SDL_UpdateTexture(gFramebufferTexture, &updateRect, pSrcPixels, (int)(screenWidth * sizeof(uint32_t))) != 0);
+
+    SDL_RenderCopy(gRenderer, gFramebufferTexture, nullptr, &gOutputRect);
+    SDL_RenderPresent(gRenderer);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Main thread: shows the frame queued on the previous present, then hands off the framebuffer just drawn to the frame prep thread and
+// switches drawing to the next framebuffer in the ring. The frame prep thread copies the frame while the game draws the next one.
+//
+// Only the rows which changed since the last frame queued are copied and uploaded to the texture, and if nothing changed at all then
+// nothing new is queued and the game just keeps drawing to the same framebuffer. This makes static screens (menus etc.) almost free.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void presentAsync() noexcept {
+    // Show the frame queued last time: this also means the frame prep thread is idle after this point
+    showStagedFrame();
+
+    // Figure out what part of the frame needs to be updated.
+    // Note: the last framebuffer queued is never written to until after this frame has been queued, so it's safe to compare against.
+    const int32_t drawnFrameBufferIdx = gDrawFrameBufferIdx;
+    const bool bSimulate16Bit = Config::gbSimulate16BitFramebuffer;
+
+    uint32_t dirtyRowBeg = 0;
+    uint32_t dirtyRowEnd = gScreenHeight;
+    const bool bCompareToLastFrame = (
+        (!gbForceFullPresent) &&
+        (gLastQueuedFrameBufferIdx >= 0) &&
+        (bSimulate16Bit == gbLastQueuedFrameIs16Bit)
+    );
+
+    if (bCompareToLastFrame) {
+        const uint32_t* const pLastFrame = gpAsyncFrameBuffers[gLastQueuedFrameBufferIdx];
+
+        if (!findChangedRows(pLastFrame, gpFrameBuffer, dirtyRowBeg, dirtyRowEnd))
+            return;
+    }
+
+    gLastQueuedFrameBufferIdx = drawnFrameBufferIdx;
+    gbLastQueuedFrameIs16Bit = bSimulate16Bit;
+    gbForceFullPresent = false;
+
+    // Hand off the frame to the frame prep thread, to be shown on the next present
+    {
+        std::lock_guard<std::mutex> lock(gFramePrepMutex);
+        gPrepFrameBufferIdx = drawnFrameBufferIdx;
+        gPrepRowBeg = dirtyRowBeg;
+        gPrepRowEnd = dirtyRowEnd;
+        gbPrepFrameIs16Bit = bSimulate16Bit;
+    }
+
+    gFramePrepCondVar.notify_all();
+    gbStagedFramePending = true;
+    gStagedRowBeg = dirtyRowBeg;
+    gStagedRowEnd = dirtyRowEnd;
+
+    // The rows which changed are now out of date in every other framebuffer
+    for (uint32_t i = 0; i < NUM_ASYNC_FRAMEBUFFERS; ++i) {
+        if ((int32_t) i == drawnFrameBufferIdx) {
+            gStaleRowBeg[i] = 0;
+            gStaleRowEnd[i] = 0;
+        } else if (gStaleRowBeg[i] >= gStaleRowEnd[i]) {
+            gStaleRowBeg[i] = dirtyRowBeg;
+            gStaleRowEnd[i] = dirtyRowEnd;
+        } else {
+            gStaleRowBeg[i] = std::min(gStaleRowBeg[i], dirtyRowBeg);
+            gStaleRowEnd[i] = std::max(gStaleRowEnd[i], dirtyRowEnd);
+        }
+    }
+
+    // Game code expects the framebuffer contents to persist after presenting, so bring the out of date rows in the next framebuffer up
+    // to date with the frame just drawn. The frame prep thread only ever reads the queued framebuffer, so it's safe to read it here too.
+    const int32_t nextFrameBufferIdx = (drawnFrameBufferIdx + 1) % (int32_t) NUM_ASYNC_FRAMEBUFFERS;
+    const uint32_t staleRowBeg = gStaleRowBeg[nextFrameBufferIdx];
+    const uint32_t staleRowEnd = gStaleRowEnd[nextFrameBufferIdx];
+    uint32_t* const pNextFrameBuffer = gpAsyncFrameBuffers[nextFrameBufferIdx];
+
+    if (staleRowBeg < staleRowEnd) {
+        const size_t pixelsOffset = (size_t) staleRowBeg * gScreenWidth;
+        const size_t numPixels = (size_t)(staleRowEnd - staleRowBeg) * gScreenWidth;
+        std::memcpy(pNextFrameBuffer + pixelsOffset, gpAsyncFrameBuffers[drawnFrameBufferIdx] + pixelsOffset, numPixels * sizeof(uint32_t));
+    }
+
+    gStaleRowBeg[nextFrameBufferIdx] = 0;
+    gStaleRowEnd[nextFrameBufferIdx] = 0;
+    gDrawFrameBufferIdx = nextFrameBufferIdx;
+    gpFrameBuffer = pNextFrameBuffer;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Window backend: creates a window and presents to it using an SDL renderer and streaming texture
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void initWindowBackend() noexcept {
     // Initialize SDL subsystems
     if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
         FATAL_ERROR("Unable to initialize SDL!");
@@ -205,7 +540,11 @@ void init() noexcept {
     }
 
     // Create the renderer and framebuffer texture
-    gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    gRenderer = SDL_CreateRenderer(
+        gWindow,
+        -1,
+        (Config::gbVSync) ? SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC : SDL_RENDERER_ACCELERATED
+    );
 
     if (!gRenderer) {
         FATAL_ERROR("Failed to create renderer!");
@@ -227,22 +566,33 @@ void init() noexcept {
     SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 0);
     SDL_RenderClear(gRenderer);
 
-    // Immediately lock the framebuffer texture for updating
-    lockFramebufferTexture();
+    // Either draw to a ring of CPU framebuffers, or immediately lock the framebuffer texture for updating
+    gbAsyncPresent = Config::gbAsyncPresent;
 
-    // This can be used to take a screenshot for the screen wipe effect
-    gpSavedFrameBuffer = new uint32_t[(size_t) gScreenWidth * gScreenHeight];
+    if (gbAsyncPresent) {
+        initAsyncPresent();
+    } else {
+        lockFramebufferTexture();
+    }
 
     // Grab input and hide the cursor
     SDL_SetWindowGrab(gWindow, SDL_TRUE);
     SDL_ShowCursor(SDL_DISABLE);
 }
 
-void shutdown() noexcept {
-    delete[] gpSavedFrameBuffer;
-    gpSavedFrameBuffer = nullptr;
+static void shutdownWindowBackend() noexcept {
     gpFrameBuffer = nullptr;
-    
+
+    if (gbAsyncPresent) {
+        shutdownAsyncPresent();
+        gbAsyncPresent = false;
+    }
+
+    if (gFramebufferTexture) {
+        SDL_DestroyTexture(gFramebufferTexture);
+        gFramebufferTexture = nullptr;
+    }
+
     if (gRenderer) {
         SDL_DestroyRenderer(gRenderer);
         gRenderer = nullptr;
@@ -255,6 +605,119 @@ void shutdown() noexcept {
     }
 
     SDL_QuitSubSystem(SDL_INIT_VIDEO);
+}
+
+static void presentWindowBackend() noexcept {
+    if (gbAsyncPresent) {
+        presentAsync();
+        return;
+    }
+
+    unlockFramebufferTexture();
+    SDL_RenderCopy(gRenderer, gFramebufferTexture, nullptr, &gOutputRect);
+    SDL_RenderPresent(gRenderer);
+    lockFramebufferTexture();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Offscreen backend: there is no window or display and the framebuffer is just a plain block of aligned memory.
+// Presenting does nothing except optionally save the frame to disk.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void initOffscreenBackend() noexcept {
+    // No window in this mode, so the output size is just the render size
+    determineRenderResolution();
+    gVideoOutputWidth = gScreenWidth;
+    gVideoOutputHeight = gScreenHeight;
+    gbIsFullscreen = false;
+    gbIsHeadless = true;
+
+    // Allocate the framebuffer, aligned to the start of a cache line
+    const size_t numPixels = (size_t) gScreenWidth * gScreenHeight;
+    gpOffscreenFrameBufferMem = new std::byte[numPixels * sizeof(uint32_t) + OFFSCREEN_FRAMEBUFFER_ALIGN];
+
+    const uintptr_t frameBufferAddr = (uintptr_t) gpOffscreenFrameBufferMem;
+    const uintptr_t alignedFrameBufferAddr = (frameBufferAddr + OFFSCREEN_FRAMEBUFFER_ALIGN - 1) & ~(OFFSCREEN_FRAMEBUFFER_ALIGN - 1);
+    gpFrameBuffer = (uint32_t*) alignedFrameBufferAddr;
+    std::memset(gpFrameBuffer, 0, numPixels * sizeof(uint32_t));
+
+    gNumFramesPresented = 0;
+}
+
+static void shutdownOffscreenBackend() noexcept {
+    delete[] gpOffscreenFrameBufferMem;
+    gpOffscreenFrameBufferMem = nullptr;
+    gpFrameBuffer = nullptr;
+
+    gFrameDumpDirPath.clear();
+    gFrameDumpInterval = 0;
+    gNumFramesPresented = 0;
+    gFrameDumpFileData.clear();
+    gFrameDumpFileData.shrink_to_fit();
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Saves the framebuffer to the frame dump folder as a binary PPM image, with a file name based on the given frame number
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void dumpFrameToFile(const uint32_t frameNum) noexcept {
+    char header[64];
+    const int headerSize = std::snprintf(header, sizeof(header), "P6\n%u %u\n255\n", gScreenWidth, gScreenHeight);
+
+    const size_t numPixels = (size_t) gScreenWidth * gScreenHeight;
+    gFrameDumpFileData.resize((size_t) headerSize + numPixels * 3);
+    std::memcpy(gFrameDumpFileData.data(), header, (size_t) headerSize);
+
+    // Convert the framebuffer from XRGB8888 to RGB888
+    const uint32_t* const pSrcPixels = gpFrameBuffer;
+    std::byte* pDstBytes = gFrameDumpFileData.data() + headerSize;
+
+    for (size_t i = 0; i < numPixels; ++i) {
+        const uint32_t color = pSrcPixels[i];
+        pDstBytes[0] = (std::byte)(color >> 16);
+        pDstBytes[1] = (std::byte)(color >> 8);
+        pDstBytes[2] = (std::byte)(color);
+        pDstBytes += 3;
+    }
+
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "frame_%06u.ppm", frameNum);
+    const std::string filePath = gFrameDumpDirPath + fileName;
+
+    if (!FileUtils::writeDataToFile(filePath.c_str(), gFrameDumpFileData.data(), gFrameDumpFileData.size())) {
+        std::fprintf(stderr, "Failed to save frame to '%s'!\n", filePath.c_str());
+    }
+}
+
+static void presentOffscreenBackend() noexcept {
+    const uint32_t frameNum = gNumFramesPresented++;
+
+    if ((!gFrameDumpDirPath.empty()) && (frameNum % gFrameDumpInterval == 0)) {
+        dumpFrameToFile(frameNum);
+    }
+}
+
+void init() noexcept {
+    initWindowBackend();
+
+    // This can be used to take a screenshot for the screen wipe effect
+    gpSavedFrameBuffer = new uint32_t[(size_t) gScreenWidth * gScreenHeight];
+}
+
+void initHeadless() noexcept {
+    initOffscreenBackend();
+
+    // This can be used to take a screenshot for the screen wipe effect
+    gpSavedFrameBuffer = new uint32_t[(size_t) gScreenWidth * gScreenHeight];
+}
+
+void shutdown() noexcept {
+    delete[] gpSavedFrameBuffer;
+    gpSavedFrameBuffer = nullptr;
+
+    if (gbIsHeadless) {
+        shutdownOffscreenBackend();
+    } else {
+        shutdownWindowBackend();
+    }
 
     gScreenWidth = 0;
     gScreenHeight = 0;
@@ -262,6 +725,18 @@ void shutdown() noexcept {
     gVideoOutputHeight = 0;
     gOutputRect = {};
     gbIsFullscreen = false;
+    gbIsHeadless = false;
+}
+
+void setFrameDumping(const char* const dirPath, const uint32_t frameInterval) noexcept {
+    gFrameDumpDirPath = (dirPath) ? dirPath : "";
+    gFrameDumpInterval = std::max(frameInterval, 1u);
+    gNumFramesPresented = 0;
+
+    // Make sure the folder path ends in a separator
+    if ((!gFrameDumpDirPath.empty()) && (gFrameDumpDirPath.back() != '/') && (gFrameDumpDirPath.back() != '\\')) {
+        gFrameDumpDirPath += '/';
+    }
 }
 
 void clearScreen(const uint8_t r, const uint8_t g, const uint8_t b) noexcept {
@@ -314,66 +789,29 @@ SDL_Window* getWindow() noexcept {
     return gWindow;
 }
 
+void requestFullPresent() noexcept {
+    gbForceFullPresent = true;
+}
+
 void saveFrameBuffer() noexcept {
     ASSERT(gpSavedFrameBuffer);
     ASSERT(gpFrameBuffer);
-
-    // Note: the output framebuffer is saved in column major format.
-    // This allows us to do screen wipes more efficiently due to better cache usage.
-    const uint32_t screenWidth = gScreenWidth;
-    const uint32_t screenWidth8 = (screenWidth / 8) * 8;
-    const uint32_t screenHeight = gScreenHeight;
-
-    for (uint32_t y = 0; y < screenHeight; ++y) {
-        const uint32_t* const pSrcRow = &gpFrameBuffer[y * screenWidth];
-        uint32_t* const pDstRow = &gpSavedFrameBuffer[y];
-
-        // Copy 8 pixels at a time, then mop up the rest
-        for (uint32_t x = 0; x < screenWidth8; x += 8) {
-            const uint32_t x1 = x + 0;
-            const uint32_t x2 = x + 1;
-            const uint32_t x3 = x + 2;
-            const uint32_t x4 = x + 3;
-            const uint32_t x5 = x + 4;
-            const uint32_t x6 = x + 5;
-            const uint32_t x7 = x + 6;
-            const uint32_t x8 = x + 7;
-
-            const uint32_t pix1 = pSrcRow[x1];
-            const uint32_t pix2 = pSrcRow[x2];
-            const uint32_t pix3 = pSrcRow[x3];
-            const uint32_t pix4 = pSrcRow[x4];
-            const uint32_t pix5 = pSrcRow[x5];
-            const uint32_t pix6 = pSrcRow[x6];
-            const uint32_t pix7 = pSrcRow[x7];
-            const uint32_t pix8 = pSrcRow[x8];
-
-            pDstRow[x1 * screenHeight] = pix1;
-            pDstRow[x2 * screenHeight] = pix2;
-            pDstRow[x3 * screenHeight] = pix3;
-            pDstRow[x4 * screenHeight] = pix4;
-            pDstRow[x5 * screenHeight] = pix5;
-            pDstRow[x6 * screenHeight] = pix6;
-            pDstRow[x7 * screenHeight] = pix7;
-            pDstRow[x8 * screenHeight] = pix8;
-        }
-
-        for (uint32_t x = screenWidth8; x < screenWidth; x++) {
-            const uint32_t pix = pSrcRow[x];
-            pDstRow[x * screenHeight] = pix;
-        }
-    }
+    std::memcpy(gpSavedFrameBuffer, gpFrameBuffer, (size_t) gScreenWidth * gScreenHeight * sizeof(uint32_t));
 }
 
 void present() noexcept {
-    if (Config::gbSimulate16BitFramebuffer) {
-        do16BitFramebufferSimulation();
+    PROFILE_ZONE("Present");
+
+    // Note: when presenting asynchronously this is done by the frame prep thread instead, as it copies the frame for upload
+    if (Config::gbSimulate16BitFramebuffer && (!gbAsyncPresent)) {
+        do16BitFramebufferSimulation(gpFrameBuffer, gpFrameBuffer, gScreenWidth * gScreenHeight);
     }
 
-    unlockFramebufferTexture();
-    SDL_RenderCopy(gRenderer, gFramebufferTexture, nullptr, &gOutputRect);
-    SDL_RenderPresent(gRenderer);
-    lockFramebufferTexture();
+    if (gbIsHeadless) {
+        presentOffscreenBackend();
+    } else {
+        presentWindowBackend();
+    }
 }
 
 void endFrame(const bool bPresent, const bool bSaveFrameBuffer) noexcept {
@@ -25,14 +25,23 @@ extern uint32_t gVideoOutputHeight;
 extern bool gbIsFullscreen;
 
 // The 32-bit framebuffer to draw to and a saved old copy of it (for screen wipes).
-// N.B: The saved framebuffer is in COLUMN MAJOR format for more efficient cache usage during wipes.
+// Both framebuffers are in row major format.
 extern uint32_t* gpFrameBuffer;
 extern uint32_t* gpSavedFrameBuffer;
 
-// Create and destroy the display
+// If true then the offscreen backend is in use: there is no window or display and the framebuffer is just a plain block of aligned
+// memory. Presenting does nothing in this mode except optionally save frames to disk. Used for benchmarking on machines with no display.
+extern bool gbIsHeadless;
+
+// Create and destroy the display, using either a window or the offscreen backend
 void init() noexcept;
+void initHeadless() noexcept;
 void shutdown() noexcept;
 
+// Offscreen backend only: save every Nth presented frame to the given folder as a PPM image, named by the frame number.
+// Passing a null or empty folder path stops frames being saved.
+void setFrameDumping(const char* const dirPath, const uint32_t frameInterval) noexcept;
+
 // Clear the screen to the specified RGB color   
 void clearScreen(const uint8_t r, const uint8_t g, const uint8_t b) noexcept;
 
@@ -43,6 +52,10 @@ void debugClearScreen() noexcept;
 // Get a handle to the underlying SDL window
 SDL_Window* getWindow() noexcept;
 
+// Makes the next present upload and show the entire frame, even if nothing has changed since the last frame.
+// Frames which are unchanged are normally not presented at all, so this should be called if the window contents are lost.
+void requestFullPresent() noexcept;
+
 // Saves a copy of the current framebuffer to the 'saved' framebuffer.
 // This should be done prior to calling 'present'.
 void saveFrameBuffer() noexcept;
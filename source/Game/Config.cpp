@@ -3,6 +3,7 @@
 #include "Base/FileUtils.h"
 #include "Base/Finally.h"
 #include "Base/IniUtils.h"
+#include "Demo.h"
 #include "DoomDefines.h"
 
 #include <algorithm>
@@ -59,6 +60,16 @@ CDImagePath = Doom3DO.img
 UseDataDirectory = 0
 DataDirectoryPath = C:\Users\<MY_NAME>\<WHATEVER>\Doom3DO_DiscExtracted
 
+#---------------------------------------------------------------------------------------------------
+# Whether to use precomputed 'potentially visible set' (PVS) files for maps, if available.
+# A PVS file records which parts of a map can possibly be seen from each other part. It is used to
+# skip drawing and sight checks for areas of the map that are guaranteed to be hidden.
+#
+# PVS files are made by running the 'PhoenixDoomPvsTool' program and are saved alongside the
+# game's save files. Files which don't match the current game data are ignored.
+#---------------------------------------------------------------------------------------------------
+UseMapPvsFiles = 1
+
 )";
 
 static constexpr const char* const DEFAULT_CONFIG_INI_SECTION_3 =
@@ -137,6 +148,23 @@ IntegerOutputScaling = 0
 #---------------------------------------------------------------------------------------------------
 AspectCorrectOutputScaling = 1
 
+#---------------------------------------------------------------------------------------------------
+# If set to '1' (enabled) then presenting frames is synced to the display refresh (vsync).
+# Disabling this can cause tearing but is useful for measuring how fast frames can actually be
+# drawn, since frame times are otherwise rounded up to the display refresh interval.
+#---------------------------------------------------------------------------------------------------
+VSync = 1
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' (enabled) then the game draws to a ring of 3 framebuffers and each finished frame
+# is copied and converted for upload on a separate thread, while the game carries on with the
+# next frame. Presenting and waiting for vsync still happen on the game thread, and frames are
+# shown one present later than usual, so this is only useful if copying and converting frames
+# (e.g. with 16-bit framebuffer simulation at high render scales) is a bottleneck.
+# Set to '0' (the default) to draw straight into the framebuffer texture on the game thread.
+#---------------------------------------------------------------------------------------------------
+AsyncPresent = 0
+
 )";
 
 static constexpr const char* const DEFAULT_CONFIG_INI_SECTION_4 =
@@ -158,6 +186,92 @@ Simulate16BitFramebuffer = 0
 #---------------------------------------------------------------------------------------------------
 DoFakeContrast = 1
 
+#---------------------------------------------------------------------------------------------------
+# How many threads to use for drawing the 3D view. The view is split up into vertical bands of
+# screen columns and each thread draws one band. This can help greatly at higher render scales.
+# If set to '0' (auto) then the game will use as many threads as there are CPU cores/threads.
+# Set to '1' to draw everything on the main game thread only. The maximum allowed value is '32'.
+#---------------------------------------------------------------------------------------------------
+RenderThreadCount = 0
+
+#---------------------------------------------------------------------------------------------------
+# Controls how accurately floors and ceilings are drawn, trading quality for speed.
+# If set to '1' then lighting and texture coordinates are computed exactly for every pixel.
+# Otherwise lighting is computed exactly only every 'N' pixels of each floor or ceiling column, and
+# smoothly blended in between. Values of '8' or '16' are much faster and look almost identical.
+# The maximum allowed value is '64'.
+#---------------------------------------------------------------------------------------------------
+FlatDrawSpanLength = 1
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' and 'FlatDrawSpanLength' is greater than '1', then floor and ceiling texture
+# coordinates are also blended linearly between the exactly computed pixels rather than being
+# computed exactly for every pixel. This is faster again but causes some texture warping, which is
+# mostly noticeable on distant floors and ceilings with larger span lengths.
+#---------------------------------------------------------------------------------------------------
+FlatDrawAffineTexturing = 0
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' then wall, floor and sprite textures are also stored in a 32-bit color format when
+# loaded, alongside the original 16-bit color version. This makes rendering faster since texture
+# colors don't need to be unpacked for every pixel drawn, at the cost of a few extra MB of memory.
+# There is no difference in how the game looks with this setting on or off.
+#---------------------------------------------------------------------------------------------------
+PreExpandTextures = 1
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' then drawing the 3D view is overlapped with simulating the next game tick.
+# The walls, floors and sprites to draw are gathered up from the game state as usual, but the view is
+# then drawn by the render threads while the game carries on to the next tick. This can give a good
+# speedup on machines with multiple CPU cores, at the cost of one extra frame of display latency.
+#---------------------------------------------------------------------------------------------------
+PipelinedRendering = 0
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' then the renderer remembers which parts of the map are always on or off screen while
+# the view stays within the same part of the map and roughly the same view angle. This saves some
+# work when finding which walls and floors to draw, which can help in large and detailed maps.
+# There is no difference in how the game looks with this setting on or off.
+#---------------------------------------------------------------------------------------------------
+BspVisibilityCache = 0
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' then sprites are drawn from nearest to furthest away rather than the other way around,
+# skipping any pixels that nearer sprites have already covered. This can save some work when many
+# monsters or items overlap on screen. Frames containing see-through sprites are always drawn from
+# back to front. There is no difference in how the game looks with this setting on or off.
+#---------------------------------------------------------------------------------------------------
+FrontToBackSprites = 0
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' then the renderer keeps track of which parts of the screen are already completely
+# covered by nearer walls, floors and ceilings, and skips parts of the map and sprites which are
+# hidden behind them. This saves work in maps with long views which are broken up by large walls.
+# Parts of the map are only skipped if they would stay hidden even when widened by the largest
+# distance any sprite extends to the side of its position, so things standing just out of view
+# are still drawn when part of them pokes out into view.
+#---------------------------------------------------------------------------------------------------
+OcclusionCulling = 1
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' then the 3D view is drawn at a lower resolution when it is taking too long to draw,
+# and then scaled up to fill the view. The resolution is adjusted continuously to keep the time
+# taken to draw the 3D view close to the target below. The status bar, weapon and menus are always
+# drawn at the full render resolution.
+#---------------------------------------------------------------------------------------------------
+DynamicResolution = 0
+
+#---------------------------------------------------------------------------------------------------
+# Dynamic resolution only: the target time in milliseconds to draw the 3D view in.
+#---------------------------------------------------------------------------------------------------
+DynamicResolutionTargetMs = 8.0
+
+#---------------------------------------------------------------------------------------------------
+# Dynamic resolution only: the lowest resolution the 3D view is allowed to drop to, as a percentage
+# of the full render resolution in each direction (1-100).
+#---------------------------------------------------------------------------------------------------
+DynamicResolutionMinScale = 50
+
 )";
 
 static constexpr const char* const DEFAULT_CONFIG_INI_SECTION_5 =
@@ -326,6 +440,22 @@ AllowCameraUpDownMovement = 0
 #---------------------------------------------------------------------------------------------------
 PerfCounterNumFramesToAverage = 15
 
+#---------------------------------------------------------------------------------------------------
+# If set to '1' or '2' then a demo is recorded of the first level played in each new game and saved
+# to that demo slot, overwriting any previous demo. Demos record all inputs for the level and can be
+# played back exactly by the benchmark program. Cheats are disabled while recording.
+# Set to '0' to disable demo recording.
+#---------------------------------------------------------------------------------------------------
+RecordDemoSlot = 0
+
+#---------------------------------------------------------------------------------------------------
+# If set to '1' then the frame profiler records all the time, rather than just while its breakdown
+# is shown (the last mode of the performance counter toggle). On exit the recent history of profiler
+# zones is saved to 'profile.csv' and 'profile_trace.json' in the same folder as the game prefs.
+# The trace file can be viewed with 'chrome://tracing' or similar tools.
+#---------------------------------------------------------------------------------------------------
+EnableProfiler = 0
+
 ####################################################################################################
 [CheatKeySequences]
 ####################################################################################################
@@ -561,14 +691,28 @@ static std::string gTmpActionStr;   // Re-use this buffer during parsing to prev
 std::string                 gGameDataCDImagePath;
 bool                        gbUseGameDataDirectory;
 std::string                 gGameDataDirectoryPath;
+bool                        gbUseMapPvsFiles;
 bool                        gbFullscreen;
 uint32_t                    gRenderScale;
 int32_t                     gOutputResolutionW;
 int32_t                     gOutputResolutionH;
 bool                        gbIntegerOutputScaling;
 bool                        gbAspectCorrectOutputScaling;
+bool                        gbVSync;
+bool                        gbAsyncPresent;
 bool                        gbSimulate16BitFramebuffer;
 bool                        gbDoFakeContrast;
+uint32_t                    gRenderThreadCount;
+uint32_t                    gFlatDrawSpanLength;
+bool                        gbFlatDrawAffineTexturing;
+bool                        gbPreExpandTextures;
+bool                        gbPipelinedRendering;
+bool                        gbBspVisibilityCache;
+bool                        gbFrontToBackSprites;
+bool                        gbOcclusionCulling;
+bool                        gbDynamicResolution;
+float                       gDynamicResolutionTargetMs;
+uint32_t                    gDynamicResolutionMinScale;
 float                       gInputAnalogToDigitalThreshold;
 bool                        gbDefaultAlwaysRun;
 Controls::MenuActionBits    gKeyboardMenuActions[Input::NUM_KEYBOARD_KEYS];
@@ -585,6 +729,8 @@ Controls::GameActionBits    gGamepadGameActions[NUM_CONTROLLER_INPUTS];
 Controls::AxisBits          gGamepadAxisBindings[NUM_CONTROLLER_INPUTS];
 bool                        gbAllowDebugCameraUpDownMovement;
 uint32_t                    gPerfCounterNumFramesToAverage;
+uint32_t                    gRecordDemoSlot;
+bool                        gbEnableProfiler;
 CheatKeySequence            gCheatKeys_GodMode;
 CheatKeySequence            gCheatKeys_NoClip;
 CheatKeySequence            gCheatKeys_MapAndThingsRevealToggle;
@@ -1035,6 +1181,9 @@ static void handleConfigEntry(const IniUtils::Entry& entry) noexcept {
         else if (entry.key == "DataDirectoryPath") {
             gGameDataDirectoryPath = entry.value;
         }
+        else if (entry.key == "UseMapPvsFiles") {
+            gbUseMapPvsFiles = entry.getBoolValue(gbUseMapPvsFiles);
+        }
     }
     else if (entry.section == "Video") {
         if (entry.key == "Fullscreen") {
@@ -1055,6 +1204,12 @@ static void handleConfigEntry(const IniUtils::Entry& entry) noexcept {
         else if (entry.key == "AspectCorrectOutputScaling") {
             gbAspectCorrectOutputScaling = entry.getBoolValue(gbAspectCorrectOutputScaling);
         }
+        else if (entry.key == "VSync") {
+            gbVSync = entry.getBoolValue(gbVSync);
+        }
+        else if (entry.key == "AsyncPresent") {
+            gbAsyncPresent = entry.getBoolValue(gbAsyncPresent);
+        }
     }
     else if (entry.section == "Graphics") {
         if (entry.key == "Simulate16BitFramebuffer") {
@@ -1063,6 +1218,39 @@ static void handleConfigEntry(const IniUtils::Entry& entry) noexcept {
         else if (entry.key == "DoFakeContrast") {
             gbDoFakeContrast = entry.getBoolValue(gbDoFakeContrast);
         }
+        else if (entry.key == "RenderThreadCount") {
+            gRenderThreadCount = entry.getUintValue(gRenderThreadCount);
+        }
+        else if (entry.key == "FlatDrawSpanLength") {
+            gFlatDrawSpanLength = std::min(std::max(entry.getUintValue(gFlatDrawSpanLength), 1u), 64u);
+        }
+        else if (entry.key == "FlatDrawAffineTexturing") {
+            gbFlatDrawAffineTexturing = entry.getBoolValue(gbFlatDrawAffineTexturing);
+        }
+        else if (entry.key == "PreExpandTextures") {
+            gbPreExpandTextures = entry.getBoolValue(gbPreExpandTextures);
+        }
+        else if (entry.key == "PipelinedRendering") {
+            gbPipelinedRendering = entry.getBoolValue(gbPipelinedRendering);
+        }
+        else if (entry.key == "BspVisibilityCache") {
+            gbBspVisibilityCache = entry.getBoolValue(gbBspVisibilityCache);
+        }
+        else if (entry.key == "FrontToBackSprites") {
+            gbFrontToBackSprites = entry.getBoolValue(gbFrontToBackSprites);
+        }
+        else if (entry.key == "OcclusionCulling") {
+            gbOcclusionCulling = entry.getBoolValue(gbOcclusionCulling);
+        }
+        else if (entry.key == "DynamicResolution") {
+            gbDynamicResolution = entry.getBoolValue(gbDynamicResolution);
+        }
+        else if (entry.key == "DynamicResolutionTargetMs") {
+            gDynamicResolutionTargetMs = entry.getFloatValue(gDynamicResolutionTargetMs);
+        }
+        else if (entry.key == "DynamicResolutionMinScale") {
+            gDynamicResolutionMinScale = std::min(std::max(entry.getUintValue(gDynamicResolutionMinScale), 1u), 100u);
+        }
     }
     else if (entry.section == "InputGeneral") {
         if (entry.key == "AnalogToDigitalThreshold") {
@@ -1115,6 +1303,12 @@ static void handleConfigEntry(const IniUtils::Entry& entry) noexcept {
         else if (entry.key == "PerfCounterNumFramesToAverage") {
             gPerfCounterNumFramesToAverage = std::max(entry.getUintValue(gPerfCounterNumFramesToAverage), 1u);
         }
+        else if (entry.key == "RecordDemoSlot") {
+            gRecordDemoSlot = std::min(entry.getUintValue(gRecordDemoSlot), Demo::NUM_SLOTS);
+        }
+        else if (entry.key == "EnableProfiler") {
+            gbEnableProfiler = entry.getBoolValue(gbEnableProfiler);
+        }
     }
     else if (entry.section == "CheatKeySequences") {
         parseCheatKeySequence(entry.key, entry.value.c_str());
@@ -1128,6 +1322,7 @@ static void clear() noexcept {
     gGameDataCDImagePath = "Doom3DO.img";
     gbUseGameDataDirectory = false;
     gGameDataDirectoryPath.clear();
+    gbUseMapPvsFiles = true;
 
     gbFullscreen = true;
     gRenderScale = 1;
@@ -1135,9 +1330,22 @@ static void clear() noexcept {
     gOutputResolutionH = -1;
     gbIntegerOutputScaling = true;
     gbAspectCorrectOutputScaling = true;
+    gbVSync = true;
+    gbAsyncPresent = false;
 
     gbSimulate16BitFramebuffer = false;
     gbDoFakeContrast = true;
+    gRenderThreadCount = 0;
+    gFlatDrawSpanLength = 1;
+    gbFlatDrawAffineTexturing = false;
+    gbPreExpandTextures = true;
+    gbPipelinedRendering = false;
+    gbBspVisibilityCache = false;
+    gbFrontToBackSprites = false;
+    gbOcclusionCulling = true;
+    gbDynamicResolution = false;
+    gDynamicResolutionTargetMs = 8.0f;
+    gDynamicResolutionMinScale = 50;
 
     gInputAnalogToDigitalThreshold = 0.5f;
     gbDefaultAlwaysRun = false;
@@ -1159,6 +1367,8 @@ static void clear() noexcept {
     
     gbAllowDebugCameraUpDownMovement = false;
     gPerfCounterNumFramesToAverage = 15;
+    gRecordDemoSlot = 0;
+    gbEnableProfiler = false;
 
     setCheatKeySequence(gCheatKeys_GodMode,                     "IDDQD");
     setCheatKeySequence(gCheatKeys_NoClip,                      "IDCLIP");
@@ -10,6 +10,7 @@ BEGIN_NAMESPACE(Config)
 extern std::string  gGameDataCDImagePath;
 extern bool         gbUseGameDataDirectory;
 extern std::string  gGameDataDirectoryPath;
+extern bool         gbUseMapPvsFiles;
 
 // Video settings
 extern bool         gbFullscreen;
@@ -18,10 +19,23 @@ extern int32_t      gOutputResolutionW;
 extern int32_t      gOutputResolutionH;
 extern bool         gbIntegerOutputScaling;
 extern bool         gbAspectCorrectOutputScaling;
+extern bool         gbVSync;
+extern bool         gbAsyncPresent;
 
 // Graphics settings
 extern bool     gbSimulate16BitFramebuffer;
 extern bool     gbDoFakeContrast;
+extern uint32_t gRenderThreadCount;
+extern uint32_t gFlatDrawSpanLength;
+extern bool     gbFlatDrawAffineTexturing;
+extern bool     gbPreExpandTextures;
+extern bool     gbPipelinedRendering;
+extern bool     gbBspVisibilityCache;
+extern bool     gbFrontToBackSprites;
+extern bool     gbOcclusionCulling;
+extern bool     gbDynamicResolution;
+extern float    gDynamicResolutionTargetMs;
+extern uint32_t gDynamicResolutionMinScale;
 
 // Input general settings
 extern float    gInputAnalogToDigitalThreshold;
@@ -48,6 +62,8 @@ extern Controls::AxisBits           gGamepadAxisBindings[NUM_CONTROLLER_INPUTS];
 // Debug stuff
 extern bool         gbAllowDebugCameraUpDownMovement;
 extern uint32_t     gPerfCounterNumFramesToAverage;
+extern uint32_t     gRecordDemoSlot;
+extern bool         gbEnableProfiler;
 
 // Cheat key sequences: an array of up to 16 SDL scan codes.
 // Unused key slots in the sequence will be set to '0'.
@@ -310,6 +310,47 @@ void update() noexcept {
     updateAxesFromControllerInput();
 }
 
+void overrideGameActions(const GameActionBits gameActions) noexcept {
+    const GameActionBits prevGameActions = gGameActionsActive;
+    clearAllInputs();
+
+    gGameActionsActive = gameActions;
+    gGameActionsJustStarted = gameActions & (~prevGameActions);
+    gGameActionsJustEnded = prevGameActions & (~gameActions);
+}
+
+void getInputState(InputState& state) noexcept {
+    state.gameActionsActive = gGameActionsActive;
+    state.gameActionsJustStarted = gGameActionsJustStarted;
+    state.gameActionsJustEnded = gGameActionsJustEnded;
+    state.menuActionsActive = gMenuActionsActive;
+    state.menuActionsJustStarted = gMenuActionsJustStarted;
+    state.menuActionsJustEnded = gMenuActionsJustEnded;
+    state.axisValues[0] = gAxis_TurnLeftRight;
+    state.axisValues[1] = gAxis_MoveForwardBack;
+    state.axisValues[2] = gAxis_StrafeLeftRight;
+    state.axisValues[3] = gAxis_AutomapZoomInOut;
+    state.axisValues[4] = gAxis_MenuUpDown;
+    state.axisValues[5] = gAxis_MenuLeftRight;
+    state.axisValues[6] = gAxis_WeaponNextPrev;
+}
+
+void setInputState(const InputState& state) noexcept {
+    gGameActionsActive = state.gameActionsActive;
+    gGameActionsJustStarted = state.gameActionsJustStarted;
+    gGameActionsJustEnded = state.gameActionsJustEnded;
+    gMenuActionsActive = state.menuActionsActive;
+    gMenuActionsJustStarted = state.menuActionsJustStarted;
+    gMenuActionsJustEnded = state.menuActionsJustEnded;
+    gAxis_TurnLeftRight = state.axisValues[0];
+    gAxis_MoveForwardBack = state.axisValues[1];
+    gAxis_StrafeLeftRight = state.axisValues[2];
+    gAxis_AutomapZoomInOut = state.axisValues[3];
+    gAxis_MenuUpDown = state.axisValues[4];
+    gAxis_MenuLeftRight = state.axisValues[5];
+    gAxis_WeaponNextPrev = state.axisValues[6];
+}
+
 void gatherAnalogAndDigitalMenuMovements(int32_t& menuMoveX, int32_t& menuMoveY) noexcept {
     // Gather the inputs
     float menuMoveXF = INPUT_AXIS(MENU_LEFT_RIGHT);
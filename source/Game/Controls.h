@@ -100,6 +100,21 @@ namespace Axis {
     #define INPUT_AXIS(NAME) Controls::Axis::getValue(Controls::Axis::NAME)
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A snapshot of all the digital actions and analog axes for one tick: used to record and play back demos
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t NUM_AXES = 7;
+
+struct InputState {
+    GameActionBits  gameActionsActive;
+    GameActionBits  gameActionsJustStarted;
+    GameActionBits  gameActionsJustEnded;
+    MenuActionBits  menuActionsActive;
+    MenuActionBits  menuActionsJustStarted;
+    MenuActionBits  menuActionsJustEnded;
+    float           axisValues[NUM_AXES];       // In the same order as the bits in 'Axis', lowest bit first
+};
+
 // Startup and shutdown control processing
 void init() noexcept;
 void shutdown() noexcept;
@@ -107,6 +122,16 @@ void shutdown() noexcept;
 // Updates what actions are currently active, have just been activated or deactivated
 void update() noexcept;
 
+// Replaces the currently active game actions with the given actions, as if they had come from real user input.
+// Actions 'just started' and 'just ended' are determined from the previously active actions. All analog axes are cleared.
+// Used to drive the game from scripted input, for example when benchmarking.
+void overrideGameActions(const GameActionBits gameActions) noexcept;
+
+// Save or restore the state of all actions and axes.
+// Restoring the state replaces all current input, as if it had come from real user input.
+void getInputState(InputState& state) noexcept;
+void setInputState(const InputState& state) noexcept;
+
 // Helper that gathers menu movements (up/down, left/right) from digital and analog sources.
 // The X and Y movement values returned will range from -1 to +1.
 void gatherAnalogAndDigitalMenuMovements(int32_t& menuMoveX, int32_t& menuMoveY) noexcept;
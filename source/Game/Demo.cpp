@@ -0,0 +1,445 @@
+#include "Demo.h"
+
+#include "Base/ByteInputStream.h"
+#include "Base/FileUtils.h"
+#include "Base/Finally.h"
+#include "Base/Random.h"
+#include "Base/Resource.h"
+#include "Controls.h"
+#include "Data.h"
+#include "DoomDefines.h"
+#include "DoomRez.h"
+#include "Resources.h"
+#include "Things/Player.h"
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <SDL.h>
+
+BEGIN_NAMESPACE(Demo)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Demo file format.
+// All values are little endian. The file starts with a header, which is followed by the encoded inputs for each tick.
+//
+// For each tick a varint (7 bits per byte, high bit set if more bytes follow) is written containing a bit mask of the input fields that
+// changed since the previous tick. For each changed field a varint follows with the difference to the previous value. Action bits and
+// axis values are differenced with XOR, movement amounts with subtraction and then zig-zag encoded so small negative numbers stay small.
+// Ticks where nothing changed are therefore just a single byte.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t DEMO_FILE_ID = 0x4F4D4450u;    // 'PDMO'
+static constexpr uint32_t DEMO_FILE_VERSION = 1;
+
+struct DemoFileHeader {
+    uint32_t    fileId;
+    uint32_t    version;
+    uint32_t    mapNum;
+    uint32_t    skill;
+    uint32_t    randomSeed;
+    uint32_t    numTicks;
+};
+
+static_assert(sizeof(DemoFileHeader) == 24);
+
+// Fields of input captured for each tick, in the order they are written
+enum TickField : uint32_t {
+    FIELD_GAME_ACTIONS_ACTIVE,
+    FIELD_GAME_ACTIONS_JUST_STARTED,
+    FIELD_GAME_ACTIONS_JUST_ENDED,
+    FIELD_MENU_ACTIONS_ACTIVE,
+    FIELD_MENU_ACTIONS_JUST_STARTED,
+    FIELD_MENU_ACTIONS_JUST_ENDED,
+    FIELD_AXIS_VALUES,
+    FIELD_ANGLE_TURN = FIELD_AXIS_VALUES + Controls::NUM_AXES,
+    FIELD_FORWARD_MOVE,
+    FIELD_SIDE_MOVE,
+    NUM_TICK_FIELDS
+};
+
+static_assert(NUM_TICK_FIELDS <= 32);
+
+// Input for one tick: all fields are stored as 32-bit unsigned integers (floats as their raw bits)
+struct TickInput {
+    uint32_t fields[NUM_TICK_FIELDS];
+};
+
+static bool                     gbIsRecording;
+static bool                     gbIsPlaying;
+static uint32_t                 gRecordSlot;
+static DemoInfo                 gDemoInfo;
+static TickInput                gCurTickInput;          // Input for the current tick being recorded or played back
+static TickInput                gPrevTickInput;         // Input for the previous tick: for delta encoding and decoding
+static bool                     gbHaveCurTickInput;     // Recording: true if there is input for the current tick which is yet to be written
+static std::vector<std::byte>   gDemoData;              // Recording: the demo data written so far. Playback: all of the demo data.
+static uint32_t                 gPlaybackDataOffset;    // Playback: offset of the next tick to be read in the demo data
+static uint32_t                 gNumPlaybackTicksDone;  // Playback: how many ticks have been played
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Encoding and decoding helpers
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool isMovementField(const uint32_t fieldIdx) noexcept {
+    return (fieldIdx >= FIELD_ANGLE_TURN);
+}
+
+static uint32_t encodeFieldDelta(const uint32_t fieldIdx, const uint32_t prevValue, const uint32_t value) noexcept {
+    if (isMovementField(fieldIdx)) {
+        const int32_t diff = (int32_t)(value - prevValue);
+        return ((uint32_t) diff << 1) ^ (uint32_t)(diff >> 31);
+    } else {
+        return value ^ prevValue;
+    }
+}
+
+static uint32_t decodeFieldDelta(const uint32_t fieldIdx, const uint32_t prevValue, const uint32_t delta) noexcept {
+    if (isMovementField(fieldIdx)) {
+        const uint32_t diff = (delta >> 1) ^ (~(delta & 1) + 1);
+        return prevValue + diff;
+    } else {
+        return prevValue ^ delta;
+    }
+}
+
+static void writeVarint(std::vector<std::byte>& output, uint32_t value) noexcept {
+    while (value >= 0x80) {
+        output.push_back((std::byte)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+
+    output.push_back((std::byte) value);
+}
+
+static uint32_t readVarint(ByteInputStream& stream) THROWS {
+    uint32_t value = 0;
+
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        const uint8_t byte = stream.read<uint8_t>();
+        value |= (uint32_t)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+
+    throw ByteInputStream::StreamException();
+}
+
+static void writeU32(std::vector<std::byte>& output, const uint32_t value) noexcept {
+    output.push_back((std::byte)(value));
+    output.push_back((std::byte)(value >> 8));
+    output.push_back((std::byte)(value >> 16));
+    output.push_back((std::byte)(value >> 24));
+}
+
+static uint32_t readU32(ByteInputStream& stream) THROWS {
+    uint8_t bytes[4];
+    stream.readBytes((std::byte*) bytes, 4);
+    return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+static void writeTickInput(std::vector<std::byte>& output, const TickInput& prevInput, const TickInput& input) noexcept {
+    uint32_t changedFields = 0;
+
+    for (uint32_t fieldIdx = 0; fieldIdx < NUM_TICK_FIELDS; ++fieldIdx) {
+        if (input.fields[fieldIdx] != prevInput.fields[fieldIdx]) {
+            changedFields |= (1u << fieldIdx);
+        }
+    }
+
+    writeVarint(output, changedFields);
+
+    for (uint32_t fieldIdx = 0; fieldIdx < NUM_TICK_FIELDS; ++fieldIdx) {
+        if (changedFields & (1u << fieldIdx)) {
+            writeVarint(output, encodeFieldDelta(fieldIdx, prevInput.fields[fieldIdx], input.fields[fieldIdx]));
+        }
+    }
+}
+
+static void readTickInput(ByteInputStream& stream, const TickInput& prevInput, TickInput& input) THROWS {
+    const uint32_t changedFields = readVarint(stream);
+
+    if ((changedFields >> NUM_TICK_FIELDS) != 0)
+        throw ByteInputStream::StreamException();
+
+    for (uint32_t fieldIdx = 0; fieldIdx < NUM_TICK_FIELDS; ++fieldIdx) {
+        const uint32_t prevValue = prevInput.fields[fieldIdx];
+
+        if (changedFields & (1u << fieldIdx)) {
+            input.fields[fieldIdx] = decodeFieldDelta(fieldIdx, prevValue, readVarint(stream));
+        } else {
+            input.fields[fieldIdx] = prevValue;
+        }
+    }
+}
+
+static void tickInputFromControls(TickInput& input) noexcept {
+    Controls::InputState state;
+    Controls::getInputState(state);
+
+    input.fields[FIELD_GAME_ACTIONS_ACTIVE] = state.gameActionsActive;
+    input.fields[FIELD_GAME_ACTIONS_JUST_STARTED] = state.gameActionsJustStarted;
+    input.fields[FIELD_GAME_ACTIONS_JUST_ENDED] = state.gameActionsJustEnded;
+    input.fields[FIELD_MENU_ACTIONS_ACTIVE] = state.menuActionsActive;
+    input.fields[FIELD_MENU_ACTIONS_JUST_STARTED] = state.menuActionsJustStarted;
+    input.fields[FIELD_MENU_ACTIONS_JUST_ENDED] = state.menuActionsJustEnded;
+    std::memcpy(&input.fields[FIELD_AXIS_VALUES], state.axisValues, sizeof(state.axisValues));
+}
+
+static void tickInputToControls(const TickInput& input) noexcept {
+    Controls::InputState state;
+    state.gameActionsActive = input.fields[FIELD_GAME_ACTIONS_ACTIVE];
+    state.gameActionsJustStarted = input.fields[FIELD_GAME_ACTIONS_JUST_STARTED];
+    state.gameActionsJustEnded = input.fields[FIELD_GAME_ACTIONS_JUST_ENDED];
+    state.menuActionsActive = input.fields[FIELD_MENU_ACTIONS_ACTIVE];
+    state.menuActionsJustStarted = input.fields[FIELD_MENU_ACTIONS_JUST_STARTED];
+    state.menuActionsJustEnded = input.fields[FIELD_MENU_ACTIONS_JUST_ENDED];
+    std::memcpy(state.axisValues, &input.fields[FIELD_AXIS_VALUES], sizeof(state.axisValues));
+
+    Controls::setInputState(state);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Determines the path to the file for a demo slot
+//------------------------------------------------------------------------------------------------------------------------------------------
+static std::string determineSlotFilePath(const uint32_t slot) noexcept {
+    char* const pPrefsPath = SDL_GetPrefPath(SAVE_FILE_ORG, SAVE_FILE_PRODUCT);
+    auto cleanupPrefsPath = finally([&](){
+        SDL_free(pPrefsPath);
+    });
+
+    if (!pPrefsPath)
+        return std::string();
+
+    std::string path = pPrefsPath;      // Note: path is guaranteed to have a separator at the end, as per SDL docs!
+    path += "demo";
+    path += std::to_string(slot);
+    path += ".pdmo";
+    return path;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Verifies the given demo data and starts playing it back if valid
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool startPlaybackFromData(const std::byte* const pData, const size_t dataSize) noexcept {
+    stopRecording();
+    stopPlayback();
+
+    if ((!pData) || (dataSize < sizeof(DemoFileHeader)) || (dataSize >= UINT32_MAX))
+        return false;
+
+    // Read and verify the header
+    ByteInputStream stream(pData, (uint32_t) dataSize);
+    DemoFileHeader header = {};
+
+    try {
+        header.fileId = readU32(stream);
+        header.version = readU32(stream);
+        header.mapNum = readU32(stream);
+        header.skill = readU32(stream);
+        header.randomSeed = readU32(stream);
+        header.numTicks = readU32(stream);
+    } catch (...) {
+        return false;
+    }
+
+    const bool bValidHeader = (
+        (header.fileId == DEMO_FILE_ID) &&
+        (header.version == DEMO_FILE_VERSION) &&
+        (header.mapNum >= 1) &&
+        (header.skill <= sk_nightmare)
+    );
+
+    if (!bValidHeader)
+        return false;
+
+    // Start playback
+    gDemoInfo.mapNum = header.mapNum;
+    gDemoInfo.skill = (skill_e) header.skill;
+    gDemoInfo.randomSeed = header.randomSeed;
+    gDemoInfo.numTicks = header.numTicks;
+
+    gDemoData.assign(pData, pData + dataSize);
+    gPlaybackDataOffset = stream.tell();
+    gNumPlaybackTicksDone = 0;
+    gCurTickInput = {};
+    gPrevTickInput = {};
+    gbIsPlaying = true;
+
+    Random::setFixedSeed(header.randomSeed);
+    return true;
+}
+
+void startRecording(const uint32_t slot, const skill_e skill, const uint32_t mapNum) noexcept {
+    ASSERT((slot >= 1) && (slot <= NUM_SLOTS));
+    stopRecording();
+    stopPlayback();
+
+    std::random_device randomDevice;
+    gDemoInfo.mapNum = mapNum;
+    gDemoInfo.skill = skill;
+    gDemoInfo.randomSeed = randomDevice();
+    gDemoInfo.numTicks = 0;
+
+    gRecordSlot = slot;
+    gCurTickInput = {};
+    gPrevTickInput = {};
+    gbHaveCurTickInput = false;
+    gDemoData.clear();
+    gDemoData.reserve(64 * 1024);
+    gbIsRecording = true;
+
+    // Make the game start with the seed saved in the demo
+    Random::setFixedSeed(gDemoInfo.randomSeed);
+}
+
+void stopRecording() noexcept {
+    if (!gbIsRecording)
+        return;
+
+    // Write out the input for the last tick
+    if (gbHaveCurTickInput) {
+        writeTickInput(gDemoData, gPrevTickInput, gCurTickInput);
+        gbHaveCurTickInput = false;
+        gDemoInfo.numTicks++;
+    }
+
+    // Make up the full demo file and save it
+    std::vector<std::byte> fileData;
+    fileData.reserve(sizeof(DemoFileHeader) + gDemoData.size());
+    writeU32(fileData, DEMO_FILE_ID);
+    writeU32(fileData, DEMO_FILE_VERSION);
+    writeU32(fileData, gDemoInfo.mapNum);
+    writeU32(fileData, (uint32_t) gDemoInfo.skill);
+    writeU32(fileData, gDemoInfo.randomSeed);
+    writeU32(fileData, gDemoInfo.numTicks);
+    fileData.insert(fileData.end(), gDemoData.begin(), gDemoData.end());
+
+    // Note: failing to save a demo is not worth stopping the game over, so if this fails then the demo is just lost
+    const std::string filePath = determineSlotFilePath(gRecordSlot);
+
+    if (!filePath.empty()) {
+        FileUtils::writeDataToFile(filePath.c_str(), fileData.data(), fileData.size());
+    }
+
+    gDemoData.clear();
+    gbIsRecording = false;
+    Random::clearFixedSeed();
+}
+
+bool isRecording() noexcept {
+    return gbIsRecording;
+}
+
+bool startPlayback(const uint32_t slot) noexcept {
+    ASSERT((slot >= 1) && (slot <= NUM_SLOTS));
+
+    // Try the file for the slot first
+    const std::string filePath = determineSlotFilePath(slot);
+
+    if ((!filePath.empty()) && FileUtils::fileExists(filePath.c_str()))
+        return startPlayback(filePath.c_str());
+
+    // Otherwise try the game resource for the slot
+    const uint32_t resourceNum = rDEMO1 + slot - 1;
+    const Resource* const pResourceHeader = Resources::get(resourceNum);
+
+    if ((!pResourceHeader) || (pResourceHeader->size == 0))
+        return false;
+
+    const Resource* const pResource = Resources::load(resourceNum);
+    const bool bStarted = startPlaybackFromData(pResource->pData, pResource->size);
+    Resources::release(resourceNum);
+    return bStarted;
+}
+
+bool startPlayback(const char* const filePath) noexcept {
+    ASSERT(filePath);
+
+    std::byte* pFileData = nullptr;
+    size_t fileSize = 0;
+
+    auto cleanupFileData = finally([&](){
+        delete[] pFileData;
+    });
+
+    if (!FileUtils::getContentsOfFile(filePath, pFileData, fileSize))
+        return false;
+
+    return startPlaybackFromData(pFileData, fileSize);
+}
+
+void stopPlayback() noexcept {
+    if (!gbIsPlaying)
+        return;
+
+    gDemoData.clear();
+    gDemoData.shrink_to_fit();
+    gbIsPlaying = false;
+    Random::clearFixedSeed();
+}
+
+bool isPlaying() noexcept {
+    return gbIsPlaying;
+}
+
+bool isPlaybackFinished() noexcept {
+    return (gbIsPlaying && (gNumPlaybackTicksDone >= gDemoInfo.numTicks));
+}
+
+const DemoInfo& getInfo() noexcept {
+    return gDemoInfo;
+}
+
+void tickControls() noexcept {
+    if (gbIsRecording) {
+        // Write out the input for the previous tick now that it is complete, then capture the controls for this tick.
+        // Note: the movement for this tick is not known until later, so carry over the previous movement in case there is none.
+        if (gbHaveCurTickInput) {
+            writeTickInput(gDemoData, gPrevTickInput, gCurTickInput);
+            gPrevTickInput = gCurTickInput;
+            gDemoInfo.numTicks++;
+        }
+
+        tickInputFromControls(gCurTickInput);
+        gbHaveCurTickInput = true;
+    }
+    else if (gbIsPlaying) {
+        // If the demo has ended or is invalid then there is no more input
+        bool bHaveInput = false;
+
+        if (gNumPlaybackTicksDone < gDemoInfo.numTicks) {
+            ByteInputStream stream(gDemoData.data(), (uint32_t) gDemoData.size());
+
+            try {
+                stream.consume(gPlaybackDataOffset);
+                gPrevTickInput = gCurTickInput;
+                readTickInput(stream, gPrevTickInput, gCurTickInput);
+                gPlaybackDataOffset = stream.tell();
+                gNumPlaybackTicksDone++;
+                bHaveInput = true;
+            } catch (...) {
+                gNumPlaybackTicksDone = gDemoInfo.numTicks;
+            }
+        }
+
+        if (!bHaveInput) {
+            gCurTickInput = {};
+        }
+
+        tickInputToControls(gCurTickInput);
+    }
+}
+
+void tickPlayerMove(player_t& player) noexcept {
+    if (gbIsRecording) {
+        gCurTickInput.fields[FIELD_ANGLE_TURN] = player.angleturn;
+        gCurTickInput.fields[FIELD_FORWARD_MOVE] = (uint32_t) player.forwardmove;
+        gCurTickInput.fields[FIELD_SIDE_MOVE] = (uint32_t) player.sidemove;
+    }
+    else if (gbIsPlaying) {
+        player.angleturn = gCurTickInput.fields[FIELD_ANGLE_TURN];
+        player.forwardmove = (Fixed) gCurTickInput.fields[FIELD_FORWARD_MOVE];
+        player.sidemove = (Fixed) gCurTickInput.fields[FIELD_SIDE_MOVE];
+    }
+}
+
+END_NAMESPACE(Demo)
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Base/Macros.h"
+#include <cstdint>
+
+enum skill_e : uint8_t;
+struct player_t;
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Demo recording and playback.
+//
+// A demo captures the control inputs for every game tick of a single level, started from a new game with a known random seed.
+// Playing back a demo reproduces the original session exactly, which makes it useful for reproducible performance measurement.
+// Note: cheats are disabled while recording or playing back a demo, since cheat key presses are not captured.
+//
+// Demos are saved to and loaded from one of 2 demo slots. Each slot is a file in the user's preferences folder, and if that file
+// does not exist then the 'rDEMO1' or 'rDEMO2' game resource is used instead (if it contains a demo in the format used here).
+//------------------------------------------------------------------------------------------------------------------------------------------
+BEGIN_NAMESPACE(Demo)
+
+static constexpr uint32_t NUM_SLOTS = 2;
+
+// Basic information about the demo being recorded or played back
+struct DemoInfo {
+    uint32_t    mapNum;
+    skill_e     skill;
+    uint32_t    randomSeed;
+    uint32_t    numTicks;
+};
+
+// Start or stop recording a demo to the given slot (1 or 2).
+// Recording must be started before the new game is initialized, since the random seed for the game is set here.
+// The demo is saved to the slot when recording stops.
+void startRecording(const uint32_t slot, const skill_e skill, const uint32_t mapNum) noexcept;
+void stopRecording() noexcept;
+bool isRecording() noexcept;
+
+// Start or stop playing back a demo from the given slot (1 or 2) or file path.
+// Returns 'false' if the demo could not be loaded. If playback starts then the new game should be initialized using the map and
+// skill level given by 'getInfo()', since the random seed for the game is set here.
+bool startPlayback(const uint32_t slot) noexcept;
+bool startPlayback(const char* const filePath) noexcept;
+void stopPlayback() noexcept;
+bool isPlaying() noexcept;
+bool isPlaybackFinished() noexcept;
+
+// Get info for the demo currently being recorded or played back
+const DemoInfo& getInfo() noexcept;
+
+// Called at the start of each game tick: records the state of the controls or restores them from the demo being played back
+void tickControls() noexcept;
+
+// Called after the player's movement has been determined for the tick: records it or replaces it with the movement from the demo
+void tickPlayerMove(player_t& player) noexcept;
+
+END_NAMESPACE(Demo)
@@ -1,8 +1,11 @@
 #include "DoomMain.h"
 
 #include "Audio/Audio.h"
+#include "Base/Finally.h"
+#include "Base/Profiler.h"
 #include "Config.h"
 #include "Data.h"
+#include "DoomDefines.h"
 #include "DoomRez.h"
 #include "GameDataFS.h"
 #include "GFX/CelImages.h"
@@ -18,6 +21,7 @@
 #include "UI/TitleScreens.h"
 #include "UI/WipeFx.h"
 #include <SDL.h>
+#include <string>
 #include <thread>
 
 //------------------------------------------------------------------------------------------------------------------------------------------
@@ -57,12 +61,39 @@ static void checkForPerfProfileToggle() noexcept {
         else if (gPerfCounterMode == PerfCounterMode::FPS) {
             gPerfCounterMode = PerfCounterMode::USEC;
         } 
+        else if (gPerfCounterMode == PerfCounterMode::USEC) {
+            gPerfCounterMode = PerfCounterMode::PROFILE;
+        }
         else {
             gPerfCounterMode = PerfCounterMode::NONE;
         }
+
+        // Only record profiler zones when they are needed
+        Profiler::setRecording((gPerfCounterMode == PerfCounterMode::PROFILE) || Config::gbEnableProfiler);
     }
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Saves the history of profiler zones to the prefs folder, if the profiler was enabled via config
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void saveProfilerZones() noexcept {
+    if (!Config::gbEnableProfiler)
+        return;
+
+    char* const pPrefsPath = SDL_GetPrefPath(SAVE_FILE_ORG, SAVE_FILE_PRODUCT);
+    auto cleanupPrefsPath = finally([&](){
+        SDL_free(pPrefsPath);
+    });
+
+    if (!pPrefsPath)
+        return;
+
+    const std::string csvFilePath = std::string(pPrefsPath) + "profile.csv";
+    const std::string traceFilePath = std::string(pPrefsPath) + "profile_trace.json";
+    Profiler::writeCsv(csvFilePath.c_str());
+    Profiler::writeChromeTrace(traceFilePath.c_str());
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Main loop processing for the game system.
 // Each callback is optional, though should probably always have a ticker and drawer.
@@ -117,6 +148,8 @@ gameaction_e RunGameLoop(
 
         // Simulate the required number of ticks
         if (ticker) {
+            PROFILE_ZONE("Ticks");
+
             while ((ticksLeftToSimulate > 0) && (nextGameAction == ga_nothing)) {
                 ++gTotalGameTicks;              // Add to the VBL count
                 --ticksLeftToSimulate;
@@ -137,12 +170,14 @@ gameaction_e RunGameLoop(
         // Sync up with the refresh - draw the screen.
         // Also save the framebuffer for each game loop transition, so we can do a wipe if needed.
         if (drawer) {
+            PROFILE_ZONE("Draw");
             const bool bPresent = true;
             const bool bSaveFrameBuffer = (nextGameAction != ga_nothing);
             drawer(bPresent, bSaveFrameBuffer);
         }
 
         endTickPerfProfile();
+        Profiler::endFrame(Config::gPerfCounterNumFramesToAverage);
 
     } while (nextGameAction == ga_nothing);     // Is the loop finished?
 
@@ -162,6 +197,8 @@ gameaction_e RunGameLoop(
 static void D_DoomInit() noexcept {
     // Init main subsystems
     Config::init();
+    Profiler::init();
+    Profiler::setRecording(Config::gbEnableProfiler);
     Prefs::load();
     GameDataFS::init();
     Resources::init();
@@ -184,6 +221,9 @@ static void D_DoomInit() noexcept {
 // Game shutdown and cleanup
 //------------------------------------------------------------------------------------------------------------------------------------------
 static void D_DoomShutdown() noexcept {
+    saveProfilerZones();
+    Profiler::shutdown();
+
     Renderer::shutdown();
     Controls::shutdown();
     Audio::shutdown();
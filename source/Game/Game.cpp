@@ -126,8 +126,8 @@ void G_RunGame() noexcept {
         // Run a level until death or completion
         RunGameLoop(P_Start, P_Stop, P_Ticker, P_Drawer);
 
-        // If quitting to the main menu was requested then don't go any further
-        if (gGameAction == ga_quit)     
+        // If quitting to the main menu was requested or demo playback ended then don't go any further
+        if ((gGameAction == ga_quit) || (gGameAction == ga_exitdemo))
             return;
         
         // Take away cards and stuff
@@ -4,10 +4,13 @@
 #include "Audio/Sound.h"
 #include "Audio/Sounds.h"
 #include "Base/Mem.h"
+#include "Base/Profiler.h"
 #include "Base/Random.h"
 #include "Cheats.h"
+#include "Config.h"
 #include "Controls.h"
 #include "Data.h"
+#include "Demo.h"
 #include "DoomDefines.h"
 #include "DoomRez.h"
 #include "Game.h"
@@ -136,6 +139,8 @@ void ChangeThinkCode(void* const pThinker, const ThinkerFunc funcProc) noexcept
 // Execute all the think logic in the object list
 //------------------------------------------------------------------------------------------------------------------------------------------
 void RunThinkers() noexcept {
+    PROFILE_ZONE("Thinkers");
+
     thinker_t* pCurThinker = gThinkerCap.next;  // Get the first entry
 
     while (pCurThinker != &gThinkerCap) {                       // Looped back?        
@@ -174,12 +179,23 @@ static void checkForPauseButton() noexcept {
 // Code that gets executed every game frame
 //------------------------------------------------------------------------------------------------------------------------------------------
 gameaction_e P_Ticker() noexcept {
+    PROFILE_ZONE("Tick");
+
     // If we are to quit then abort
     if (gbQuitToMainRequested) {
         gGameAction = ga_quit;
         return ga_quit;
     }
 
+    // If playing back a demo and it has ended then exit
+    if (Demo::isPlaybackFinished()) {
+        gGameAction = ga_exitdemo;
+        return ga_exitdemo;
+    }
+
+    // Record the controls for this tick if recording a demo, or restore them if playing one back
+    Demo::tickControls();
+
     // Wait for refresh to latch all needed data before running the next tick
     gGameAction = ga_nothing;   // Game in progress
     gbTick1 = false;            // Reset the flags
@@ -205,8 +221,10 @@ gameaction_e P_Ticker() noexcept {
         gbTick4 = true;
     }
 
-    // Handle cheat codes
-    Cheats::update();
+    // Handle cheat codes: these are not allowed in demos since cheat key presses are not recorded
+    if ((!Demo::isRecording()) && (!Demo::isPlaying())) {
+        Cheats::update();
+    }
 
     // If warping then don't do any other logic
     if (gGameAction == ga_warped)
@@ -240,11 +258,37 @@ gameaction_e P_Ticker() noexcept {
     return gGameAction;     // May have been set to 'ga_died', 'ga_completed', or 'ga_secretexit'
 }
 
+//------------------------------------------------------------------------------------------------------------------------------------------
+// If the 3D view for the last frame is still being drawn in the background then waits for it to finish, draws the status bar and
+// presents the frame (if presenting).
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void finishPipelinedFrame(const bool bPresent) noexcept {
+    if (!Renderer::isDrawingPlayerView())
+        return;
+
+    Renderer::endDrawPlayerView();
+    ST_Drawer();
+    Video::endFrame(bPresent, false);
+}
+
 //------------------------------------------------------------------------------------------------------------------------------------------
 // Draw current display
 //------------------------------------------------------------------------------------------------------------------------------------------
 void P_Drawer(const bool bPresent, const bool bSaveFrameBuffer) noexcept {
-    if (gbGamePaused && gbRefreshDrawn) {
+    const bool bIsPaused = (gbGamePaused && gbRefreshDrawn);
+    const bool bPipelineView = (
+        (!bIsPaused) &&
+        (!gPlayer.isOptionsMenuActive()) &&
+        (!gPlayer.isAutomapActive()) &&
+        Config::gbPipelinedRendering &&
+        (!bSaveFrameBuffer)
+    );
+
+    // Finish the last frame first if it is still being drawn.
+    // Only present it if this call won't present another frame straight after, otherwise it would be presented twice.
+    finishPipelinedFrame(bPresent && bPipelineView);
+
+    if (bIsPaused) {
         UIUtils::drawPlaque(rPAUSED);                   // Draw 'Paused' plaque
         Video::endFrame(bPresent, bSaveFrameBuffer);
     } else if (gPlayer.isOptionsMenuActive()) {
@@ -259,6 +303,12 @@ void P_Drawer(const bool bPresent, const bool bSaveFrameBuffer) noexcept {
         ST_Drawer();                                    // Draw the status bar
         Video::endFrame(bPresent, bSaveFrameBuffer);
         gbRefreshDrawn = true;
+    } else if (bPipelineView) {
+        // Start drawing the 3D view but don't wait for it to finish, so the next tick can be simulated while the view draws.
+        // The frame is finished and presented on the next call to this function.
+        Video::debugClearScreen();
+        Renderer::beginDrawPlayerView();
+        gbRefreshDrawn = true;
     } else {
         Video::debugClearScreen();
         Renderer::drawPlayerView();                     // Render the 3D view
@@ -301,6 +351,13 @@ void P_Start() noexcept {
 // Shut down a game
 //------------------------------------------------------------------------------------------------------------------------------------------
 void P_Stop() noexcept {
+    // Make sure the 3D view is not still being drawn before the map is released
+    if (Renderer::isDrawingPlayerView()) {
+        Renderer::endDrawPlayerView();
+    }
+
+    Demo::stopRecording();      // Demos only cover one level
+    Demo::stopPlayback();
     Cheats::shutdown();
     S_StopSong();
     Slide::shutdown();
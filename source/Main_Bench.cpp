@@ -0,0 +1,5 @@
+#include "Bench/Bench.h"
+
+int main(int argc, char* argv[]) noexcept {
+    return Bench::run(argc, argv);
+}
@@ -0,0 +1,5 @@
+#include "PvsTool/PvsTool.h"
+
+int main(int argc, char* argv[]) noexcept {
+    return PvsTool::run(argc, argv);
+}
@@ -6,6 +6,7 @@
 #include "Game/Config.h"
 #include "Game/DoomRez.h"
 #include "Game/Resources.h"
+#include "MapPvs.h"
 
 // On-disk versions of various map data structures.
 // These differ to the runtime versions and are in big endian format.
@@ -417,6 +418,7 @@ static void loadNodes(const uint32_t lumpResourceNum) noexcept {
 
     // The last node in the nodes array is the root of the BSP tree
     gpBSPTreeRoot = &gNodes.back();
+    gNumBSPNodes = numNodes;
 
     // Don't need this anymore
     Resources::free(lumpResourceNum);
@@ -551,6 +553,7 @@ uint32_t            gNumLineSegs;
 const subsector_t*  gpSubSectors;
 uint32_t            gNumSubSectors;
 node_t*             gpBSPTreeRoot;
+uint32_t            gNumBSPNodes;
 const uint8_t*      gpRejectMatrix;
 line_t***           gpBlockMapLineLists;
 mobj_t**            gpBlockMapThingLists;
@@ -576,9 +579,14 @@ void mapDataInit(const uint32_t mapNum) {
 
     // Post processing of map data
     calcSegLightMultipliers();
+
+    // Load the precomputed PVS for the map if available (needs all the other map data)
+    MapPvs::load(mapNum);
 }
 
 void mapDataShutdown() {
+    MapPvs::unload();
+
     gVertexes.clear();
     gpVertexes = nullptr;
     gNumVertexes = 0;
@@ -605,6 +613,7 @@ void mapDataShutdown() {
 
     gNodes.clear();
     gpBSPTreeRoot = nullptr;
+    gNumBSPNodes = 0;
 
     if (gLoadedRejectMatrixResourceNum > 0) {
         Resources::free(gLoadedRejectMatrixResourceNum);
@@ -93,7 +93,6 @@ struct line_t {
     float       v1DrawDepth;            // Depth of v1 and v2 when drawn
     float       v2DrawDepth;
     uint8_t     drawnSideIndex;         // Which side of the line is being rendered
-    bool        bIsInFrontOfSprite;     // Used during sprite clipping: stores if the line is considered in front of the sprite
 };
 
 // Flags that can be applied to a line
@@ -178,7 +177,8 @@ extern const seg_t*         gpLineSegs;
 extern uint32_t             gNumLineSegs;
 extern const subsector_t*   gpSubSectors;
 extern uint32_t             gNumSubSectors;
-extern node_t*              gpBSPTreeRoot;
+extern node_t*              gpBSPTreeRoot;          // Note: the root is the last node in the nodes array
+extern uint32_t             gNumBSPNodes;
 extern const uint8_t*       gpRejectMatrix;         // For fast sight rejection
 extern line_t***            gpBlockMapLineLists;    // For each blockmap entry, a pointer to a list of line pointers (all lines in the block)
 extern mobj_t**             gpBlockMapThingLists;   // For each blockmap entry, a pointer to the first thing in a linked list of things (all things in the block)
@@ -187,6 +187,12 @@ extern uint32_t             gBlockMapHeight;
 extern Fixed                gBlockMapOriginX;
 extern Fixed                gBlockMapOriginY;
 
+// Get a unique index (from '0' to 'gNumBSPNodes - 1') for a BSP node, for use with per node data.
+// Note: the root is the last node in the nodes array, so the index is reversed and the root is always index '0'.
+inline uint32_t getBspNodeIdx(const node_t& node) noexcept {
+    return (uint32_t)(gpBSPTreeRoot - &node);
+}
+
 // Load all map data for the specified map and release it
 void mapDataInit(const uint32_t mapNum);
 void mapDataShutdown();
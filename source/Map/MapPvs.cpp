@@ -0,0 +1,504 @@
+#include "MapPvs.h"
+
+#include "Base/ByteInputStream.h"
+#include "Base/FileUtils.h"
+#include "Base/Finally.h"
+#include "Game/Config.h"
+#include "Game/DoomDefines.h"
+#include "MapData.h"
+#include <cmath>
+#include <vector>
+#include <SDL.h>
+
+BEGIN_NAMESPACE(MapPvs)
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// PVS file format.
+// All values are little endian. The header is followed by the sector visibility bit matrix: one row of 'ceil(numSectors / 8)' bytes for
+// each sector, where bit 'N' of a row (bit 'N % 8' of byte 'N / 8') is set if sector 'N' is potentially visible.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr uint32_t PVS_FILE_ID = 0x53565050u;     // 'PPVS'
+static constexpr uint32_t PVS_FILE_VERSION = 1;
+
+struct PvsFileHeader {
+    uint32_t    fileId;
+    uint32_t    version;
+    uint32_t    numSectors;
+    uint32_t    mapGeometryHash;    // Hash of the map geometry the PVS was computed for, so that out of date files are never used
+};
+
+static_assert(sizeof(PvsFileHeader) == 16);
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Settings for computing the PVS
+//------------------------------------------------------------------------------------------------------------------------------------------
+static constexpr double     PORTAL_EXTEND_AMOUNT    = 2.0;          // Portals are extended by this much at each end, to allow for rounding in sight checks
+static constexpr double     CLIP_EPSILON            = 0.01;         // Tolerance for clipping against lines (world units)
+static constexpr uint32_t   MAX_FLOW_STEPS          = 1 << 18;      // Max recursion steps per sector before giving up and just flood filling
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// A point and a way out of a sector (through a two sided line) used when computing the PVS
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct Point2d {
+    double x;
+    double y;
+};
+
+struct SectorExit {
+    Point2d     p1;                 // Endpoints of the exit: the sector being left is on the right side when going from 'p1' to 'p2'
+    Point2d     p2;
+    uint32_t    toSectorIdx;        // Which sector the exit leads to
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// State for working out which sectors are visible from one particular sector
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct FlowState {
+    const std::vector<std::vector<SectorExit>>*     pSectorExits;
+    uint8_t*                                        pVisRow;        // Row of the sector visibility matrix being computed
+    std::vector<bool>                               bSectorInFlow;  // Whether each sector is already being flowed through (avoids loops)
+    Point2d                                         src1;           // The exit from the starting sector that is being flowed through
+    Point2d                                         src2;
+    uint32_t                                        numStepsLeft;
+};
+
+const uint8_t*  gpSectorVis;
+uint32_t        gSectorVisRowSize;
+const uint8_t*  gpNodeVis;
+uint32_t        gNodeVisRowSize;
+
+static std::vector<uint8_t>     gSectorVisData;
+static std::vector<uint8_t>     gNodeVisData;
+
+static void writeU32(std::vector<std::byte>& output, const uint32_t value) noexcept {
+    output.push_back((std::byte)(value));
+    output.push_back((std::byte)(value >> 8));
+    output.push_back((std::byte)(value >> 16));
+    output.push_back((std::byte)(value >> 24));
+}
+
+static uint32_t readU32(ByteInputStream& stream) THROWS {
+    uint8_t bytes[4];
+    stream.readBytes((std::byte*) bytes, 4);
+    return (uint32_t) bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+static inline void setVisBit(uint8_t* const pRow, const uint32_t idx) noexcept {
+    pRow[idx >> 3] |= (uint8_t)(1u << (idx & 7));
+}
+
+static inline bool getVisBit(const uint8_t* const pRow, const uint32_t idx) noexcept {
+    return ((pRow[idx >> 3] & (1u << (idx & 7))) != 0);
+}
+
+static uint32_t getSectorIdx(const sector_t* const pSector) noexcept {
+    return (uint32_t)(pSector - gpSectors);
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Computes a hash (FNV-1a) of the parts of the currently loaded map that affect the PVS
+//------------------------------------------------------------------------------------------------------------------------------------------
+static uint32_t computeMapGeometryHash() noexcept {
+    uint32_t hash = 2166136261u;
+
+    const auto addToHash = [&](const uint32_t value) noexcept {
+        for (uint32_t byteIdx = 0; byteIdx < 4; ++byteIdx) {
+            hash ^= (value >> (byteIdx * 8)) & 0xFFu;
+            hash *= 16777619u;
+        }
+    };
+
+    addToHash(gNumSectors);
+    addToHash(gNumLines);
+
+    for (uint32_t lineIdx = 0; lineIdx < gNumLines; ++lineIdx) {
+        const line_t& line = gpLines[lineIdx];
+        addToHash((uint32_t) line.v1.x);
+        addToHash((uint32_t) line.v1.y);
+        addToHash((uint32_t) line.v2.x);
+        addToHash((uint32_t) line.v2.y);
+        addToHash(getSectorIdx(line.frontsector));
+        addToHash((line.backsector) ? getSectorIdx(line.backsector) : UINT32_MAX);
+    }
+
+    return hash;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Gets the signed distance of a point to a line: positive if on the left side when going from 'l1' to 'l2'
+//------------------------------------------------------------------------------------------------------------------------------------------
+static double getSignedDistToLine(const Point2d p, const Point2d l1, const Point2d l2) noexcept {
+    const double lineDx = l2.x - l1.x;
+    const double lineDy = l2.y - l1.y;
+    const double lineLength = std::sqrt(lineDx * lineDx + lineDy * lineDy);
+    const double cross = lineDx * (p.y - l1.y) - lineDy * (p.x - l1.x);
+    return (lineLength > 0.0) ? cross / lineLength : 0.0;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Clips the segment from 's1' to 's2' so only the part on the left side of the line going from 'l1' to 'l2' (or on it) remains.
+// Returns 'false' if the segment is entirely clipped away.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool clipSegToLeftOfLine(Point2d& s1, Point2d& s2, const Point2d l1, const Point2d l2) noexcept {
+    const double dist1 = getSignedDistToLine(s1, l1, l2);
+    const double dist2 = getSignedDistToLine(s2, l1, l2);
+    const bool bKeep1 = (dist1 >= -CLIP_EPSILON);
+    const bool bKeep2 = (dist2 >= -CLIP_EPSILON);
+
+    if (bKeep1 && bKeep2)
+        return true;
+
+    if ((!bKeep1) && (!bKeep2))
+        return false;
+
+    const double t = dist1 / (dist1 - dist2);
+    const Point2d intersect = { s1.x + (s2.x - s1.x) * t, s1.y + (s2.y - s1.y) * t };
+
+    if (bKeep1) {
+        s2 = intersect;
+    } else {
+        s1 = intersect;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Clips the segment from 't1' to 't2' to the region that can be seen from the source portal through the pass portal.
+// This region is bounded by the lines going through an endpoint of each portal, where the portals are on opposite sides of the line.
+// Returns 'false' if the segment is entirely clipped away.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool clipSegToSeparatingLines(
+    Point2d& t1,
+    Point2d& t2,
+    const Point2d src1,
+    const Point2d src2,
+    const Point2d pass1,
+    const Point2d pass2
+) noexcept {
+    const Point2d srcPts[2] = { src1, src2 };
+    const Point2d passPts[2] = { pass1, pass2 };
+
+    for (uint32_t srcPtIdx = 0; srcPtIdx < 2; ++srcPtIdx) {
+        for (uint32_t passPtIdx = 0; passPtIdx < 2; ++passPtIdx) {
+            const Point2d srcPt = srcPts[srcPtIdx];
+            const Point2d passPt = passPts[passPtIdx];
+            const double otherSrcPtDist = getSignedDistToLine(srcPts[srcPtIdx ^ 1], srcPt, passPt);
+            const double otherPassPtDist = getSignedDistToLine(passPts[passPtIdx ^ 1], srcPt, passPt);
+
+            // Note: if either portal is (nearly) on the line then it's not used, which just makes the visible region bigger
+            if ((otherSrcPtDist < -CLIP_EPSILON) && (otherPassPtDist > CLIP_EPSILON)) {
+                if (!clipSegToLeftOfLine(t1, t2, srcPt, passPt))
+                    return false;
+            }
+            else if ((otherSrcPtDist > CLIP_EPSILON) && (otherPassPtDist < -CLIP_EPSILON)) {
+                if (!clipSegToLeftOfLine(t1, t2, passPt, srcPt))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Marks the given sector as visible and then recursively flows through all of the exits from it that can be seen through both the
+// source portal and the given pass portal (the exit used to get into this sector). Returns 'false' if the step limit was reached.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool flowThroughSector(FlowState& state, const uint32_t sectorIdx, const Point2d pass1, const Point2d pass2) noexcept {
+    setVisBit(state.pVisRow, sectorIdx);
+
+    if (state.numStepsLeft == 0)
+        return false;
+
+    --state.numStepsLeft;
+    state.bSectorInFlow[sectorIdx] = true;
+    bool bFinished = true;
+
+    for (const SectorExit& exit : (*state.pSectorExits)[sectorIdx]) {
+        if (state.bSectorInFlow[exit.toSectorIdx])
+            continue;
+
+        // The part of the exit seen must be beyond both the source and pass portals, and within the region seen through both of them
+        Point2d target1 = exit.p1;
+        Point2d target2 = exit.p2;
+
+        if (!clipSegToLeftOfLine(target1, target2, state.src1, state.src2))
+            continue;
+
+        if (!clipSegToLeftOfLine(target1, target2, pass1, pass2))
+            continue;
+
+        if (!clipSegToSeparatingLines(target1, target2, state.src1, state.src2, pass1, pass2))
+            continue;
+
+        if (!flowThroughSector(state, exit.toSectorIdx, target1, target2)) {
+            bFinished = false;
+            break;
+        }
+    }
+
+    state.bSectorInFlow[sectorIdx] = false;
+    return bFinished;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Marks every sector that can be reached from the given sector through any number of exits as visible.
+// Used as a fallback when working out exact visibility takes too long.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void floodFillVisibility(
+    const std::vector<std::vector<SectorExit>>& sectorExits,
+    const uint32_t startSectorIdx,
+    uint8_t* const pVisRow
+) noexcept {
+    std::vector<uint32_t> sectorsToVisit;
+    std::vector<bool> bSectorVisited(gNumSectors, false);
+    sectorsToVisit.push_back(startSectorIdx);
+    bSectorVisited[startSectorIdx] = true;
+
+    while (!sectorsToVisit.empty()) {
+        const uint32_t sectorIdx = sectorsToVisit.back();
+        sectorsToVisit.pop_back();
+        setVisBit(pVisRow, sectorIdx);
+
+        for (const SectorExit& exit : sectorExits[sectorIdx]) {
+            if (!bSectorVisited[exit.toSectorIdx]) {
+                bSectorVisited[exit.toSectorIdx] = true;
+                sectorsToVisit.push_back(exit.toSectorIdx);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Computes the sector visibility matrix for the currently loaded map
+//------------------------------------------------------------------------------------------------------------------------------------------
+static void computeSectorVis(std::vector<uint8_t>& sectorVis, const uint32_t rowSize) noexcept {
+    // Make up the list of exits for each sector from the two sided lines, extending them slightly
+    std::vector<std::vector<SectorExit>> sectorExits(gNumSectors);
+
+    for (uint32_t lineIdx = 0; lineIdx < gNumLines; ++lineIdx) {
+        const line_t& line = gpLines[lineIdx];
+
+        if ((!line.backsector) || (line.backsector == line.frontsector))
+            continue;
+
+        const double dx = fixed16ToFloat(line.v2.x - line.v1.x);
+        const double dy = fixed16ToFloat(line.v2.y - line.v1.y);
+        const double length = std::sqrt(dx * dx + dy * dy);
+
+        if (length <= 0.0)
+            continue;
+
+        const double extendX = (dx / length) * PORTAL_EXTEND_AMOUNT;
+        const double extendY = (dy / length) * PORTAL_EXTEND_AMOUNT;
+        const Point2d p1 = { fixed16ToFloat(line.v1.x) - extendX, fixed16ToFloat(line.v1.y) - extendY };
+        const Point2d p2 = { fixed16ToFloat(line.v2.x) + extendX, fixed16ToFloat(line.v2.y) + extendY };
+
+        // Note: the front side of a line is on the right, so the endpoints are swapped when leaving from the back side
+        const uint32_t frontSectorIdx = getSectorIdx(line.frontsector);
+        const uint32_t backSectorIdx = getSectorIdx(line.backsector);
+        sectorExits[frontSectorIdx].push_back({ p1, p2, backSectorIdx });
+        sectorExits[backSectorIdx].push_back({ p2, p1, frontSectorIdx });
+    }
+
+    // Work out what is visible from each sector by flowing through each of its exits in turn
+    sectorVis.assign((size_t) gNumSectors * rowSize, 0);
+
+    FlowState state = {};
+    state.pSectorExits = &sectorExits;
+    state.bSectorInFlow.assign(gNumSectors, false);
+
+    for (uint32_t sectorIdx = 0; sectorIdx < gNumSectors; ++sectorIdx) {
+        uint8_t* const pVisRow = sectorVis.data() + (size_t) sectorIdx * rowSize;
+        setVisBit(pVisRow, sectorIdx);
+
+        state.pVisRow = pVisRow;
+        state.numStepsLeft = MAX_FLOW_STEPS;
+        bool bFinished = true;
+
+        for (const SectorExit& exit : sectorExits[sectorIdx]) {
+            state.src1 = exit.p1;
+            state.src2 = exit.p2;
+            state.bSectorInFlow[sectorIdx] = true;
+            bFinished = flowThroughSector(state, exit.toSectorIdx, exit.p1, exit.p2);
+            state.bSectorInFlow[sectorIdx] = false;
+
+            if (!bFinished)
+                break;
+        }
+
+        if (!bFinished) {
+            floodFillVisibility(sectorExits, sectorIdx, pVisRow);
+        }
+    }
+
+    // Visibility must always go both ways, make sure that is so
+    for (uint32_t sectorIdx1 = 0; sectorIdx1 < gNumSectors; ++sectorIdx1) {
+        for (uint32_t sectorIdx2 = sectorIdx1 + 1; sectorIdx2 < gNumSectors; ++sectorIdx2) {
+            uint8_t* const pVisRow1 = sectorVis.data() + (size_t) sectorIdx1 * rowSize;
+            uint8_t* const pVisRow2 = sectorVis.data() + (size_t) sectorIdx2 * rowSize;
+
+            if (getVisBit(pVisRow1, sectorIdx2) || getVisBit(pVisRow2, sectorIdx1)) {
+                setVisBit(pVisRow1, sectorIdx2);
+                setVisBit(pVisRow2, sectorIdx1);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Marks the given BSP node in the node visibility row if any of the subsectors under it are visible, and returns whether that is so
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool markVisibleBspNodes(const uint32_t fromSectorIdx, void* const pNodeOrSubsector, uint8_t* const pNodeVisRow) noexcept {
+    if (isBspNodeASubSector(pNodeOrSubsector)) {
+        const subsector_t& subsector = *(const subsector_t*) getActualBspNodePtr(pNodeOrSubsector);
+        return canSectorSeeSector(fromSectorIdx, getSectorIdx(subsector.sector));
+    }
+
+    const node_t& node = *(const node_t*) pNodeOrSubsector;
+    const bool bChild1Visible = markVisibleBspNodes(fromSectorIdx, node.Children[0], pNodeVisRow);
+    const bool bChild2Visible = markVisibleBspNodes(fromSectorIdx, node.Children[1], pNodeVisRow);
+
+    if (bChild1Visible || bChild2Visible) {
+        setVisBit(pNodeVisRow, getBspNodeIdx(node));
+        return true;
+    }
+
+    return false;
+}
+
+void load(const uint32_t mapNum) noexcept {
+    unload();
+
+    if (!Config::gbUseMapPvsFiles)
+        return;
+
+    // Read the file for the map, if there is one
+    const std::string filePath = getFilePath(mapNum);
+
+    if (filePath.empty() || (!FileUtils::fileExists(filePath.c_str())))
+        return;
+
+    std::byte* pFileData = nullptr;
+    size_t fileSize = 0;
+
+    auto cleanupFileData = finally([&](){
+        delete[] pFileData;
+    });
+
+    if ((!FileUtils::getContentsOfFile(filePath.c_str(), pFileData, fileSize)) || (fileSize >= UINT32_MAX))
+        return;
+
+    // Verify the header and make sure the file is for the same map geometry
+    ByteInputStream stream(pFileData, (uint32_t) fileSize);
+    PvsFileHeader header = {};
+
+    try {
+        header.fileId = readU32(stream);
+        header.version = readU32(stream);
+        header.numSectors = readU32(stream);
+        header.mapGeometryHash = readU32(stream);
+    } catch (...) {
+        return;
+    }
+
+    const uint32_t rowSize = (gNumSectors + 7) / 8;
+    const size_t matrixSize = (size_t) gNumSectors * rowSize;
+
+    const bool bValidFile = (
+        (header.fileId == PVS_FILE_ID) &&
+        (header.version == PVS_FILE_VERSION) &&
+        (header.numSectors == gNumSectors) &&
+        (header.mapGeometryHash == computeMapGeometryHash()) &&
+        (fileSize == sizeof(PvsFileHeader) + matrixSize)
+    );
+
+    // Silently ignore an out of date or invalid file: the PVS is just an optimization and the map works fine without it
+    if (!bValidFile)
+        return;
+
+    const uint8_t* const pMatrix = (const uint8_t*)(pFileData + sizeof(PvsFileHeader));
+    gSectorVisData.assign(pMatrix, pMatrix + matrixSize);
+    gSectorVisRowSize = rowSize;
+    gpSectorVis = gSectorVisData.data();
+
+    // Work out which BSP nodes have anything visible under them for each sector
+    gNodeVisRowSize = (gNumBSPNodes + 7) / 8;
+    gNodeVisData.assign((size_t) gNumSectors * gNodeVisRowSize, 0);
+
+    for (uint32_t sectorIdx = 0; sectorIdx < gNumSectors; ++sectorIdx) {
+        uint8_t* const pNodeVisRow = gNodeVisData.data() + (size_t) sectorIdx * gNodeVisRowSize;
+        markVisibleBspNodes(sectorIdx, gpBSPTreeRoot, pNodeVisRow);
+    }
+
+    gpNodeVis = gNodeVisData.data();
+}
+
+void unload() noexcept {
+    gpSectorVis = nullptr;
+    gSectorVisRowSize = 0;
+    gpNodeVis = nullptr;
+    gNodeVisRowSize = 0;
+    gSectorVisData.clear();
+    gNodeVisData.clear();
+}
+
+bool generateAndSave(const uint32_t mapNum, float* const pOutVisiblePercent) noexcept {
+    const std::string filePath = getFilePath(mapNum);
+
+    if (filePath.empty())
+        return false;
+
+    // Compute the PVS
+    const uint32_t rowSize = (gNumSectors + 7) / 8;
+    std::vector<uint8_t> sectorVis;
+    computeSectorVis(sectorVis, rowSize);
+
+    if (pOutVisiblePercent) {
+        uint64_t numVisiblePairs = 0;
+
+        for (uint32_t sectorIdx = 0; sectorIdx < gNumSectors; ++sectorIdx) {
+            const uint8_t* const pVisRow = sectorVis.data() + (size_t) sectorIdx * rowSize;
+
+            for (uint32_t otherSectorIdx = 0; otherSectorIdx < gNumSectors; ++otherSectorIdx) {
+                numVisiblePairs += (getVisBit(pVisRow, otherSectorIdx)) ? 1 : 0;
+            }
+        }
+
+        const uint64_t numPairs = (uint64_t) gNumSectors * gNumSectors;
+        *pOutVisiblePercent = (numPairs > 0) ? (float)((double) numVisiblePairs * 100.0 / (double) numPairs) : 0.0f;
+    }
+
+    // Make up the file and save it
+    std::vector<std::byte> fileData;
+    fileData.reserve(sizeof(PvsFileHeader) + sectorVis.size());
+    writeU32(fileData, PVS_FILE_ID);
+    writeU32(fileData, PVS_FILE_VERSION);
+    writeU32(fileData, gNumSectors);
+    writeU32(fileData, computeMapGeometryHash());
+
+    for (const uint8_t visBits : sectorVis) {
+        fileData.push_back((std::byte) visBits);
+    }
+
+    return FileUtils::writeDataToFile(filePath.c_str(), fileData.data(), fileData.size());
+}
+
+std::string getFilePath(const uint32_t mapNum) noexcept {
+    char* const pPrefsPath = SDL_GetPrefPath(SAVE_FILE_ORG, SAVE_FILE_PRODUCT);
+    auto cleanupPrefsPath = finally([&](){
+        SDL_free(pPrefsPath);
+    });
+
+    if (!pPrefsPath)
+        return std::string();
+
+    std::string path = pPrefsPath;      // Note: path is guaranteed to have a separator at the end, as per SDL docs!
+    path += "map";
+    path += std::to_string(mapNum);
+    path += ".pvs";
+    return path;
+}
+
+END_NAMESPACE(MapPvs)
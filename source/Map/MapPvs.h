@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Base/Macros.h"
+#include <cstdint>
+#include <string>
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Potentially visible sets (PVS) for maps.
+//
+// For every sector in a map the PVS records which other sectors could possibly be seen from anywhere inside of it. The PVS is computed
+// offline from the map geometry by the 'PhoenixDoomPvsTool' program, which saves a PVS file for each map in the same folder as the game
+// prefs. When a map is loaded its PVS file is loaded too (if available and made for the same map geometry), and then used to skip whole
+// BSP subtrees while rendering and to reject sight checks between things without tracing a line through the map.
+//
+// Notes:
+//  (1) The PVS is conservative: a sector is only marked as not visible if no line of sight to it is possible. Every two sided line is
+//      treated as an opening between sectors, since the heights of any sector can potentially change during play (doors, lifts,
+//      stairs etc.). This means the PVS holds for the maximum possible opening of every sector.
+//  (2) Visibility within a sector is never considered blocked by the walls of that sector.
+//  (3) All the queries below return 'true' if no PVS is loaded.
+//------------------------------------------------------------------------------------------------------------------------------------------
+BEGIN_NAMESPACE(MapPvs)
+
+extern const uint8_t*   gpSectorVis;        // Bit matrix: which sectors are potentially visible from each sector, or null if no PVS
+extern uint32_t         gSectorVisRowSize;  // Size in bytes of each row of the sector visibility matrix
+extern const uint8_t*   gpNodeVis;          // Bit matrix: which BSP nodes have any potentially visible subsectors, for each sector
+extern uint32_t         gNodeVisRowSize;    // Size in bytes of each row of the BSP node visibility matrix
+
+// Load or unload the PVS for the current map. Must be called after the rest of the map data is loaded.
+void load(const uint32_t mapNum) noexcept;
+void unload() noexcept;
+
+// Computes the PVS for the currently loaded map and saves it to the PVS file for the given map number.
+// Returns 'false' on failure. Optionally returns the percentage of sector pairs that are potentially visible, for stats.
+bool generateAndSave(const uint32_t mapNum, float* const pOutVisiblePercent = nullptr) noexcept;
+
+// Get the path to the PVS file for the given map number
+std::string getFilePath(const uint32_t mapNum) noexcept;
+
+inline bool isLoaded() noexcept {
+    return (gpSectorVis != nullptr);
+}
+
+// Tells if the sector 'toSectorIdx' is potentially visible from anywhere in sector 'fromSectorIdx'
+inline bool canSectorSeeSector(const uint32_t fromSectorIdx, const uint32_t toSectorIdx) noexcept {
+    if (!gpSectorVis)
+        return true;
+
+    const uint8_t* const pRow = gpSectorVis + (size_t) fromSectorIdx * gSectorVisRowSize;
+    return ((pRow[toSectorIdx >> 3] & (1u << (toSectorIdx & 7))) != 0);
+}
+
+// Tells if any subsector under the given BSP node (index from 'getBspNodeIdx') is potentially visible from anywhere in sector 'fromSectorIdx'
+inline bool canSectorSeeBspNode(const uint32_t fromSectorIdx, const uint32_t nodeIdx) noexcept {
+    if (!gpNodeVis)
+        return true;
+
+    const uint8_t* const pRow = gpNodeVis + (size_t) fromSectorIdx * gNodeVisRowSize;
+    return ((pRow[nodeIdx >> 3] & (1u << (nodeIdx & 7))) != 0);
+}
+
+END_NAMESPACE(MapPvs)
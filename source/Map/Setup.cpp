@@ -7,6 +7,7 @@
 #include "Game/DoomRez.h"
 #include "Game/Resources.h"
 #include "Game/Tick.h"
+#include "GFX/Renderer.h"
 #include "GFX/Sprites.h"
 #include "GFX/Textures.h"
 #include "MapData.h"
@@ -330,6 +331,7 @@ void SetupLevel(const uint32_t map) noexcept {
 // Dispose of all memory allocated by loading a level
 //------------------------------------------------------------------------------------------------------------------------------------------
 void ReleaseMapMemory() noexcept {
+    Renderer::clearBspVisCache();
     mapDataShutdown();
     MEM_FREE_AND_NULL(gppLineArrayBuffer);
     Textures::freeAll();
@@ -2,6 +2,7 @@
 
 #include "Game/Data.h"
 #include "MapData.h"
+#include "MapPvs.h"
 #include "MapUtil.h"
 #include "Things/MapObj.h"
 
@@ -192,6 +193,16 @@ bool CheckSight(mobj_t& t1, mobj_t& t2, const bool bUseRejectMap) noexcept {
         }
     }
 
+    // Trivial rejection using the precomputed PVS for the map, if available.
+    // Note: the PVS portals are slightly extended, which allows for the trace points below being moved off the actual thing positions.
+    if (MapPvs::isLoaded()) {
+        const uint32_t s1 = (uint32_t)(t1.subsector->sector - gpSectors);
+        const uint32_t s2 = (uint32_t)(t2.subsector->sector - gpSectors);
+
+        if (!MapPvs::canSectorSeeSector(s1, s2))
+            return false;
+    }
+
     // Look from eyes of t1 to any part of t2
     ++gValidCount;
 
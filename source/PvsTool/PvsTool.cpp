@@ -0,0 +1,143 @@
+#include "PvsTool.h"
+
+#include "Base/Macros.h"
+#include "Game/Config.h"
+#include "Game/GameDataFS.h"
+#include "Game/Resources.h"
+#include "Map/MapData.h"
+#include "Map/MapPvs.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+BEGIN_NAMESPACE(PvsTool)
+
+static constexpr uint32_t NUM_MAPS = 24;    // Number of maps in the game
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Options for the tool
+//------------------------------------------------------------------------------------------------------------------------------------------
+struct Options {
+    uint32_t    mapNum;     // Which map to generate the PVS for, or '0' for all maps
+};
+
+static double getTimestampSec() noexcept {
+    const auto timeSinceEpoch = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(timeSinceEpoch).count();
+}
+
+static void printUsage() noexcept {
+    std::printf(
+        "Usage: PhoenixDoomPvsTool [options]\n"
+        "Precomputes the potentially visible sets (PVS) for maps and saves them for the game to use.\n"
+        "Game data location comes from the normal game config.\n"
+        "\n"
+        "Options:\n"
+        "  --map <num>          Only generate the PVS for this map number (default all maps)\n"
+    );
+}
+
+static bool parseUint(const char* const str, uint32_t& output) noexcept {
+    char* pEnd = nullptr;
+    const unsigned long value = std::strtoul(str, &pEnd, 10);
+
+    if ((pEnd == str) || (*pEnd != 0) || (value > UINT32_MAX))
+        return false;
+
+    output = (uint32_t) value;
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Parse the command line arguments into the given options struct.
+// Returns 'false' and prints a message if the arguments are not valid.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool parseOptions(const int argc, const char* const* const argv, Options& options) noexcept {
+    options = {};
+    options.mapNum = 0;
+
+    for (int argIdx = 1; argIdx < argc; ++argIdx) {
+        const char* const arg = argv[argIdx];
+        const char* const nextArg = (argIdx + 1 < argc) ? argv[argIdx + 1] : nullptr;
+        bool bValid = true;
+
+        if ((std::strcmp(arg, "--help") == 0) || (std::strcmp(arg, "-h") == 0)) {
+            printUsage();
+            return false;
+        }
+        else if (!nextArg) {
+            bValid = false;
+        }
+        else if (std::strcmp(arg, "--map") == 0) {
+            bValid = (parseUint(nextArg, options.mapNum) && (options.mapNum >= 1) && (options.mapNum <= NUM_MAPS));
+        }
+        else {
+            bValid = false;
+        }
+
+        if (!bValid) {
+            std::fprintf(stderr, "Invalid or incomplete argument '%s'! Run with '--help' for a list of options.\n", arg);
+            return false;
+        }
+
+        ++argIdx;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Generates and saves the PVS for the given map, printing out the results.
+// Returns 'false' on failure.
+//------------------------------------------------------------------------------------------------------------------------------------------
+static bool generateMapPvs(const uint32_t mapNum) noexcept {
+    const double startTime = getTimestampSec();
+    mapDataInit(mapNum);
+
+    float visiblePercent = 0.0f;
+    const bool bSuccess = MapPvs::generateAndSave(mapNum, &visiblePercent);
+
+    if (bSuccess) {
+        std::printf(
+            "Map %u: %u sectors, %.1f%% of sector pairs potentially visible (%.2f seconds)\n",
+            mapNum,
+            gNumSectors,
+            visiblePercent,
+            getTimestampSec() - startTime
+        );
+    } else {
+        std::fprintf(stderr, "Map %u: unable to save the PVS file '%s'!\n", mapNum, MapPvs::getFilePath(mapNum).c_str());
+    }
+
+    mapDataShutdown();
+    return bSuccess;
+}
+
+int run(const int argc, const char* const* const argv) noexcept {
+    Options options;
+
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    // Only the game data is needed to load the maps
+    Config::init();
+    GameDataFS::init();
+    Resources::init();
+
+    const uint32_t firstMapNum = (options.mapNum != 0) ? options.mapNum : 1;
+    const uint32_t lastMapNum = (options.mapNum != 0) ? options.mapNum : NUM_MAPS;
+    bool bSuccess = true;
+
+    for (uint32_t mapNum = firstMapNum; mapNum <= lastMapNum; ++mapNum) {
+        bSuccess &= generateMapPvs(mapNum);
+    }
+
+    Resources::shutdown();
+    GameDataFS::shutdown();
+    Config::shutdown();
+
+    return (bSuccess) ? 0 : 1;
+}
+
+END_NAMESPACE(PvsTool)
@@ -0,0 +1,12 @@
+#pragma once
+
+//------------------------------------------------------------------------------------------------------------------------------------------
+// Tool for precomputing the potentially visible sets (PVS) for maps.
+//
+// Loads each map from the game data, works out which sectors could possibly be seen from each other sector and saves the results
+// to a PVS file for the map, which the game then loads along with the map. Needs to be re-run if the game data changes, since out
+// of date PVS files are ignored. Run with '--help' for a list of options.
+//------------------------------------------------------------------------------------------------------------------------------------------
+namespace PvsTool {
+    int run(const int argc, const char* const* const argv) noexcept;
+}
@@ -1,5 +1,6 @@
 #include "Base.h"
 
+#include "Base/Profiler.h"
 #include "Base/Random.h"
 #include "Enemy.h"
 #include "Game/Data.h"
@@ -490,6 +491,8 @@ static void P_MobjThinker(mobj_t& mobj) noexcept {
 // Execute base think logic for the critters every tic
 //------------------------------------------------------------------------------------------------------------------------------------------
 void P_RunMobjBase() noexcept {
+    PROFILE_ZONE("Map Objects");
+
     mobj_t* pMObj = gMObjHead.next;
     while (pMObj != &gMObjHead) {
         mobj_t* const pNext = pMObj->next;      // In case it's deleted!
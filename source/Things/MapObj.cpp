@@ -74,7 +74,10 @@ void Sub1RandomTick(mobj_t& mobj) noexcept {
 //------------------------------------------------------------------------------------------------------------------------------------------
 void ExplodeMissile(mobj_t& mo) noexcept {
     mo.momx = mo.momy = mo.momz = 0;                // Stop forward momentum
-    SetMObjState(mo, mo.InfoPtr->deathstate);       // Enter explosion state
+
+    if (!SetMObjState(mo, mo.InfoPtr->deathstate))  // Enter explosion state
+        return;                                     // No explosion state, the missile was removed and freed!
+
     Sub1RandomTick(mo);
     mo.flags &= ~MF_MISSILE;                        // It's not a missile anymore
     S_StartSound(&mo.x, mo.InfoPtr->deathsound);    // Play the sound if any
@@ -5,6 +5,7 @@
 #include "Base/Tables.h"
 #include "Game/Config.h"
 #include "Game/Data.h"
+#include "Game/Demo.h"
 #include "GFX/Renderer.h"
 #include "Info.h"
 #include "Map/Map.h"
@@ -298,6 +299,9 @@ static void P_BuildMove(player_t& player) noexcept {
         const Fixed forwardMoveFrac = floatToFixed16(forwardMoveFracF);
         player.forwardmove = fixed16Mul(forwardMoveFrac, FORWARD_MOVE[speedIndex]);
 
+        // Record this movement if recording a demo, or replace it with the recorded movement if playing one back
+        Demo::tickPlayerMove(player);
+
         // Debug camera movement
         if (Config::gbAllowDebugCameraUpDownMovement) {
             if (GAME_ACTION(DEBUG_MOVE_CAMERA_UP)) {
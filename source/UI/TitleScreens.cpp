@@ -3,8 +3,10 @@
 #include "Audio/Sound.h"
 #include "Audio/Sounds.h"
 #include "Base/Input.h"
+#include "Game/Config.h"
 #include "Game/Controls.h"
 #include "Game/Data.h"
+#include "Game/Demo.h"
 #include "Game/DoomDefines.h"
 #include "Game/DoomRez.h"
 #include "Game/Game.h"
@@ -101,6 +103,12 @@ static void RunMenu() {
 
     if (RunGameLoop(M_Start, M_Stop, M_Ticker, M_Drawer) == ga_completed) {
         S_StopSong();
+
+        // Record a demo of the first level if that is enabled
+        if (Config::gRecordDemoSlot != 0) {
+            Demo::startRecording(Config::gRecordDemoSlot, gStartSkill, gStartMap);
+        }
+
         G_InitNew(gStartSkill, gStartMap);      // Init the new game
         G_RunGame();                            // Play the game
     }
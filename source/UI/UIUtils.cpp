@@ -1,11 +1,13 @@
 #include "UIUtils.h"
 
+#include "Base/Profiler.h"
 #include "Base/Tables.h"
 #include "Game/Data.h"
 #include "Game/DoomRez.h"
 #include "GFX/Blit.h"
 #include "GFX/CelImages.h"
 #include "GFX/Video.h"
+#include <algorithm>
 #include <cstring>
 #include <string>
 
@@ -234,6 +236,22 @@ void drawPerformanceCounter(const int32_t x, const int32_t y) noexcept {
         std::string usecString = std::to_string(gPerfCounterAverageUSec) + std::string(" USEC");
         printBigFont(x, y, usecString.c_str());
     }
+    else if (gPerfCounterMode == PerfCounterMode::PROFILE) {
+        // Show the averaged time for each profiler zone, one zone per line and indented by how deeply the zone is nested.
+        // Stop when the bottom of the screen is reached.
+        constexpr int32_t LINE_HEIGHT = 14;
+        constexpr int32_t INDENT_WIDTH = 8;
+        int32_t lineY = y;
+
+        for (const Profiler::ZoneStats& stats : Profiler::getAveragedZoneStats()) {
+            if (lineY + LINE_HEIGHT > 200)
+                break;
+
+            printBigFont(x + (int32_t) stats.depth * INDENT_WIDTH, lineY, stats.name);
+            printNumber(x + 316, lineY, (uint32_t) std::min<uint64_t>(stats.avgUSec, UINT32_MAX), PNFLAGS_RIGHT);
+            lineY += LINE_HEIGHT;
+        }
+    }
 }
 
 END_NAMESPACE(UIUtils)
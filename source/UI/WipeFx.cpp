@@ -104,69 +104,33 @@ static bool tickWipe(float* const pYDeltas) noexcept {
 }
 
 //------------------------------------------------------------------------------------------------------------------------------------------
-// Does the drawing for the wipe
+// Does the drawing for the wipe.
+// The screen is drawn one row at a time so that writes to the framebuffer are sequential. Reads of the new image are sequential also,
+// and since the wipe offsets of neighboring columns are close together the reads of the old image only touch a few nearby rows.
 //------------------------------------------------------------------------------------------------------------------------------------------
 static void drawWipe(
     const uint32_t* const gpOldImg,
     const uint32_t* const gpNewImg,
-    const float* const pYDeltas
+    const float* const pYDeltas,
+    uint32_t* const pColYDeltas
 ) noexcept {
     const uint32_t screenW = Video::gScreenWidth;
     const uint32_t screenH = Video::gScreenHeight;
     uint32_t* const pDstPixels = Video::gpFrameBuffer;
 
-    //------------------------------------------------------------------------------------------------------------------
-    // Add in the new image pixels at the top: do 8 pixel batches at a time, then the remainder pixels
-    //------------------------------------------------------------------------------------------------------------------
+    // Convert the wipe offsets for each column to integers first, so this is only done once per column
     for (uint32_t x = 0; x < screenW; ++x) {
-        uint32_t* const pDstPixelsCol = pDstPixels + x;
-        const uint32_t* const gpNewImgCol = gpNewImg + (uintptr_t) x * screenH;
-
-        const uint32_t yDelta = std::min((uint32_t) std::max(pYDeltas[x], 0.0f), screenH);
-        const uint32_t yDelta8 = (yDelta / 8) * 8;
-
-        for (uint32_t y = 0; y < yDelta8; y += 8) {
-            pDstPixelsCol[(y + 0) * screenW] = gpNewImgCol[y + 0];
-            pDstPixelsCol[(y + 1) * screenW] = gpNewImgCol[y + 1];
-            pDstPixelsCol[(y + 2) * screenW] = gpNewImgCol[y + 2];
-            pDstPixelsCol[(y + 3) * screenW] = gpNewImgCol[y + 3];
-            pDstPixelsCol[(y + 4) * screenW] = gpNewImgCol[y + 4];
-            pDstPixelsCol[(y + 5) * screenW] = gpNewImgCol[y + 5];
-            pDstPixelsCol[(y + 6) * screenW] = gpNewImgCol[y + 6];
-            pDstPixelsCol[(y + 7) * screenW] = gpNewImgCol[y + 7];
-        }
-
-        for (uint32_t y = yDelta8; y < yDelta; ++y) {
-            pDstPixelsCol[y * screenW] = gpNewImgCol[y];
-        }
+        pColYDeltas[x] = std::min((uint32_t) std::max(pYDeltas[x], 0.0f), screenH);
     }
 
-    //------------------------------------------------------------------------------------------------------------------
-    // Add in the old image pixels: do 8 pixel batches at a time, then the remainder pixels
-    //------------------------------------------------------------------------------------------------------------------
-    for (uint32_t x = 0; x < screenW; ++x) {
-        uint32_t* const pDstPixelsCol = pDstPixels + x;
-        const uint32_t* const gpOldImgCol = gpOldImg + (uintptr_t) x * screenH;
-
-        const uint32_t yDelta = std::min((uint32_t) std::max(pYDeltas[x], 0.0f), screenH);
-        const uint32_t numPixelsRemaining = screenH - yDelta;
-        const uint32_t screenHeight8 = yDelta + (numPixelsRemaining / 8) * 8;
-
-        for (uint32_t y = yDelta; y < screenHeight8; y += 8) {
-            const uint32_t oldPixelBaseY = y - yDelta;
-
-            pDstPixelsCol[(y + 0) * screenW] = gpOldImgCol[oldPixelBaseY + 0];
-            pDstPixelsCol[(y + 1) * screenW] = gpOldImgCol[oldPixelBaseY + 1];
-            pDstPixelsCol[(y + 2) * screenW] = gpOldImgCol[oldPixelBaseY + 2];
-            pDstPixelsCol[(y + 3) * screenW] = gpOldImgCol[oldPixelBaseY + 3];
-            pDstPixelsCol[(y + 4) * screenW] = gpOldImgCol[oldPixelBaseY + 4];
-            pDstPixelsCol[(y + 5) * screenW] = gpOldImgCol[oldPixelBaseY + 5];
-            pDstPixelsCol[(y + 6) * screenW] = gpOldImgCol[oldPixelBaseY + 6];
-            pDstPixelsCol[(y + 7) * screenW] = gpOldImgCol[oldPixelBaseY + 7];
-        }
+    // Above the wipe offset for each column show the new image, and below it show the old image shifted down by the offset
+    for (uint32_t y = 0; y < screenH; ++y) {
+        uint32_t* const pDstRow = pDstPixels + (uintptr_t) y * screenW;
+        const uint32_t* const pNewImgRow = gpNewImg + (uintptr_t) y * screenW;
 
-        for (uint32_t y = screenHeight8; y < screenH; ++y) {
-            pDstPixelsCol[y * screenW] = gpOldImgCol[y - yDelta];
+        for (uint32_t x = 0; x < screenW; ++x) {
+            const uint32_t yDelta = pColYDeltas[x];
+            pDstRow[x] = (y < yDelta) ? pNewImgRow[x] : gpOldImg[(uintptr_t)(y - yDelta) * screenW + x];
         }
     }
 }
@@ -183,6 +147,7 @@ void doWipe(const GameLoopDrawFunc drawFunc) noexcept {
 
     // Generate the Y delta table that randomizes the wipe
     std::unique_ptr<float[]> yDeltas = generateYDeltaTable();
+    std::unique_ptr<uint32_t[]> colYDeltas(new uint32_t[Video::gScreenWidth]);
 
     // Continue until the wipe is done
     bool bWipeDone = false;
@@ -209,7 +174,7 @@ void doWipe(const GameLoopDrawFunc drawFunc) noexcept {
         }
 
         // Draw the wipe and present
-        drawWipe(oldFramebuffer.get(), Video::gpSavedFrameBuffer, yDeltas.get());
+        drawWipe(oldFramebuffer.get(), Video::gpSavedFrameBuffer, yDeltas.get(), colYDeltas.get());
         UIUtils::drawPerformanceCounter(0, 0);
         Video::present();
     }